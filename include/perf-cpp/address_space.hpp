@@ -0,0 +1,157 @@
+/*
+ * This file is part of the perf_cpp library.
+ * Linux Perf C++ bindings
+ *
+ * Copyright (c) 2024,
+ *    Technische Universitaet Dresden, Germany
+ *
+ * perf_cpp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * perf_cpp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with perf_cpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <perf-cpp/record.hpp>
+
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+extern "C"
+{
+#include <linux/perf_event.h>
+}
+
+namespace perf_cpp
+{
+
+/**
+ * An executable mapping of a process, valid in [from_time, to_time)
+ */
+struct Mapping
+{
+    static constexpr std::uint64_t forever = std::numeric_limits<std::uint64_t>::max();
+
+    std::uint64_t start;
+    std::uint64_t end;
+    std::uint64_t pgoff;
+    // interned, valid as long as the tracker
+    const std::string* filename;
+    // hex build-id, if the kernel reported it in the MMAP2 record
+    std::optional<std::string> build_id;
+
+    std::uint64_t from_time;
+    std::uint64_t to_time = forever;
+
+    bool contains(std::uint64_t address) const
+    {
+        return address >= start && address < end;
+    }
+
+    bool valid_at(std::uint64_t time) const
+    {
+        return time >= from_time && time < to_time;
+    }
+};
+
+/**
+ * Rebuilds the executable mappings of every process from the side-band
+ * records enabled by EventAttr::set_mmap2(), set_comm() and set_task():
+ *
+ * - PERF_RECORD_MMAP/MMAP2 add a mapping, replacing what it overlaps
+ * - PERF_RECORD_FORK copies the mappings of the parent to a child process
+ * - PERF_RECORD_COMM with PERF_RECORD_MISC_COMM_EXEC drops all mappings
+ * - PERF_RECORD_EXIT of the main thread drops all mappings
+ *
+ * Replaced mappings are not deleted but closed at the time of the record, so
+ * a sample is resolved against the mappings that existed at its timestamp,
+ * even if it is processed after a later dlclose()/dlopen(). Use expire() to
+ * drop history that no sample can refer to anymore.
+ *
+ * The records need timestamps for that: open the side-band event with
+ * PERF_SAMPLE_TIME and sample_id_all. Records without one are treated as
+ * happening at the latest time seen so far.
+ */
+class AddressSpaceTracker
+{
+public:
+    AddressSpaceTracker(const RecordLayout& layout) : layout_(layout)
+    {
+    }
+
+    /**
+     * processes one record, anything but the side-band records above is ignored
+     */
+    void process(const perf_event_header* record);
+
+    /**
+     * @returns the mapping that contained address in process pid at time,
+     * or nullptr. Without a time, the current mappings are used. Kernel
+     * mappings are tracked under pid -1. The pointer is only valid until the
+     * next call to process() or expire().
+     */
+    const Mapping* find(std::uint32_t pid, std::uint64_t address,
+                        std::optional<std::uint64_t> time = std::nullopt) const;
+
+    /**
+     * resolves a column of addresses of a single sample (e.g. a callchain)
+     */
+    void find(std::uint32_t pid, const std::uint64_t* addresses, std::size_t count,
+              std::optional<std::uint64_t> time, const Mapping** result) const;
+
+    /**
+     * @returns the current command name of pid, if known
+     */
+    std::optional<std::string> comm(std::uint32_t pid) const;
+
+    /**
+     * drops all mappings (and exited processes) that ended before time
+     */
+    void expire(std::uint64_t time);
+
+    std::size_t processes() const
+    {
+        return processes_.size();
+    }
+
+private:
+    struct Process
+    {
+        std::string comm;
+        // current mappings, non-overlapping, keyed by start address
+        std::map<std::uint64_t, Mapping> live;
+        // replaced mappings with their to_time set
+        std::vector<Mapping> history;
+        std::optional<std::uint64_t> exit_time;
+    };
+
+    void add_mapping(std::uint32_t pid, Mapping mapping);
+    void retire_all(Process& process, std::uint64_t time);
+    void fork(std::uint32_t pid, std::uint32_t ppid, std::uint64_t time);
+
+    std::uint64_t time_of(const perf_event_header* record);
+    const std::string* intern(std::string_view str);
+
+    RecordLayout layout_;
+    std::uint64_t last_time_ = 0;
+
+    std::unordered_map<std::uint32_t, Process> processes_;
+    std::unordered_set<std::string> strings_;
+};
+
+} // namespace perf_cpp
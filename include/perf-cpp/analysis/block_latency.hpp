@@ -0,0 +1,327 @@
+/*
+ * This file is part of the perf_cpp library.
+ * Linux Perf C++ bindings
+ *
+ * Copyright (c) 2024,
+ *    Technische Universitaet Dresden, Germany
+ *
+ * perf_cpp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * perf_cpp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with perf_cpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <perf-cpp/analysis/histogram.hpp>
+#include <perf-cpp/analysis/pairing_table.hpp>
+#include <perf-cpp/analysis/reorder_buffer.hpp>
+#include <perf-cpp/record.hpp>
+#include <perf-cpp/tracepoint/event_attr.hpp>
+#include <perf-cpp/tracepoint/filter.hpp>
+#include <perf-cpp/tracepoint/format.hpp>
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+namespace perf_cpp
+{
+
+namespace analysis
+{
+
+/**
+ * The operation of a block request, from the rwbs field of the block tracepoints
+ */
+enum class BlockOp
+{
+    READ,
+    WRITE,
+    DISCARD,
+    FLUSH,
+    OTHER,
+};
+
+constexpr std::size_t block_op_count = 5;
+
+const char* to_string(BlockOp op);
+
+/**
+ * @returns the operation of an rwbs string, e.g. "WS" or "FWFS"
+ */
+BlockOp block_op(std::string_view rwbs);
+
+/**
+ * A block device by number, as in /proc/partitions or ls -l /dev
+ */
+struct BlockDevice
+{
+    unsigned major;
+    unsigned minor;
+
+    /**
+     * the kernel's dev_t (MKDEV), which the block tracepoints record. It is
+     * not the same as the userspace dev_t of stat().
+     */
+    std::uint32_t kernel_dev() const
+    {
+        return (major << 20) | (minor & 0xfffff);
+    }
+
+    static BlockDevice from_kernel_dev(std::uint32_t dev)
+    {
+        return BlockDevice{ dev >> 20, dev & 0xfffff };
+    }
+};
+
+/**
+ * Continuous block I/O latency distributions from block:block_rq_issue and
+ * block:block_rq_complete samples, and optionally block:block_rq_insert,
+ * without blktrace.
+ *
+ * Requests are matched by (device, sector) in a PairingTable, so memory is
+ * bounded by the number of requests in flight. Per device and BlockOp it
+ * records
+ *
+ *  - device latency: issue to the driver until completion
+ *  - queue latency: insertion into the I/O scheduler until issue, if
+ *    block_rq_insert is sampled too
+ *
+ * and a time series of the queue depth (requests issued but not yet
+ * completed), as its time-weighted average and maximum per depth_interval.
+ *
+ * Completions usually run on another cpu than the issue, so samples pass a
+ * ReorderBuffer first. To watch only some devices, set Options::devices
+ * and apply filter() to the tracepoints, so the kernel drops the other
+ * devices' records; the analyzer ignores them too, in case the kernel
+ * rejected the filter. Not thread-safe.
+ */
+class BlockLatencyAnalyzer
+{
+public:
+    struct Options
+    {
+        // empty for all devices
+        std::vector<BlockDevice> devices;
+        std::size_t max_devices = 64;
+        // requests in flight across all devices
+        std::size_t max_requests = 65536;
+        // requests whose completion was not seen for this long are dropped
+        // when the table is full, e.g. after lost records
+        std::chrono::nanoseconds stale_after = std::chrono::seconds(60);
+        unsigned precision = 4;
+        std::chrono::nanoseconds reorder_window = std::chrono::milliseconds(100);
+        std::chrono::nanoseconds depth_interval = std::chrono::milliseconds(100);
+        // points of the queue depth series kept per device, older ones are dropped
+        std::size_t max_depth_points = 600;
+    };
+
+    struct DepthPoint
+    {
+        // start of the interval
+        std::uint64_t time;
+        double average;
+        std::uint32_t max;
+    };
+
+    struct DeviceStats
+    {
+        DeviceStats(BlockDevice device, std::uint64_t index, unsigned precision);
+
+        const LatencyHistogram& device_latency(BlockOp op) const
+        {
+            return device_latency_[static_cast<std::size_t>(op)];
+        }
+
+        const LatencyHistogram& queue_latency(BlockOp op) const
+        {
+            return queue_latency_[static_cast<std::size_t>(op)];
+        }
+
+        std::uint32_t in_flight() const
+        {
+            return depth_;
+        }
+
+        const std::deque<DepthPoint>& queue_depth() const
+        {
+            return series_;
+        }
+
+        BlockDevice device;
+
+    private:
+        friend class BlockLatencyAnalyzer;
+
+        // integrates the depth up to time, closing the intervals before it
+        void advance(std::uint64_t time, std::uint64_t interval, std::size_t max_points);
+
+        std::array<LatencyHistogram, block_op_count> device_latency_;
+        std::array<LatencyHistogram, block_op_count> queue_latency_;
+
+        // small number for the request keys, in order of appearance
+        std::uint64_t index_;
+        std::uint32_t depth_ = 0;
+        std::uint32_t depth_max_ = 0;
+        std::uint64_t interval_begin_ = 0;
+        std::uint64_t last_change_ = 0;
+        // depth * ns within the current interval
+        std::uint64_t area_ = 0;
+        std::deque<DepthPoint> series_;
+    };
+
+    struct Counters
+    {
+        // samples that arrived after the reordering window
+        std::uint64_t late = 0;
+        // requests not tracked because the pairing table was full
+        std::uint64_t dropped = 0;
+        // completions without an issue, e.g. of requests issued before
+        // recording started, or the later parts of partial completions
+        std::uint64_t unmatched = 0;
+        // requests of devices beyond max_devices
+        std::uint64_t untracked = 0;
+        // requests dropped after stale_after without a completion
+        std::uint64_t stale = 0;
+    };
+
+    BlockLatencyAnalyzer(const tracepoint::TracepointEventAttr& issue,
+                         const tracepoint::TracepointEventAttr& complete, Options options);
+    BlockLatencyAnalyzer(const tracepoint::TracepointEventAttr& issue,
+                         const tracepoint::TracepointEventAttr& complete)
+    : BlockLatencyAnalyzer(issue, complete, Options())
+    {
+    }
+
+    BlockLatencyAnalyzer(const tracepoint::TracepointEventAttr& insert,
+                         const tracepoint::TracepointEventAttr& issue,
+                         const tracepoint::TracepointEventAttr& complete, Options options);
+    BlockLatencyAnalyzer(const tracepoint::TracepointEventAttr& insert,
+                         const tracepoint::TracepointEventAttr& issue,
+                         const tracepoint::TracepointEventAttr& complete)
+    : BlockLatencyAnalyzer(insert, issue, complete, Options())
+    {
+    }
+
+    /**
+     * for formats saved with a recording, insert is optional
+     */
+    BlockLatencyAnalyzer(const std::optional<tracepoint::TracepointFormat>& insert,
+                         const tracepoint::TracepointFormat& issue,
+                         const tracepoint::TracepointFormat& complete, Options options);
+
+    /**
+     * samples every block request event with raw data and time
+     */
+    static void prepare(EventAttr& attr);
+
+    /**
+     * a kernel-side filter for the block tracepoints that only passes devices
+     */
+    static tracepoint::Filter device_filter(const std::vector<BlockDevice>& devices);
+
+    /**
+     * device_filter() of Options::devices
+     * @throws std::logic_error if no devices were selected
+     */
+    tracepoint::Filter filter() const;
+
+    /**
+     * queues an insert, issue or complete sample, samples of other events are ignored
+     */
+    void process(const SampleView& sample);
+
+    void process(const RecordBatch& records, const RecordLayout& layout);
+
+    /**
+     * pairs the queued samples, e.g. at the end of a recording
+     */
+    void flush();
+
+    /**
+     * statistics by kernel dev (see BlockDevice::kernel_dev())
+     */
+    const std::map<std::uint32_t, DeviceStats>& devices() const
+    {
+        return devices_;
+    }
+
+    Counters counters() const
+    {
+        auto counters = counters_;
+        counters.late = queue_.late();
+        return counters;
+    }
+
+    /**
+     * clears the histograms, depth series and counters, requests in flight are kept
+     */
+    void reset();
+
+private:
+    enum class Type : std::uint8_t
+    {
+        INSERT,
+        ISSUE,
+        COMPLETE,
+    };
+
+    struct Event
+    {
+        std::uint64_t time;
+        std::uint64_t sector;
+        std::uint32_t dev;
+        Type type;
+        BlockOp op;
+    };
+
+    struct Request
+    {
+        // 0 if the sample was not seen
+        std::uint64_t inserted = 0;
+        std::uint64_t issued = 0;
+        BlockOp op = BlockOp::OTHER;
+    };
+
+    struct Fields
+    {
+        Fields() = default;
+        explicit Fields(const tracepoint::TracepointFormat& format);
+
+        std::uint16_t type = 0;
+        tracepoint::EventField dev;
+        tracepoint::EventField sector;
+        tracepoint::EventField rwbs;
+    };
+
+    void handle(const Event& event);
+    bool insert(std::uint64_t key, const Request& request, std::uint64_t time);
+    DeviceStats* device(std::uint32_t dev);
+
+    Options options_;
+    std::optional<Fields> insert_;
+    Fields issue_;
+    Fields complete_;
+
+    ReorderBuffer<Event> queue_;
+    PairingTable<Request> requests_;
+    std::map<std::uint32_t, DeviceStats> devices_;
+    Counters counters_;
+};
+
+} // namespace analysis
+} // namespace perf_cpp
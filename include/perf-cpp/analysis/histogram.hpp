@@ -0,0 +1,144 @@
+/*
+ * This file is part of the perf_cpp library.
+ * Linux Perf C++ bindings
+ *
+ * Copyright (c) 2024,
+ *    Technische Universitaet Dresden, Germany
+ *
+ * perf_cpp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * perf_cpp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with perf_cpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace perf_cpp
+{
+
+namespace analysis
+{
+
+/**
+ * Log-linear histogram of latencies (or any other non-negative integers), in
+ * the style of HdrHistogram: every power of two is split into 2^precision
+ * equally wide buckets, so a value is known to within a relative error of
+ * 2^-precision, and values below 2^precision exactly.
+ *
+ * The buckets are allocated up front and recording is a few shifts and an
+ * increment. With the defaults (precision 4, values up to 2^36 ns = 68 s),
+ * a histogram takes about 4 KiB. Larger values are counted in the last
+ * bucket, but min() and max() are always exact.
+ */
+class LatencyHistogram
+{
+public:
+    explicit LatencyHistogram(unsigned precision = 4, unsigned max_value_bits = 36);
+
+    void record(std::uint64_t value, std::uint64_t count = 1)
+    {
+        counts_[std::min(index(value), counts_.size() - 1)] += count;
+        count_ += count;
+        sum_ += value * count;
+        min_ = std::min(min_, value);
+        max_ = std::max(max_, value);
+    }
+
+    /**
+     * adds the values of other, which must have the same precision and range
+     * @throws std::invalid_argument otherwise
+     */
+    void merge(const LatencyHistogram& other);
+
+    void clear();
+
+    std::uint64_t count() const
+    {
+        return count_;
+    }
+
+    // 0 if the histogram is empty
+    std::uint64_t min() const
+    {
+        return count_ == 0 ? 0 : min_;
+    }
+
+    std::uint64_t max() const
+    {
+        return max_;
+    }
+
+    double mean() const
+    {
+        return count_ == 0 ? 0.0 : static_cast<double>(sum_) / count_;
+    }
+
+    /**
+     * @returns the value below or at which the fraction quantile (0..1) of
+     * the recorded values lie, i.e. the upper end of the bucket that
+     * contains it, but never more than max(). 0 if the histogram is empty.
+     */
+    std::uint64_t percentile(double quantile) const;
+
+    /**
+     * calls f(lowest, highest, count) for every non-empty bucket, in order
+     */
+    template <typename F>
+    void for_each_bucket(F&& f) const
+    {
+        for (std::size_t i = 0; i < counts_.size(); i++)
+        {
+            if (counts_[i] != 0)
+            {
+                f(lowest(i), highest(i), counts_[i]);
+            }
+        }
+    }
+
+    unsigned precision() const
+    {
+        return precision_;
+    }
+
+private:
+    std::size_t index(std::uint64_t value) const
+    {
+        // values below 2^precision have a bucket of their own (group 0), the
+        // others are in group msb - precision + 1, at their next precision bits
+        const unsigned msb = 63 - __builtin_clzll(value | 1);
+        if (msb < precision_)
+        {
+            return value;
+        }
+        const unsigned group = msb - precision_ + 1;
+        return (static_cast<std::size_t>(group) << precision_) +
+               (value >> (group - 1)) - (std::size_t(1) << precision_);
+    }
+
+    std::uint64_t lowest(std::size_t index) const;
+    std::uint64_t highest(std::size_t index) const;
+
+    unsigned precision_;
+    std::vector<std::uint64_t> counts_;
+    std::uint64_t count_ = 0;
+    std::uint64_t sum_ = 0;
+    std::uint64_t min_ = std::numeric_limits<std::uint64_t>::max();
+    std::uint64_t max_ = 0;
+};
+
+} // namespace analysis
+} // namespace perf_cpp
@@ -0,0 +1,292 @@
+/*
+ * This file is part of the perf_cpp library.
+ * Linux Perf C++ bindings
+ *
+ * Copyright (c) 2024,
+ *    Technische Universitaet Dresden, Germany
+ *
+ * perf_cpp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * perf_cpp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with perf_cpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <perf-cpp/analysis/histogram.hpp>
+#include <perf-cpp/analysis/pairing_table.hpp>
+#include <perf-cpp/analysis/reorder_buffer.hpp>
+#include <perf-cpp/call_tree.hpp>
+#include <perf-cpp/kernel_symbols.hpp>
+#include <perf-cpp/record.hpp>
+#include <perf-cpp/tracepoint/event_attr.hpp>
+#include <perf-cpp/tracepoint/format.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace perf_cpp
+{
+
+namespace analysis
+{
+
+/**
+ * The flags argument of lock:contention_begin (LCB_F_* in the kernel)
+ */
+namespace lock_flags
+{
+constexpr std::uint32_t spin = 1U << 0;
+constexpr std::uint32_t read = 1U << 1;
+constexpr std::uint32_t write = 1U << 2;
+constexpr std::uint32_t rt = 1U << 3;
+constexpr std::uint32_t percpu = 1U << 4;
+constexpr std::uint32_t mutex = 1U << 5;
+} // namespace lock_flags
+
+/**
+ * @returns the kind of lock for the flags of lock:contention_begin, e.g.
+ * "spinlock", "rwsem:W" or "mutex", as perf lock contention names them
+ */
+const char* lock_type(std::uint32_t flags);
+
+/**
+ * Kernel lock contention from lock:contention_begin and lock:contention_end
+ * samples (Linux 5.19 and later), without lockdep or BPF.
+ *
+ * The time from the begin of a contention until its end is the wait time of
+ * the contending task. It is attributed to
+ *
+ *  - the lock address, with a histogram per lock
+ *  - the contending task
+ *  - the cpu the wait ended on, merged into wait_time() for all cpus
+ *  - optionally the callchain of the contention_begin sample, if the
+ *    tracepoints are sampled with PERF_SAMPLE_CALLCHAIN
+ *
+ * Statically allocated locks (e.g. rtnl_mutex) are named by report() from a
+ * KernelSymbols index with data symbols. Locks embedded in other objects,
+ * such as the mmap_lock of an mm_struct, have no symbol; their callchains
+ * show who takes them.
+ *
+ * Sleeping locks (mutexes, rwsems) can end their contention on another cpu
+ * than they began, so the samples of all cpus have to go through one
+ * analyzer, which puts them back into timestamp order. Like perf, only the
+ * outermost contention of a task is counted, e.g. not the wait_lock spin
+ * inside a mutex wait. The stack tree is bounded by max_stack_nodes and
+ * shrinks to the stacks of waits in progress on reset(). Not thread-safe.
+ */
+class LockContentionAnalyzer
+{
+public:
+    struct Options
+    {
+        // tasks that can wait for a lock at the same time
+        std::size_t max_tasks = 32768;
+        // locks and tasks with their own statistics
+        std::size_t max_locks = 4096;
+        std::size_t max_tracked_tasks = 1024;
+        unsigned precision = 4;
+        std::chrono::nanoseconds reorder_window = std::chrono::milliseconds(100);
+        // waits older than this are dropped when the task table is full
+        std::chrono::nanoseconds stale_after = std::chrono::seconds(60);
+        // attribute wait time to the callchain of contention_begin
+        bool stacks = false;
+        // nodes of stacks(), further callchains are not recorded
+        std::size_t max_stack_nodes = 262144;
+    };
+
+    struct LockStats
+    {
+        explicit LockStats(unsigned precision) : wait_time(precision)
+        {
+        }
+
+        LatencyHistogram wait_time;
+        // ns waited in total
+        std::uint64_t total = 0;
+        // the flags of the last contention
+        std::uint32_t flags = 0;
+    };
+
+    struct TaskStats
+    {
+        std::uint32_t pid = 0;
+        std::uint64_t contentions = 0;
+        std::uint64_t total = 0;
+    };
+
+    struct CpuStats
+    {
+        explicit CpuStats(unsigned precision) : wait_time(precision)
+        {
+        }
+
+        LatencyHistogram wait_time;
+        std::uint64_t total = 0;
+    };
+
+    struct Row
+    {
+        std::uint64_t lock;
+        // symbol (+offset) of the lock, empty if it has none
+        std::string name;
+        const char* type;
+        std::uint64_t contentions;
+        std::uint64_t total;
+        std::uint64_t max;
+    };
+
+    struct Counters
+    {
+        // samples that arrived after the reordering window
+        std::uint64_t late = 0;
+        // waits not tracked because the task table was full
+        std::uint64_t dropped = 0;
+        // contention_end without a begin, e.g. of waits that began before
+        // recording started
+        std::uint64_t unmatched = 0;
+        // waits of locks beyond max_locks, or of tasks beyond max_tracked_tasks
+        std::uint64_t untracked = 0;
+        // callchains not recorded because of max_stack_nodes
+        std::uint64_t dropped_stacks = 0;
+    };
+
+    LockContentionAnalyzer(const tracepoint::TracepointEventAttr& contention_begin,
+                           const tracepoint::TracepointEventAttr& contention_end,
+                           Options options);
+    LockContentionAnalyzer(const tracepoint::TracepointEventAttr& contention_begin,
+                           const tracepoint::TracepointEventAttr& contention_end)
+    : LockContentionAnalyzer(contention_begin, contention_end, Options())
+    {
+    }
+
+    LockContentionAnalyzer(const tracepoint::TracepointFormat& contention_begin,
+                           const tracepoint::TracepointFormat& contention_end, Options options);
+
+    /**
+     * samples every contention with raw data, tid, time and cpu, and with
+     * the callchain of contention_begin if stacks is set
+     */
+    static void prepare(EventAttr& attr, bool stacks = false);
+
+    /**
+     * queues a contention_begin or contention_end sample, others are ignored
+     */
+    void process(const SampleView& sample);
+
+    void process(const RecordBatch& records, const RecordLayout& layout);
+
+    /**
+     * ends the reordering of the samples queued so far
+     */
+    void flush();
+
+    /**
+     * the wait time of all cpus
+     */
+    LatencyHistogram wait_time() const;
+
+    /**
+     * per-cpu statistics, indexed by cpu
+     */
+    const std::vector<CpuStats>& cpus() const
+    {
+        return cpus_;
+    }
+
+    /**
+     * per-lock statistics by lock address, for the first max_locks locks
+     */
+    const std::unordered_map<std::uint64_t, LockStats>& locks() const
+    {
+        return locks_;
+    }
+
+    /**
+     * per-task statistics by tid, for the first max_tracked_tasks tasks
+     */
+    const std::unordered_map<std::uint32_t, TaskStats>& tasks() const
+    {
+        return tasks_;
+    }
+
+    /**
+     * wait time in ns by the stack of contention_begin, if Options::stacks
+     */
+    const CallTree& stacks() const
+    {
+        return stacks_;
+    }
+
+    /**
+     * @returns the count locks with the most wait time, named from symbols if given
+     */
+    std::vector<Row> report(std::size_t count, const KernelSymbols* symbols = nullptr) const;
+
+    Counters counters() const
+    {
+        auto counters = counters_;
+        counters.late = queue_.late();
+        return counters;
+    }
+
+    /**
+     * clears the statistics, waits in progress and queued samples are kept
+     */
+    void reset();
+
+private:
+    struct Event
+    {
+        std::uint64_t time;
+        std::uint64_t lock;
+        std::uint32_t pid;
+        std::uint32_t tid;
+        std::uint32_t cpu;
+        std::uint32_t flags;
+        bool begin;
+        CallTree::NodeId stack;
+    };
+
+    struct Wait
+    {
+        std::uint64_t lock;
+        std::uint64_t since;
+        std::uint32_t flags;
+        CallTree::NodeId stack;
+    };
+
+    void handle(const Event& event);
+    void begin(const Event& event);
+    void end(const Event& event);
+
+    Options options_;
+    std::uint16_t begin_type_;
+    std::uint16_t end_type_;
+    tracepoint::EventField begin_lock_;
+    tracepoint::EventField begin_flags_;
+    tracepoint::EventField end_lock_;
+
+    ReorderBuffer<Event> queue_;
+    PairingTable<Wait> waits_;
+
+    std::vector<CpuStats> cpus_;
+    std::unordered_map<std::uint64_t, LockStats> locks_;
+    std::unordered_map<std::uint32_t, TaskStats> tasks_;
+    CallTree stacks_;
+    Counters counters_;
+};
+
+} // namespace analysis
+} // namespace perf_cpp
@@ -0,0 +1,297 @@
+/*
+ * This file is part of the perf_cpp library.
+ * Linux Perf C++ bindings
+ *
+ * Copyright (c) 2024,
+ *    Technische Universitaet Dresden, Germany
+ *
+ * perf_cpp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * perf_cpp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with perf_cpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace perf_cpp
+{
+
+namespace analysis
+{
+
+/**
+ * Fixed-capacity open addressing map from 64-bit keys to the state of an
+ * operation in flight, e.g. the entry time of a syscall by thread id, until
+ * the event that ends it arrives.
+ *
+ * All slots are allocated up front and inserts fail once capacity entries
+ * are in flight, so memory stays bounded no matter how many keys show up
+ * (entries of threads that never return are dropped by insert_evicting()
+ * or erase_if()).
+ * Lookups probe linearly at a load factor of at most 1/2, and removal
+ * shifts the following entries back instead of leaving tombstones, so
+ * probe sequences stay short under constant insert/remove churn.
+ *
+ * Not thread-safe.
+ */
+template <typename T>
+class PairingTable
+{
+public:
+    explicit PairingTable(std::size_t capacity) : capacity_(capacity)
+    {
+        if (capacity == 0)
+        {
+            throw std::invalid_argument("pairing table capacity must not be 0");
+        }
+        std::size_t slots = 2;
+        while (slots < 2 * capacity)
+        {
+            slots *= 2;
+        }
+        slots_.resize(slots);
+    }
+
+    /**
+     * inserts value under key or replaces the value already there
+     * @returns false if the key is new and the table is full
+     */
+    bool insert(std::uint64_t key, const T& value)
+    {
+        const std::size_t mask = slots_.size() - 1;
+        for (std::size_t slot = hash(key) & mask;; slot = (slot + 1) & mask)
+        {
+            auto& entry = slots_[slot];
+            if (!entry.used)
+            {
+                if (size_ == capacity_)
+                {
+                    return false;
+                }
+                entry.used = true;
+                entry.key = key;
+                entry.value = value;
+                size_++;
+                return true;
+            }
+            if (entry.key == key)
+            {
+                entry.value = value;
+                return true;
+            }
+        }
+    }
+
+    T* find(std::uint64_t key)
+    {
+        const std::size_t mask = slots_.size() - 1;
+        for (std::size_t slot = hash(key) & mask; slots_[slot].used; slot = (slot + 1) & mask)
+        {
+            if (slots_[slot].key == key)
+            {
+                return &slots_[slot].value;
+            }
+        }
+        return nullptr;
+    }
+
+    /**
+     * removes key and returns its value, if it is in the table
+     */
+    std::optional<T> take(std::uint64_t key)
+    {
+        const std::size_t mask = slots_.size() - 1;
+        for (std::size_t slot = hash(key) & mask; slots_[slot].used; slot = (slot + 1) & mask)
+        {
+            if (slots_[slot].key == key)
+            {
+                std::optional<T> value = std::move(slots_[slot].value);
+                remove(slot);
+                return value;
+            }
+        }
+        return std::nullopt;
+    }
+
+    /**
+     * Inserts value under key. If the table is full, entries older than
+     * stale at now, by their timestamp time(const T&), are evicted first and
+     * handed to evicted(key, const T&).
+     *
+     * A sweep walks the whole table, so after one the next is skipped until
+     * the oldest entry left can have become stale. A table full of live
+     * entries costs no more than a failed insert.
+     * @returns false if the table is still full
+     */
+    template <typename Time, typename Evicted>
+    bool insert_evicting(std::uint64_t key, const T& value, std::uint64_t now,
+                         std::uint64_t stale, Time&& time, Evicted&& evicted)
+    {
+        if (insert(key, value))
+        {
+            return true;
+        }
+        if (now <= sweep_after_)
+        {
+            return false;
+        }
+
+        std::uint64_t oldest = now;
+        erase_if(
+            [&](std::uint64_t other, const T& entry)
+            {
+                const std::uint64_t since = time(entry);
+                if (now > since && now - since > stale)
+                {
+                    evicted(other, entry);
+                    return true;
+                }
+                oldest = std::min(oldest, since);
+                return false;
+            });
+        sweep_after_ = oldest + stale;
+        return insert(key, value);
+    }
+
+    template <typename Time>
+    bool insert_evicting(std::uint64_t key, const T& value, std::uint64_t now,
+                         std::uint64_t stale, Time&& time)
+    {
+        return insert_evicting(key, value, now, stale, std::forward<Time>(time),
+                               [](std::uint64_t, const T&) {});
+    }
+
+    /**
+     * removes all entries for which pred(key, value) is true
+     * @returns the number of removed entries
+     */
+    template <typename F>
+    std::size_t erase_if(F&& pred)
+    {
+        std::vector<Slot> kept;
+        kept.reserve(size_);
+        std::size_t erased = 0;
+        for (auto& entry : slots_)
+        {
+            if (!entry.used)
+            {
+                continue;
+            }
+            if (pred(entry.key, static_cast<const T&>(entry.value)))
+            {
+                erased++;
+            }
+            else
+            {
+                kept.push_back(std::move(entry));
+            }
+            entry.used = false;
+        }
+
+        size_ = 0;
+        for (auto& entry : kept)
+        {
+            insert(entry.key, entry.value);
+        }
+        return erased;
+    }
+
+    /**
+     * calls f(key, T&) for every entry, f must not insert or remove entries
+     */
+    template <typename F>
+    void for_each(F&& f)
+    {
+        for (auto& entry : slots_)
+        {
+            if (entry.used)
+            {
+                f(static_cast<std::uint64_t>(entry.key), entry.value);
+            }
+        }
+    }
+
+    void clear()
+    {
+        for (auto& entry : slots_)
+        {
+            entry.used = false;
+        }
+        size_ = 0;
+        sweep_after_ = 0;
+    }
+
+    std::size_t size() const
+    {
+        return size_;
+    }
+
+    std::size_t capacity() const
+    {
+        return capacity_;
+    }
+
+private:
+    struct Slot
+    {
+        std::uint64_t key = 0;
+        bool used = false;
+        T value{};
+    };
+
+    static std::size_t hash(std::uint64_t key)
+    {
+        // murmur3 finalizer, thread ids and sectors are dense and need mixing
+        key ^= key >> 33;
+        key *= 0xff51afd7ed558ccdull;
+        key ^= key >> 33;
+        key *= 0xc4ceb9fe1a85ec53ull;
+        key ^= key >> 33;
+        return key;
+    }
+
+    // backward shift deletion: move later entries of the probe sequence
+    // into the hole, unless that would put them before their home slot
+    void remove(std::size_t hole)
+    {
+        const std::size_t mask = slots_.size() - 1;
+        for (std::size_t slot = (hole + 1) & mask; slots_[slot].used; slot = (slot + 1) & mask)
+        {
+            const std::size_t home = hash(slots_[slot].key) & mask;
+            // distance from home must not shrink below 0: the hole lies
+            // cyclically within [home, slot)
+            if (((slot - home) & mask) >= ((slot - hole) & mask))
+            {
+                slots_[hole] = std::move(slots_[slot]);
+                hole = slot;
+            }
+        }
+        slots_[hole].used = false;
+        size_--;
+    }
+
+    std::vector<Slot> slots_;
+    std::size_t size_ = 0;
+    std::size_t capacity_;
+    // no entry can be stale before this time, see insert_evicting()
+    std::uint64_t sweep_after_ = 0;
+};
+
+} // namespace analysis
+} // namespace perf_cpp
@@ -0,0 +1,146 @@
+/*
+ * This file is part of the perf_cpp library.
+ * Linux Perf C++ bindings
+ *
+ * Copyright (c) 2024,
+ *    Technische Universitaet Dresden, Germany
+ *
+ * perf_cpp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * perf_cpp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with perf_cpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+namespace perf_cpp
+{
+
+namespace analysis
+{
+
+/**
+ * Puts items from several per-cpu streams back into timestamp order.
+ *
+ * Items are held in a min-heap until the newest timestamp seen is window
+ * past theirs, then handed out oldest first. Items older than what was
+ * already handed out are handed out immediately and counted as late, the
+ * window was too short for them.
+ *
+ * Ties are broken by arrival, so items of one stream keep their order.
+ */
+template <typename T>
+class ReorderBuffer
+{
+public:
+    explicit ReorderBuffer(std::chrono::nanoseconds window)
+    : window_(static_cast<std::uint64_t>(window.count()))
+    {
+    }
+
+    /**
+     * adds item and calls handler(const T&) for every item that left the window
+     */
+    template <typename F>
+    void push(std::uint64_t time, T item, F&& handler)
+    {
+        if (time < handed_out_until_)
+        {
+            late_++;
+            handler(static_cast<const T&>(item));
+            return;
+        }
+
+        heap_.push_back(Entry{ time, sequence_++, std::move(item) });
+        std::push_heap(heap_.begin(), heap_.end(), later);
+        newest_ = std::max(newest_, time);
+
+        while (!heap_.empty() && heap_.front().time + window_ <= newest_)
+        {
+            std::pop_heap(heap_.begin(), heap_.end(), later);
+            handed_out_until_ = heap_.back().time;
+            handler(static_cast<const T&>(heap_.back().item));
+            heap_.pop_back();
+        }
+    }
+
+    /**
+     * hands out all items, e.g. at the end of a recording
+     */
+    template <typename F>
+    void flush(F&& handler)
+    {
+        std::sort(heap_.begin(), heap_.end(),
+                  [](const Entry& lhs, const Entry& rhs) { return later(rhs, lhs); });
+        for (const auto& entry : heap_)
+        {
+            handed_out_until_ = entry.time;
+            handler(entry.item);
+        }
+        heap_.clear();
+    }
+
+    /**
+     * calls f(T&) for every held item, in no particular order
+     */
+    template <typename F>
+    void for_each(F&& f)
+    {
+        for (auto& entry : heap_)
+        {
+            f(entry.item);
+        }
+    }
+
+    std::size_t size() const
+    {
+        return heap_.size();
+    }
+
+    std::uint64_t late() const
+    {
+        return late_;
+    }
+
+    void reset_late()
+    {
+        late_ = 0;
+    }
+
+private:
+    struct Entry
+    {
+        std::uint64_t time;
+        std::uint64_t sequence;
+        T item;
+    };
+
+    // the heap comparator: a max-heap on "later" keeps the oldest on top
+    static bool later(const Entry& lhs, const Entry& rhs)
+    {
+        return lhs.time != rhs.time ? lhs.time > rhs.time : lhs.sequence > rhs.sequence;
+    }
+
+    std::uint64_t window_;
+    std::vector<Entry> heap_;
+    std::uint64_t sequence_ = 0;
+    std::uint64_t newest_ = 0;
+    std::uint64_t handed_out_until_ = 0;
+    std::uint64_t late_ = 0;
+};
+
+} // namespace analysis
+} // namespace perf_cpp
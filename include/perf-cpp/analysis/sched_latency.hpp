@@ -0,0 +1,275 @@
+/*
+ * This file is part of the perf_cpp library.
+ * Linux Perf C++ bindings
+ *
+ * Copyright (c) 2024,
+ *    Technische Universitaet Dresden, Germany
+ *
+ * perf_cpp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * perf_cpp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with perf_cpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <perf-cpp/analysis/histogram.hpp>
+#include <perf-cpp/analysis/pairing_table.hpp>
+#include <perf-cpp/analysis/reorder_buffer.hpp>
+#include <perf-cpp/call_tree.hpp>
+#include <perf-cpp/record.hpp>
+#include <perf-cpp/tracepoint/event_attr.hpp>
+#include <perf-cpp/tracepoint/format.hpp>
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+namespace perf_cpp
+{
+
+namespace analysis
+{
+
+/**
+ * Why a thread left the cpu, from prev_state of sched_switch
+ */
+enum class BlockReason
+{
+    // still runnable, i.e. preempted or yielded
+    PREEMPTED,
+    // S: interruptible sleep, e.g. waiting for a lock, a socket or a timer
+    SLEEPING,
+    // D: uninterruptible sleep, usually disk I/O or page faults
+    UNINTERRUPTIBLE,
+    // T and t
+    STOPPED,
+    // I: kernel threads waiting for work
+    IDLE,
+    // X, Z, P and unknown states
+    OTHER,
+};
+
+constexpr std::size_t block_reason_count = 6;
+
+const char* to_string(BlockReason reason);
+
+/**
+ * @returns the reason for a prev_state of sched_switch
+ */
+BlockReason block_reason(std::uint64_t prev_state);
+
+/**
+ * The "why isn't my thread running" view, from sched:sched_switch,
+ * sched:sched_wakeup and sched:sched_migrate_task samples of all cpus:
+ *
+ *  - run-queue latency: from a wakeup (or being preempted) until the thread
+ *    is switched in, in total and per thread
+ *  - off-cpu time: from being switched out until being switched in again,
+ *    split by the BlockReason of the switch-out
+ *  - migrations between cpus, in total and per thread
+ *  - optionally off-cpu time by the stack the thread blocked in, if the
+ *    tracepoints are sampled with PERF_SAMPLE_CALLCHAIN
+ *
+ * Wakeups and switches of one thread happen on different cpus, so samples
+ * are held back for a reordering window and processed in timestamp order.
+ * Samples that arrive later than the window are still processed and
+ * counted as late. Per-thread state lives in a PairingTable and the number
+ * of per-thread histograms is bounded, so memory does not grow with the
+ * number of threads. The stack tree is bounded by max_stack_nodes and
+ * shrinks to the stacks still in use on reset(), so long runs should reset
+ * periodically. Not thread-safe.
+ */
+class SchedLatencyAnalyzer
+{
+public:
+    struct Options
+    {
+        // threads that can be off-cpu or runnable at the same time
+        std::size_t max_threads = 32768;
+        // threads with their own run-queue histogram and counters
+        std::size_t max_tracked_threads = 1024;
+        unsigned precision = 4;
+        // samples are processed once the newest sample is this much newer,
+        // a few wakeup periods of the ring buffers is safe
+        std::chrono::nanoseconds reorder_window = std::chrono::milliseconds(100);
+        // off-cpu states older than this are dropped when the table is full
+        std::chrono::nanoseconds stale_after = std::chrono::seconds(60);
+        // attribute off-cpu time to the callchain of the switch-out
+        bool stacks = false;
+        // nodes of off_cpu_stacks(), further callchains are not recorded
+        std::size_t max_stack_nodes = 262144;
+    };
+
+    struct ThreadStats
+    {
+        explicit ThreadStats(unsigned precision) : run_queue_latency(precision)
+        {
+        }
+
+        LatencyHistogram run_queue_latency;
+        std::uint64_t off_cpu_time = 0;
+        std::uint64_t migrations = 0;
+    };
+
+    struct Counters
+    {
+        // samples that arrived after the reordering window
+        std::uint64_t late = 0;
+        // state dropped because the thread table was full
+        std::uint64_t dropped = 0;
+        // threads beyond max_tracked_threads
+        std::uint64_t untracked = 0;
+        // callchains not recorded because of max_stack_nodes
+        std::uint64_t dropped_stacks = 0;
+    };
+
+    SchedLatencyAnalyzer(const tracepoint::TracepointEventAttr& sched_switch,
+                         const tracepoint::TracepointEventAttr& sched_wakeup,
+                         const tracepoint::TracepointEventAttr& sched_migrate_task,
+                         Options options);
+    SchedLatencyAnalyzer(const tracepoint::TracepointEventAttr& sched_switch,
+                         const tracepoint::TracepointEventAttr& sched_wakeup,
+                         const tracepoint::TracepointEventAttr& sched_migrate_task)
+    : SchedLatencyAnalyzer(sched_switch, sched_wakeup, sched_migrate_task, Options())
+    {
+    }
+
+    SchedLatencyAnalyzer(const tracepoint::TracepointFormat& sched_switch,
+                         const tracepoint::TracepointFormat& sched_wakeup,
+                         const tracepoint::TracepointFormat& sched_migrate_task,
+                         Options options);
+
+    /**
+     * samples every hit of a sched tracepoint with raw data, tid and time,
+     * and with the callchain if stacks is set
+     */
+    static void prepare(EventAttr& attr, bool stacks = false);
+
+    /**
+     * Holds back a sched_switch, sched_wakeup or sched_migrate_task sample
+     * until the reordering window passed it, other samples are ignored
+     */
+    void process(const SampleView& sample);
+
+    void process(const RecordBatch& records, const RecordLayout& layout);
+
+    /**
+     * handles the held back samples, e.g. once the recording stopped
+     */
+    void flush();
+
+    const LatencyHistogram& run_queue_latency() const
+    {
+        return run_queue_latency_;
+    }
+
+    const LatencyHistogram& off_cpu_time(BlockReason reason) const
+    {
+        return off_cpu_time_[static_cast<std::size_t>(reason)];
+    }
+
+    std::uint64_t migrations() const
+    {
+        return migrations_;
+    }
+
+    /**
+     * per-thread statistics, for the first max_tracked_threads threads
+     */
+    const std::unordered_map<std::uint32_t, ThreadStats>& threads() const
+    {
+        return threads_;
+    }
+
+    /**
+     * off-cpu time in ns by the stack of the switch-out, if Options::stacks
+     */
+    const CallTree& off_cpu_stacks() const
+    {
+        return off_cpu_stacks_;
+    }
+
+    Counters counters() const
+    {
+        auto counters = counters_;
+        counters.late = queue_.late();
+        return counters;
+    }
+
+    /**
+     * Clears the statistics, threads in flight and queued samples are kept.
+     * The stack tree is rebuilt from the stacks they still refer to.
+     */
+    void reset();
+
+private:
+    enum class Type : std::uint8_t
+    {
+        SWITCH,
+        WAKEUP,
+        MIGRATE,
+    };
+
+    // the fields of a sample that matter, so the record can be released
+    struct Event
+    {
+        std::uint64_t time;
+        Type type;
+        // prev_pid or pid
+        std::uint32_t pid;
+        // next_pid
+        std::uint32_t next_pid;
+        std::uint64_t prev_state;
+        CallTree::NodeId stack;
+    };
+
+    struct ThreadState
+    {
+        // 0 if the thread is not off-cpu / not runnable
+        std::uint64_t off_cpu_since = 0;
+        std::uint64_t runnable_since = 0;
+        BlockReason reason = BlockReason::PREEMPTED;
+        CallTree::NodeId stack = CallTree::root;
+    };
+
+    void handle(const Event& event);
+    void switch_out(const Event& event);
+    void switch_in(const Event& event);
+    void update(std::uint32_t tid, std::uint64_t time, const ThreadState& state);
+    ThreadStats* stats(std::uint32_t tid);
+
+    Options options_;
+    std::uint16_t switch_type_;
+    std::uint16_t wakeup_type_;
+    std::uint16_t migrate_type_;
+    tracepoint::EventField prev_pid_;
+    tracepoint::EventField prev_state_;
+    tracepoint::EventField next_pid_;
+    tracepoint::EventField wakeup_pid_;
+    tracepoint::EventField migrate_pid_;
+
+    ReorderBuffer<Event> queue_;
+
+    PairingTable<ThreadState> states_;
+    LatencyHistogram run_queue_latency_;
+    std::array<LatencyHistogram, block_reason_count> off_cpu_time_;
+    std::uint64_t migrations_ = 0;
+    std::unordered_map<std::uint32_t, ThreadStats> threads_;
+    CallTree off_cpu_stacks_;
+    Counters counters_;
+};
+
+} // namespace analysis
+} // namespace perf_cpp
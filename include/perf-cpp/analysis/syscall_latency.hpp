@@ -0,0 +1,194 @@
+/*
+ * This file is part of the perf_cpp library.
+ * Linux Perf C++ bindings
+ *
+ * Copyright (c) 2024,
+ *    Technische Universitaet Dresden, Germany
+ *
+ * perf_cpp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * perf_cpp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with perf_cpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <perf-cpp/analysis/histogram.hpp>
+#include <perf-cpp/analysis/pairing_table.hpp>
+#include <perf-cpp/record.hpp>
+#include <perf-cpp/tracepoint/event_attr.hpp>
+#include <perf-cpp/tracepoint/format.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+namespace perf_cpp
+{
+
+namespace analysis
+{
+
+/**
+ * Online syscall latency histograms from raw_syscalls:sys_enter and
+ * raw_syscalls:sys_exit samples.
+ *
+ * Enters are paired with the next exit of the same thread through a
+ * PairingTable, and the time in between is recorded into one histogram per
+ * syscall and one per (syscall, process). Only the histograms are kept, not
+ * the events, and all tables are bounded by the Options: enters that find
+ * the pairing table full and processes beyond max_processes are counted
+ * instead of growing memory.
+ *
+ * Both tracepoints must be sampled with a period of 1 and PERF_SAMPLE_RAW,
+ * _TID and _TIME, see prepare(). Samples of all cpus may be fed to one
+ * analyzer, a thread can not be on two cpus at once. Not thread-safe.
+ */
+class SyscallLatencyAnalyzer
+{
+public:
+    struct Options
+    {
+        // threads that can be in a syscall at the same time
+        std::size_t max_threads = 16384;
+        std::size_t max_syscalls = 1024;
+        // (syscall, process) histograms
+        std::size_t max_processes = 1024;
+        // histogram precision, see LatencyHistogram
+        unsigned precision = 4;
+        // enters older than this are dropped when the pairing table is full,
+        // e.g. of threads that exited inside exit() or are blocked for good
+        std::chrono::nanoseconds stale_after = std::chrono::seconds(60);
+    };
+
+    struct Row
+    {
+        std::int64_t syscall;
+        // nullopt for the histogram of all processes
+        std::optional<std::uint32_t> pid;
+        std::uint64_t count;
+        std::uint64_t min;
+        std::uint64_t max;
+        double mean;
+        // in the order of the requested quantiles
+        std::vector<std::uint64_t> percentiles;
+    };
+
+    struct Report
+    {
+        // sample times of the first and last recorded exit
+        std::uint64_t begin = 0;
+        std::uint64_t end = 0;
+        std::vector<double> quantiles;
+        // sorted by syscall, the all-process row first
+        std::vector<Row> rows;
+
+        // enters that did not fit into the pairing table
+        std::uint64_t dropped_enters = 0;
+        // exits without a matching enter, e.g. of syscalls entered before
+        // recording started
+        std::uint64_t unmatched_exits = 0;
+        // latencies not recorded per syscall/process for the table limits
+        std::uint64_t untracked = 0;
+    };
+
+    SyscallLatencyAnalyzer(const tracepoint::TracepointEventAttr& enter,
+                           const tracepoint::TracepointEventAttr& exit, Options options);
+    SyscallLatencyAnalyzer(const tracepoint::TracepointEventAttr& enter,
+                           const tracepoint::TracepointEventAttr& exit)
+    : SyscallLatencyAnalyzer(enter, exit, Options())
+    {
+    }
+
+    /**
+     * for formats that were saved with a recording
+     */
+    SyscallLatencyAnalyzer(const tracepoint::TracepointFormat& enter,
+                           const tracepoint::TracepointFormat& exit, Options options);
+
+    /**
+     * sets the sample type and period the analyzer needs on either tracepoint
+     */
+    static void prepare(EventAttr& attr);
+
+    /**
+     * Processes one sample of either tracepoint, samples of other events
+     * are ignored. Samples of one thread must be processed in time order.
+     */
+    void process(const SampleView& sample);
+
+    /**
+     * processes all samples in records, decoded with layout
+     */
+    void process(const RecordBatch& records, const RecordLayout& layout);
+
+    /**
+     * Calls callback with a report() and reset()s the histograms every
+     * interval of sample time, checked on every exit.
+     */
+    void report_every(std::chrono::nanoseconds interval, std::vector<double> quantiles,
+                      std::function<void(const Report&)> callback);
+
+    /**
+     * @returns the histogram of syscall for pid or, without pid, of all
+     * processes, nullptr if there are none
+     */
+    const LatencyHistogram* histogram(std::int64_t syscall,
+                                      std::optional<std::uint32_t> pid = std::nullopt) const;
+
+    Report report(const std::vector<double>& quantiles = { 0.5, 0.9, 0.99, 0.999 }) const;
+
+    /**
+     * clears the histograms and counters, syscalls in flight are kept
+     */
+    void reset();
+
+private:
+    struct InFlight
+    {
+        std::int64_t syscall;
+        std::uint64_t time;
+        std::uint32_t pid;
+    };
+
+    void enter(const SampleView& sample, std::int64_t syscall);
+    void exit(const SampleView& sample, std::int64_t syscall);
+    LatencyHistogram* find_or_add(std::unordered_map<std::uint64_t, LatencyHistogram>& map,
+                                  std::uint64_t key, std::size_t limit);
+
+    Options options_;
+    std::uint16_t enter_type_;
+    std::uint16_t exit_type_;
+    tracepoint::EventField enter_id_;
+    tracepoint::EventField exit_id_;
+
+    PairingTable<InFlight> in_flight_;
+    std::unordered_map<std::uint64_t, LatencyHistogram> by_syscall_;
+    // keyed by (syscall << 32 | pid)
+    std::unordered_map<std::uint64_t, LatencyHistogram> by_process_;
+
+    std::uint64_t begin_ = 0;
+    std::uint64_t end_ = 0;
+    std::uint64_t dropped_enters_ = 0;
+    std::uint64_t unmatched_exits_ = 0;
+    std::uint64_t untracked_ = 0;
+
+    std::chrono::nanoseconds interval_{ 0 };
+    std::vector<double> interval_quantiles_;
+    std::function<void(const Report&)> callback_;
+    std::uint64_t interval_begin_ = 0;
+};
+
+} // namespace analysis
+} // namespace perf_cpp
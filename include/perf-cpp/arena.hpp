@@ -0,0 +1,301 @@
+/*
+ * This file is part of the perf_cpp library.
+ * Linux Perf C++ bindings
+ *
+ * Copyright (c) 2024,
+ *    Technische Universitaet Dresden, Germany
+ *
+ * perf_cpp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * perf_cpp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with perf_cpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace perf_cpp
+{
+
+/**
+ * Thread-safe cache of equally sized memory chunks, shared by arenas that
+ * free their chunks on one thread and refill them on another one.
+ */
+class ChunkPool
+{
+public:
+    ChunkPool(std::size_t chunk_size = 256 * 1024, std::size_t max_cached = 64)
+    : chunk_size_(chunk_size), max_cached_(max_cached)
+    {
+    }
+
+    ChunkPool(const ChunkPool&) = delete;
+    ChunkPool& operator=(const ChunkPool&) = delete;
+
+    ~ChunkPool();
+
+    std::byte* acquire();
+    void release(std::byte* chunk);
+
+    std::size_t chunk_size() const
+    {
+        return chunk_size_;
+    }
+
+private:
+    std::size_t chunk_size_;
+    std::size_t max_cached_;
+
+    std::mutex mutex_;
+    std::vector<std::byte*> chunks_;
+};
+
+/**
+ * Bump allocator for data that dies together, e.g. all samples of a batch.
+ *
+ * Allocation is a pointer increment, and there is no per-allocation free:
+ * reset() rewinds the arena to its first chunk in O(1) and keeps all chunks
+ * for reuse, release() gives them back to the ChunkPool (or the heap).
+ *
+ * Objects placed in the arena are never destroyed, so only trivially
+ * destructible types can be created in it. Not thread-safe, use one arena
+ * per thread.
+ */
+class Arena
+{
+public:
+    Arena(std::size_t chunk_size = 64 * 1024) : chunk_size_(chunk_size)
+    {
+    }
+
+    Arena(ChunkPool& pool) : chunk_size_(pool.chunk_size()), pool_(&pool)
+    {
+    }
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    Arena(Arena&& other) noexcept;
+    Arena& operator=(Arena&& other) noexcept;
+
+    ~Arena()
+    {
+        release();
+    }
+
+    void* allocate(std::size_t bytes, std::size_t align = alignof(std::max_align_t))
+    {
+        auto pos = (reinterpret_cast<std::uintptr_t>(pos_) + align - 1) & ~(align - 1);
+        if (pos + bytes > reinterpret_cast<std::uintptr_t>(end_))
+        {
+            return allocate_slow(bytes, align);
+        }
+        pos_ = reinterpret_cast<std::byte*>(pos + bytes);
+        allocated_ += bytes;
+        return reinterpret_cast<void*>(pos);
+    }
+
+    template <typename T>
+    T* allocate_array(std::size_t count)
+    {
+        static_assert(std::is_trivially_destructible_v<T>,
+                      "Arena never runs destructors, T must be trivially destructible");
+        return static_cast<T*>(allocate(sizeof(T) * count, alignof(T)));
+    }
+
+    template <typename T, typename... Args>
+    T* create(Args&&... args)
+    {
+        static_assert(std::is_trivially_destructible_v<T>,
+                      "Arena never runs destructors, T must be trivially destructible");
+        return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    }
+
+    template <typename T>
+    T* copy(const T* data, std::size_t count)
+    {
+        static_assert(std::is_trivially_copyable_v<T>);
+        if (count == 0)
+        {
+            return nullptr;
+        }
+        auto* res = allocate_array<T>(count);
+        std::memcpy(res, data, sizeof(T) * count);
+        return res;
+    }
+
+    std::string_view copy(std::string_view str)
+    {
+        return std::string_view(copy(str.data(), str.size()), str.size());
+    }
+
+    /**
+     * frees everything allocated so far in O(1), the chunks are kept
+     */
+    void reset()
+    {
+        for (auto* large : large_)
+        {
+            ::operator delete(large);
+        }
+        large_.clear();
+
+        current_ = 0;
+        if (!chunks_.empty())
+        {
+            pos_ = chunks_.front();
+            end_ = pos_ + chunk_size_;
+        }
+        allocated_ = 0;
+    }
+
+    /**
+     * frees everything and returns the chunks
+     */
+    void release();
+
+    // bytes handed out since the last reset
+    std::size_t allocated() const
+    {
+        return allocated_;
+    }
+
+    // bytes held by the arena
+    std::size_t capacity() const
+    {
+        return chunks_.size() * chunk_size_;
+    }
+
+private:
+    void* allocate_slow(std::size_t bytes, std::size_t align);
+
+    std::size_t chunk_size_;
+    ChunkPool* pool_ = nullptr;
+
+    std::vector<std::byte*> chunks_;
+    std::size_t current_ = 0;
+    std::byte* pos_ = nullptr;
+    std::byte* end_ = nullptr;
+
+    // allocations larger than a chunk get their own block
+    std::vector<void*> large_;
+    std::size_t allocated_ = 0;
+};
+
+/**
+ * Allocator for fixed-size objects (e.g. SampleView) in blocks of
+ * objects_per_block, with a free list for single objects. clear() frees all
+ * objects at once while keeping the blocks.
+ */
+template <typename T>
+class Slab
+{
+    static_assert(std::is_trivially_destructible_v<T>,
+                  "Slab::clear() does not run destructors, T must be trivially destructible");
+
+public:
+    Slab(std::size_t objects_per_block = 1024)
+    : objects_per_block_(objects_per_block > 0 ? objects_per_block : 1)
+    {
+    }
+
+    Slab(const Slab&) = delete;
+    Slab& operator=(const Slab&) = delete;
+
+    ~Slab()
+    {
+        for (auto* block : blocks_)
+        {
+            ::operator delete(block, std::align_val_t(alignof(Slot)));
+        }
+    }
+
+    template <typename... Args>
+    T* create(Args&&... args)
+    {
+        return new (allocate()) T(std::forward<Args>(args)...);
+    }
+
+    void destroy(T* object)
+    {
+        auto* slot = reinterpret_cast<Slot*>(object);
+        slot->next = free_;
+        free_ = slot;
+        live_--;
+    }
+
+    /**
+     * frees all objects in O(1), the blocks are kept
+     */
+    void clear()
+    {
+        free_ = nullptr;
+        block_ = 0;
+        used_ = 0;
+        live_ = 0;
+    }
+
+    std::size_t size() const
+    {
+        return live_;
+    }
+
+private:
+    union Slot
+    {
+        Slot* next;
+        alignas(T) std::byte storage[sizeof(T)];
+    };
+
+    void* allocate()
+    {
+        live_++;
+        if (free_ != nullptr)
+        {
+            auto* slot = free_;
+            free_ = slot->next;
+            return slot;
+        }
+
+        if (blocks_.empty() || used_ == objects_per_block_)
+        {
+            if (!blocks_.empty())
+            {
+                block_++;
+            }
+            if (block_ == blocks_.size())
+            {
+                blocks_.push_back(static_cast<Slot*>(::operator new(
+                    sizeof(Slot) * objects_per_block_, std::align_val_t(alignof(Slot)))));
+            }
+            used_ = 0;
+        }
+        return &blocks_[block_][used_++];
+    }
+
+    std::size_t objects_per_block_;
+    std::vector<Slot*> blocks_;
+    std::size_t block_ = 0;
+    std::size_t used_ = 0;
+    Slot* free_ = nullptr;
+    std::size_t live_ = 0;
+};
+
+} // namespace perf_cpp
@@ -0,0 +1,183 @@
+/*
+ * This file is part of the perf_cpp library.
+ * Linux Perf C++ bindings
+ *
+ * Copyright (c) 2024,
+ *    Technische Universitaet Dresden, Germany
+ *
+ * perf_cpp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * perf_cpp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with perf_cpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <perf-cpp/record.hpp>
+#include <perf-cpp/types.hpp>
+
+#include <cstdint>
+#include <functional>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace perf_cpp
+{
+
+/**
+ * Prefix tree of callchains with hash-consed nodes: every (parent, ip) pair
+ * exists exactly once, so a stack that was seen before costs one hash lookup
+ * per frame and no memory. Samples are accumulated as weights of the node of
+ * their innermost frame.
+ *
+ * Node ids are assigned in insertion order, so a parent always has a smaller
+ * id than its children. The root (id 0) has no ip.
+ *
+ * Not thread-safe, use one tree per cpu (see CallTreeShards) and merge them.
+ */
+class CallTree
+{
+public:
+    using NodeId = std::uint32_t;
+    static constexpr NodeId root = 0;
+
+    struct Node
+    {
+        std::uint64_t ip;
+        NodeId parent;
+        // weight of the samples that ended in this node
+        std::uint64_t self;
+    };
+
+    CallTree();
+
+    /**
+     * Adds a callchain as recorded by PERF_SAMPLE_CALLCHAIN, i.e. innermost
+     * frame first. The PERF_CONTEXT_* markers are skipped.
+     * @returns the node of the innermost frame
+     */
+    NodeId add(const std::uint64_t* callchain, std::size_t size, std::uint64_t weight = 1);
+
+    NodeId add(const SampleView& sample, std::uint64_t weight = 1)
+    {
+        return add(sample.callchain, sample.callchain_size, weight);
+    }
+
+    /**
+     * @returns the child of parent with ip, creating it if necessary
+     */
+    NodeId intern(NodeId parent, std::uint64_t ip);
+
+    /**
+     * adds weight to a node returned by add() or intern(), e.g. once the
+     * duration of an off-cpu period that started at that stack is known
+     */
+    void add_weight(NodeId node, std::uint64_t weight)
+    {
+        nodes_.at(node).self += weight;
+        total_weight_ += weight;
+    }
+
+    /**
+     * sets the weights of all nodes to 0, but keeps the nodes and their ids
+     */
+    void clear_weights()
+    {
+        for (auto& node : nodes_)
+        {
+            node.self = 0;
+        }
+        total_weight_ = 0;
+    }
+
+    /**
+     * copies the stack ending in node of other into this tree, without its weight
+     * @returns the node of the stack in this tree
+     */
+    NodeId import(const CallTree& other, NodeId node);
+
+    /**
+     * adds all stacks and weights of other to this tree
+     */
+    void merge(const CallTree& other);
+
+    const std::vector<Node>& nodes() const
+    {
+        return nodes_;
+    }
+
+    std::size_t size() const
+    {
+        return nodes_.size();
+    }
+
+    std::uint64_t total_weight() const
+    {
+        return total_weight_;
+    }
+
+    /**
+     * @returns the inclusive weight of every node, indexed by NodeId
+     */
+    std::vector<std::uint64_t> totals() const;
+
+    /**
+     * Writes one "outermost;...;innermost weight" line per node that has
+     * self weight, the input format of flamegraph.pl and most other flame
+     * graph tools. Frames are printed as hex addresses, unless a symbolizer
+     * is given.
+     */
+    void write_folded(std::ostream& out,
+                      const std::function<std::string(std::uint64_t)>& symbolize = {}) const;
+
+    /**
+     * Compact binary dump of the node table, the nodes are written in id
+     * order as (parent: u32, ip: u64, self: u64) in host byte order.
+     */
+    void write_binary(std::ostream& out) const;
+    static CallTree read_binary(std::istream& in);
+
+private:
+    void grow();
+
+    std::vector<Node> nodes_;
+    // open addressing table of node ids keyed by (parent, ip), 0 is empty
+    std::vector<NodeId> slots_;
+    std::uint64_t total_weight_ = 0;
+};
+
+/**
+ * One CallTree per cpu, so that readers can aggregate without locking. All
+ * shards are created up front, so shard() never touches shared state.
+ */
+class CallTreeShards
+{
+public:
+    // creates a shard for every online cpu
+    CallTreeShards();
+
+    CallTree& shard(Cpu cpu)
+    {
+        return shards_.at(cpu.as_int());
+    }
+
+    /**
+     * merges all shards into a single tree
+     */
+    CallTree merge() const;
+
+private:
+    std::vector<CallTree> shards_;
+};
+
+} // namespace perf_cpp
@@ -0,0 +1,191 @@
+/*
+ * This file is part of the perf_cpp library.
+ * Linux Perf C++ bindings
+ *
+ * Copyright (c) 2024,
+ *    Technische Universitaet Dresden, Germany
+ *
+ * perf_cpp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * perf_cpp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with perf_cpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+extern "C"
+{
+#include <linux/perf_event.h>
+}
+
+namespace perf_cpp
+{
+
+/**
+ * The largest configuration the current process can open, as predicted from
+ * the Capabilities profile.
+ */
+struct MaxConfiguration
+{
+    bool cpu_wide;
+    bool kernel;
+    bool raw_tracepoints;
+    std::uint64_t max_sample_freq;
+    // file descriptors available per cpu
+    std::size_t events_per_cpu;
+    // power-of-two data pages per ring buffer, 0 if not even one fits
+    std::size_t data_pages_per_buffer;
+};
+
+/**
+ * One-time snapshot of everything the kernel checks in perf_event_open() and
+ * perf_mmap(): perf_event_paranoid, capabilities and resource limits.
+ *
+ * Use it to plan a configuration up front instead of finding out by failing
+ * syscalls.
+ */
+class Capabilities
+{
+private:
+    Capabilities();
+
+public:
+    static const Capabilities& instance()
+    {
+        static Capabilities c;
+
+        return c;
+    }
+
+    int paranoid() const
+    {
+        return paranoid_;
+    }
+
+    bool cap_perfmon() const
+    {
+        return cap_perfmon_;
+    }
+
+    bool cap_sys_admin() const
+    {
+        return cap_sys_admin_;
+    }
+
+    bool cap_ipc_lock() const
+    {
+        return cap_ipc_lock_;
+    }
+
+    // CAP_PERFMON was split out of CAP_SYS_ADMIN in Linux 5.8, either is fine
+    bool privileged() const
+    {
+        return cap_perfmon_ || cap_sys_admin_;
+    }
+
+    std::uint64_t mlock_kb() const
+    {
+        return mlock_kb_;
+    }
+
+    std::uint64_t max_sample_rate() const
+    {
+        return max_sample_rate_;
+    }
+
+    std::uint64_t nofile_limit() const
+    {
+        return nofile_limit_;
+    }
+
+    std::uint64_t memlock_limit() const
+    {
+        return memlock_limit_;
+    }
+
+    std::size_t page_size() const
+    {
+        return page_size_;
+    }
+
+    bool kernel_allowed() const
+    {
+        return privileged() || paranoid_ < 2;
+    }
+
+    bool cpu_wide_allowed() const
+    {
+        return privileged() || paranoid_ < 1;
+    }
+
+    bool raw_tracepoints_allowed() const
+    {
+        return privileged() || paranoid_ < 0;
+    }
+
+    bool any_allowed() const
+    {
+        return privileged() || paranoid_ <= 2;
+    }
+
+    /**
+     * Would perf_event_paranoid and the capabilities allow attr at location?
+     * Configuration errors are left to is_valid().
+     * @param cpu_wide true if the event is opened per cpu instead of per thread
+     */
+    bool is_permitted(const perf_event_attr& attr, bool cpu_wide) const;
+
+    /**
+     * Is attr within the limits the kernel enforces for everyone, i.e. a
+     * sample_freq of at most perf_event_max_sample_rate?
+     * @returns false if perf_event_open() would fail with EINVAL
+     */
+    bool is_valid(const perf_event_attr& attr) const;
+
+    /**
+     * Changes attr so it is not rejected for permission reasons: sets
+     * exclude_kernel where kernel profiling is forbidden and clamps sample_freq
+     * to perf_event_max_sample_rate, so the result is also is_valid().
+     * @returns false if the event can not be permitted at all
+     */
+    bool adjust(perf_event_attr& attr, bool cpu_wide) const;
+
+    /**
+     * Number of pages the current user may map in perf ring buffers, including
+     * the header page of each buffer. SIZE_MAX if unlimited.
+     */
+    std::size_t mmap_page_budget() const;
+
+    /**
+     * largest power-of-two number of data pages such that buffers ring buffers
+     * fit into the mmap_page_budget(), 0 if not even one page fits
+     */
+    std::size_t max_data_pages(std::size_t buffers) const;
+
+    MaxConfiguration max_configuration(std::size_t cpus) const;
+
+private:
+    int paranoid_ = 2;
+    bool cap_perfmon_ = false;
+    bool cap_sys_admin_ = false;
+    bool cap_ipc_lock_ = false;
+    std::uint64_t mlock_kb_ = 516;
+    std::uint64_t max_sample_rate_ = 100000;
+    std::uint64_t nofile_limit_ = 1024;
+    std::uint64_t memlock_limit_ = 0;
+    std::size_t online_cpus_ = 1;
+    std::size_t page_size_ = 4096;
+};
+
+} // namespace perf_cpp
@@ -0,0 +1,226 @@
+/*
+ * This file is part of the perf_cpp library.
+ * Linux Perf C++ bindings
+ *
+ * Copyright (c) 2024,
+ *    Technische Universitaet Dresden, Germany
+ *
+ * perf_cpp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * perf_cpp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with perf_cpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace perf_cpp
+{
+
+struct ElfSection
+{
+    const std::byte* data;
+    std::size_t size;
+    // SHF_* flags, e.g. SHF_COMPRESSED
+    std::uint64_t flags;
+    // virtual address of the section when loaded, 0 if it is not loaded
+    std::uint64_t address;
+};
+
+/**
+ * Read-only mapping of a whole ELF file. The file is mmap()ed instead of
+ * read, so only the pages of the tables that are actually parsed are ever
+ * loaded, and processes that map the same binary share the page cache.
+ */
+class ElfFile
+{
+public:
+    ElfFile(const std::filesystem::path& path);
+
+    ElfFile(const ElfFile&) = delete;
+    ElfFile& operator=(const ElfFile&) = delete;
+
+    ~ElfFile();
+
+    const std::byte* data() const
+    {
+        return data_;
+    }
+
+    std::size_t size() const
+    {
+        return size_;
+    }
+
+    const std::filesystem::path& path() const
+    {
+        return path_;
+    }
+
+    /**
+     * @returns the hex string of the NT_GNU_BUILD_ID note, if there is one
+     */
+    std::optional<std::string> build_id() const;
+
+    /**
+     * @returns e_machine of the ELF header, e.g. EM_X86_64
+     */
+    std::uint16_t machine() const;
+
+    /**
+     * @returns the contents of the section called name, if the file has it
+     */
+    std::optional<ElfSection> section(std::string_view name) const;
+
+private:
+    std::filesystem::path path_;
+    const std::byte* data_ = nullptr;
+    std::size_t size_ = 0;
+};
+
+struct ElfSymbol
+{
+    std::uint64_t start;
+    std::uint64_t end;
+    // points into the mapped string table, valid as long as the index is
+    std::string_view name;
+};
+
+/**
+ * Address range index of the function symbols of an ELF file.
+ *
+ * Symbols from .symtab and .dynsym are merged, deduplicated by address and
+ * sorted. Start addresses are kept in a separate dense array, so the binary
+ * search only touches 8 bytes per probe, the rest of the symbol is read once
+ * at the end.
+ *
+ * Addresses are ELF virtual addresses (st_value), use file_address() to
+ * translate a runtime address of a mapping of the file first.
+ */
+class SymbolIndex
+{
+public:
+    SymbolIndex(std::shared_ptr<const ElfFile> file);
+
+    /**
+     * @returns the symbol containing address, or nullptr
+     */
+    const ElfSymbol* lookup(std::uint64_t address) const;
+
+    /**
+     * Resolves a whole column of addresses, result[i] belongs to
+     * addresses[i]. Large batches are sorted first and resolved by one merge
+     * pass over the symbol table instead of one binary search per address.
+     */
+    void lookup(const std::uint64_t* addresses, std::size_t count,
+                const ElfSymbol** result) const;
+
+    /**
+     * Translates a runtime address inside a mapping of this file, given by
+     * its start address and file offset (as in PERF_RECORD_MMAP2), into an
+     * ELF virtual address.
+     */
+    std::optional<std::uint64_t> file_address(std::uint64_t address, std::uint64_t map_start,
+                                              std::uint64_t map_pgoff) const;
+
+    const std::optional<std::string>& build_id() const
+    {
+        return build_id_;
+    }
+
+    std::size_t size() const
+    {
+        return symbols_.size();
+    }
+
+    const std::vector<ElfSymbol>& symbols() const
+    {
+        return symbols_;
+    }
+
+private:
+    struct LoadSegment
+    {
+        std::uint64_t offset;
+        std::uint64_t vaddr;
+        std::uint64_t filesz;
+    };
+
+    void read_symbols();
+
+    std::shared_ptr<const ElfFile> file_;
+    std::optional<std::string> build_id_;
+    std::vector<LoadSegment> segments_;
+
+    std::vector<std::uint64_t> starts_;
+    std::vector<ElfSymbol> symbols_;
+};
+
+/**
+ * Identifies the file behind a path, so caches by path notice when it is
+ * replaced, e.g. by a rebuild or a package upgrade.
+ */
+struct FileId
+{
+    std::uint64_t device;
+    std::uint64_t inode;
+    std::int64_t mtime;
+
+    /**
+     * @returns the id of the file at path, std::nullopt if it does not exist
+     */
+    static std::optional<FileId> of(const std::filesystem::path& path);
+
+    bool operator==(const FileId& other) const
+    {
+        return device == other.device && inode == other.inode && mtime == other.mtime;
+    }
+};
+
+/**
+ * Cache of SymbolIndex by build-id, so that every binary is parsed only once,
+ * no matter how many processes map it or under which path. Files without a
+ * build-id are cached by path. Thread-safe.
+ */
+class SymbolCache
+{
+public:
+    static SymbolCache& instance()
+    {
+        static SymbolCache cache;
+        return cache;
+    }
+
+    /**
+     * @returns the index of the file, nullptr if it can not be read
+     */
+    std::shared_ptr<const SymbolIndex> get(const std::filesystem::path& path);
+
+    void clear();
+
+private:
+    std::mutex mutex_;
+    std::map<std::filesystem::path, std::pair<FileId, std::shared_ptr<const SymbolIndex>>>
+        by_path_;
+    std::map<std::string, std::shared_ptr<const SymbolIndex>> by_build_id_;
+};
+
+} // namespace perf_cpp
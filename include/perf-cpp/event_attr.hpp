@@ -29,6 +29,7 @@
 #include <optional>
 #include <ostream>
 #include <set>
+#include <string>
 #include <type_traits>
 #include <variant>
 
@@ -56,6 +57,71 @@ enum class Availability
 
 class EventGuard;
 
+/**
+ * Describes why perf_event_open() failed without throwing.
+ *
+ * The reason is derived from errno, the requested perf_event_attr and
+ * perf_event_paranoid, so that callers can tell a paranoid setting apart from
+ * a PMU that is simply busy.
+ */
+class OpenError
+{
+public:
+    enum class Reason
+    {
+        NONE,
+        // perf_event_paranoid forbids the requested kind of measurement
+        PARANOID,
+        // perf_event_paranoid would allow it, but the process lacks the privileges
+        MISSING_CAPABILITY,
+        // counters are occupied, e.g. by a pinned or exclusive event
+        PMU_BUSY,
+        // the PMU does not support the requested feature (e.g. sampling)
+        NOT_SUPPORTED,
+        // the event or the cpu/thread does not exist
+        NO_SUCH_EVENT,
+        INVALID_ARGUMENT,
+        // RLIMIT_NOFILE exhausted
+        TOO_MANY_FILES,
+        OTHER
+    };
+
+    OpenError() = default;
+
+    OpenError(int errnum, const perf_event_attr& attr, std::variant<Cpu, Thread> location);
+
+    int errnum() const
+    {
+        return errnum_;
+    }
+
+    Reason reason() const
+    {
+        return reason_;
+    }
+
+    std::error_code code() const
+    {
+        return std::error_code(errnum_, std::system_category());
+    }
+
+    std::string message() const;
+
+    std::system_error as_system_error() const
+    {
+        return std::system_error(code(), message());
+    }
+
+    explicit operator bool() const
+    {
+        return reason_ != Reason::NONE;
+    }
+
+private:
+    int errnum_ = 0;
+    Reason reason_ = Reason::NONE;
+};
+
 /**
  * Base class for all Event types
  * contains common attributes
@@ -86,6 +152,20 @@ public:
      */
     EventGuard open_as_group_leader(std::variant<Cpu, Thread>, int cgroup_fd = -1);
 
+    /**
+     * like open(), but reports failures through error instead of throwing
+     */
+    std::optional<EventGuard> try_open(std::variant<Cpu, Thread> location, OpenError& error,
+                                       int cgroup_fd = -1) noexcept;
+
+    /**
+     * the error that made update_availability() consider this event unavailable
+     */
+    const OpenError& unavailability_reason() const
+    {
+        return unavailability_reason_;
+    }
+
     const Availability& availability() const
     {
         return availability_;
@@ -219,6 +299,33 @@ public:
         return attr_.mmap;
     }
 
+    // Extends the mmap events to PERF_RECORD_MMAP2, which additionally carry
+    // the protection flags and the inode (or build-id) of the mapped file.
+    void set_mmap2()
+    {
+        attr_.mmap = 1;
+        attr_.mmap2 = 1;
+    }
+
+    bool mmap2()
+    {
+        return attr_.mmap2;
+    }
+
+#ifdef PERF_RECORD_KSYMBOL_FLAGS_UNREGISTER
+    // Enables generation of ksymbol events. ksymbol events are generated when
+    // kernel symbols are (un)registered at runtime, e.g. for BPF programs.
+    void set_ksymbol()
+    {
+        attr_.ksymbol = 1;
+    }
+
+    bool ksymbol()
+    {
+        return attr_.ksymbol;
+    }
+#endif
+
     // Enables generation of context switch events. Context switch events
     // are generated when the kernels switches the process running on a CPU.
     void set_context_switch()
@@ -263,6 +370,38 @@ public:
         attr_.sample_type |= format;
     }
 
+    // Records the user space registers in mask (PERF_REG_* bits of
+    // <asm/perf_regs.h>) in every sample, as they were when the sample was taken
+    void set_sample_regs_user(uint64_t mask)
+    {
+        attr_.sample_type |= PERF_SAMPLE_REGS_USER;
+        attr_.sample_regs_user = mask;
+    }
+
+    uint64_t sample_regs_user()
+    {
+        return attr_.sample_regs_user;
+    }
+
+    // Copies up to bytes of the user stack, starting at the stack pointer,
+    // into every sample. Together with the registers, this allows unwinding
+    // the user stack after the fact.
+    void set_sample_stack_user(uint32_t bytes)
+    {
+        // the kernel wants a multiple of 8 that fits into the u16 record size
+        if (bytes % 8 != 0 || bytes > 65528)
+        {
+            throw std::runtime_error("sample_stack_user must be a multiple of 8 and <= 65528!");
+        }
+        attr_.sample_type |= PERF_SAMPLE_STACK_USER;
+        attr_.sample_stack_user = bytes;
+    }
+
+    uint32_t sample_stack_user()
+    {
+        return attr_.sample_stack_user;
+    }
+
     friend std::ostream& operator<<(std::ostream& stream, const EventAttr& event);
 
     void set_watermark(uint64_t bytes)
@@ -325,6 +464,7 @@ protected:
     std::string name_;
     std::set<Cpu> cpus_;
     Availability availability_ = Availability::UNAVAILABLE;
+    OpenError unavailability_reason_;
 };
 
 class PredefinedEventAttr : public EventAttr
@@ -382,11 +522,13 @@ public:
     EventGuard(EventGuard&& other)
     {
         std::swap(fd_, other.fd_);
+        std::swap(read_format_, other.read_format_);
     }
 
     EventGuard& operator=(EventGuard&& other)
     {
         std::swap(fd_, other.fd_);
+        std::swap(read_format_, other.read_format_);
         return *this;
     }
 
@@ -395,6 +537,17 @@ public:
      */
     EventGuard open_child(EventAttr& child, std::variant<Cpu, Thread> scope, int cgroup_fd = -1);
 
+    /**
+     * Non-throwing counterpart of the constructor. Expected failures like
+     * EACCES or ENOENT are reported through error.
+     */
+    static std::optional<EventGuard> try_open(EventAttr& ev, std::variant<Cpu, Thread> location,
+                                              int group_fd, int cgroup_fd,
+                                              OpenError& error) noexcept;
+
+    std::optional<EventGuard> try_open_child(EventAttr& child, std::variant<Cpu, Thread> scope,
+                                             OpenError& error, int cgroup_fd = -1) noexcept;
+
     void enable();
     void disable();
 
@@ -410,8 +563,15 @@ public:
     }
 
     void set_output(const EventGuard& other_ev);
+
+    // changes sample_period (or sample_freq for frequency-based events) of the opened event
+    void set_period(std::uint64_t period);
     void set_syscall_filter(const std::vector<int64_t>& filter);
 
+    // sets a filter in the kernel's filter language on a tracepoint event,
+    // see tracepoint::Filter for building one
+    void set_filter(const std::string& filter);
+
     int get_fd() const
     {
         return fd_;
@@ -422,6 +582,12 @@ public:
         return fd_ >= 0;
     };
 
+    // the read_format the event was opened with
+    std::uint64_t read_format() const
+    {
+        return read_format_;
+    }
+
     template <class T>
     T read()
     {
@@ -445,7 +611,12 @@ public:
     }
 
 protected:
+    EventGuard(int fd, std::uint64_t read_format) : fd_(fd), read_format_(read_format)
+    {
+    }
+
     int fd_ = -1;
+    std::uint64_t read_format_ = 0;
 };
 
 } // namespace perf_cpp
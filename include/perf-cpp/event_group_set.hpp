@@ -0,0 +1,121 @@
+/*
+ * This file is part of the perf_cpp library.
+ * Linux Perf C++ bindings
+ *
+ * Copyright (c) 2024,
+ *    Technische Universitaet Dresden, Germany
+ *
+ * perf_cpp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * perf_cpp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with perf_cpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <perf-cpp/event_attr.hpp>
+#include <perf-cpp/types.hpp>
+
+#include <set>
+#include <vector>
+
+namespace perf_cpp
+{
+
+/**
+ * One opened event group on a single cpu: the leader and its children
+ */
+struct CpuEventGroup
+{
+    CpuEventGroup(Cpu c, EventGuard&& l) : cpu(c), leader(std::move(l))
+    {
+    }
+
+    Cpu cpu;
+    EventGuard leader;
+    std::vector<EventGuard> members;
+};
+
+/**
+ * Opens the same event group on a set of cpus as one transaction.
+ *
+ * Either every group is opened or none is: if opening fails on any cpu, all
+ * already opened file descriptors are closed again and the error is rethrown.
+ *
+ * All leaders are opened disabled. enable() and disable() then toggle every
+ * group with a single PERF_IOC_FLAG_GROUP ioctl per cpu from a precomputed fd list,
+ * which keeps the start skew between cpus as small as possible.
+ */
+class EventGroupSet
+{
+public:
+    enum class Parallelism
+    {
+        SERIAL,
+        // open the groups of each package in a separate worker thread
+        PER_PACKAGE,
+        // open the groups of each NUMA node in a separate worker thread
+        PER_NUMA_NODE
+    };
+
+    static EventGroupSet open(const EventAttr& leader, const std::vector<EventAttr>& members,
+                              const std::set<Cpu>& cpus,
+                              Parallelism parallelism = Parallelism::SERIAL, int cgroup_fd = -1);
+
+    EventGroupSet(const EventGroupSet&) = delete;
+    EventGroupSet& operator=(const EventGroupSet&) = delete;
+
+    EventGroupSet(EventGroupSet&&) = default;
+    EventGroupSet& operator=(EventGroupSet&&) = default;
+
+    /**
+     * enables all groups. If one of the ioctls fails, the already enabled
+     * groups are disabled again before the error is thrown.
+     */
+    void enable();
+
+    /**
+     * disables all groups in the order they were enabled, so that every cpu
+     * has been counting for the same amount of time.
+     */
+    void disable();
+
+    bool enabled() const
+    {
+        return enabled_;
+    }
+
+    const std::vector<CpuEventGroup>& groups() const
+    {
+        return groups_;
+    }
+
+    std::vector<CpuEventGroup>& groups()
+    {
+        return groups_;
+    }
+
+    std::size_t size() const
+    {
+        return groups_.size();
+    }
+
+    ~EventGroupSet();
+
+private:
+    EventGroupSet(std::vector<CpuEventGroup>&& groups);
+
+    std::vector<CpuEventGroup> groups_;
+    std::vector<int> leader_fds_;
+    bool enabled_ = false;
+};
+
+} // namespace perf_cpp
@@ -40,6 +40,8 @@ public:
     std::vector<EventAttr> get_predefined_events();
     std::vector<SysfsEventAttr> get_pmu_events();
 
+    // all tracepoints as "<subsystem>:<event>", see tracepoint::TracepointCatalog
+    // to look up or match only some of them
     std::vector<std::string> get_tracepoint_event_names();
 
     static EventResolver& instance()
@@ -0,0 +1,142 @@
+/*
+ * This file is part of the perf_cpp library.
+ * Linux Perf C++ bindings
+ *
+ * Copyright (c) 2024,
+ *    Technische Universitaet Dresden, Germany
+ *
+ * perf_cpp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * perf_cpp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with perf_cpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <perf-cpp/event_attr.hpp>
+#include <perf-cpp/record.hpp>
+#include <perf-cpp/ring_buffer.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <set>
+#include <vector>
+
+namespace perf_cpp
+{
+
+/**
+ * The records of one cpu, copied out of a FlightRecorder, oldest first
+ */
+struct RecordSnapshot
+{
+    RecordSnapshot(Cpu c) : cpu(c)
+    {
+    }
+
+    template <typename F>
+    void for_each(F&& handler) const
+    {
+        std::size_t pos = 0;
+        while (pos + sizeof(perf_event_header) <= data.size())
+        {
+            auto* record = reinterpret_cast<const perf_event_header*>(data.data() + pos);
+            handler(record);
+            pos += record->size;
+        }
+    }
+
+    Cpu cpu;
+    std::vector<std::byte> data;
+};
+
+/**
+ * "Black box" recording: every cpu writes into an overwrite-mode ring buffer
+ * that nobody reads, so there is no consumer overhead in the steady state.
+ *
+ * On a trigger, output is paused with PERF_EVENT_IOC_PAUSE_OUTPUT and the
+ * records are walked backward from data_head to extract the most recent ones.
+ *
+ * The event is opened with write_backward, sample_id_all and PERF_SAMPLE_TIME
+ * so that every record has a timestamp to select the snapshot window.
+ */
+class FlightRecorder
+{
+public:
+    FlightRecorder(const EventAttr& ev, const std::set<Cpu>& cpus, std::size_t data_pages,
+                   int cgroup_fd = -1);
+
+    FlightRecorder(const FlightRecorder&) = delete;
+    FlightRecorder& operator=(const FlightRecorder&) = delete;
+
+    ~FlightRecorder();
+
+    void pause();
+    void resume();
+
+    /**
+     * Pauses the output, copies all records that are at most window older
+     * than the newest record across all cpus and resumes the output.
+     */
+    std::vector<RecordSnapshot>
+    snapshot(std::chrono::nanoseconds window = std::chrono::nanoseconds::max());
+
+    /**
+     * Installs a handler for signum that pauses the output immediately, so
+     * that nothing after the incident overwrites the interesting records.
+     * The snapshot itself has to be taken outside of the signal handler,
+     * check for it with triggered(). Only one recorder can be armed at a time.
+     * Arming another signal disarms the previous one.
+     */
+    void arm_signal(int signum);
+
+    /**
+     * restores the handler the armed signal had before arm_signal()
+     */
+    void disarm_signal();
+
+    /**
+     * true if the armed signal was received since the last snapshot()
+     */
+    bool triggered() const
+    {
+        return triggered_.load(std::memory_order_acquire);
+    }
+
+    const RecordLayout& layout() const
+    {
+        return layout_;
+    }
+
+private:
+    static void signal_handler(int signum);
+
+    struct CpuRecorder
+    {
+        Cpu cpu;
+        EventGuard guard;
+        RingBuffer buffer;
+    };
+
+    std::vector<CpuRecorder> recorders_;
+    // kept separately so the signal handler does not have to touch the guards
+    std::vector<int> fds_;
+    RecordLayout layout_;
+
+    std::atomic<bool> triggered_ = false;
+    int armed_signal_ = -1;
+    struct sigaction previous_action_ = {};
+
+    static std::atomic<FlightRecorder*> armed_;
+};
+
+} // namespace perf_cpp
@@ -0,0 +1,160 @@
+/*
+ * This file is part of the perf_cpp library.
+ * Linux Perf C++ bindings
+ *
+ * Copyright (c) 2024,
+ *    Technische Universitaet Dresden, Germany
+ *
+ * perf_cpp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * perf_cpp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with perf_cpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <limits>
+#include <map>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+extern "C"
+{
+#include <linux/perf_event.h>
+}
+
+namespace perf_cpp
+{
+
+/**
+ * A JIT-compiled function, valid in [from_time, to_time)
+ */
+struct JitSymbol
+{
+    static constexpr std::uint64_t forever = std::numeric_limits<std::uint64_t>::max();
+
+    std::uint64_t start;
+    std::uint64_t end;
+    std::string name;
+
+    std::uint64_t from_time = 0;
+    std::uint64_t to_time = forever;
+
+    bool contains(std::uint64_t address) const
+    {
+        return address >= start && address < end;
+    }
+
+    bool valid_at(std::uint64_t time) const
+    {
+        return time >= from_time && time < to_time;
+    }
+};
+
+/**
+ * Symbols of JIT-compiled code, as published by JVMs, V8 & co. in
+ *
+ * - /tmp/perf-<pid>.map: text lines "<start> <size> <name>"
+ * - jitdump files (jit-<pid>.dump): binary JIT_CODE_LOAD/JIT_CODE_MOVE records
+ *   with timestamps. The runtime mmap()s the file, so it shows up as an
+ *   MMAP/MMAP2 record of the process, which is how process() finds it.
+ *
+ * Both are append-only while the runtime is alive. Every source remembers
+ * how far it was parsed, refresh() only parses what was appended since, and
+ * an incomplete last line or record is left for the next refresh.
+ *
+ * Code caches reuse memory: a new symbol closes the symbols it overlaps.
+ * jitdump symbols carry the time of their record, so a sample is resolved
+ * against the code that was there at its timestamp. perf maps have no
+ * timestamps, their symbols are valid from the beginning of time.
+ *
+ * jitdump timestamps have to come from the same clock as the samples, most
+ * runtimes use CLOCK_MONOTONIC (see EventAttr::set_clockid()).
+ */
+class JitSymbols
+{
+public:
+    JitSymbols(std::filesystem::path map_dir = "/tmp") : map_dir_(std::move(map_dir))
+    {
+    }
+
+    /**
+     * Handles MMAP/MMAP2 records of jitdump files and PERF_RECORD_EXIT,
+     * anything else is ignored.
+     */
+    void process(const perf_event_header* record);
+
+    /**
+     * starts following the perf map of pid
+     */
+    void watch(std::uint32_t pid);
+
+    /**
+     * parses whatever was appended to the sources of pid (or of all processes)
+     */
+    void refresh(std::uint32_t pid);
+    void refresh();
+
+    /**
+     * @returns the symbol containing address at time (or now), nullptr if unknown
+     */
+    const JitSymbol* lookup(std::uint32_t pid, std::uint64_t address,
+                            std::optional<std::uint64_t> time = std::nullopt) const;
+
+    /**
+     * Like lookup(), but on a miss the process is watched and its sources are
+     * refreshed once, for code that was compiled after the last refresh.
+     * Every miss costs a stat() per source, so only use it for addresses that
+     * the AddressSpaceTracker found in an anonymous mapping (or in none).
+     */
+    const JitSymbol* resolve(std::uint32_t pid, std::uint64_t address,
+                             std::optional<std::uint64_t> time = std::nullopt);
+
+    /**
+     * drops the symbols that were replaced before time, and exited processes
+     */
+    void expire(std::uint64_t time);
+
+private:
+    struct Source
+    {
+        std::filesystem::path path;
+        bool jitdump;
+        // identity of the file, to notice when it is replaced
+        std::uint64_t inode = 0;
+        std::uint64_t offset = 0;
+    };
+
+    struct Process
+    {
+        std::vector<Source> sources;
+        std::map<std::uint64_t, JitSymbol> live;
+        std::vector<JitSymbol> history;
+        std::optional<std::uint64_t> exit_time;
+    };
+
+    void add_source(Process& process, std::filesystem::path path, bool jitdump);
+    void read_source(Process& process, Source& source);
+    void parse_perf_map(Process& process, const std::string& data, std::uint64_t& consumed);
+    void parse_jitdump(Process& process, const std::string& data, std::uint64_t& consumed,
+                       bool header);
+    void add_symbol(Process& process, JitSymbol symbol);
+
+    std::filesystem::path map_dir_;
+
+    std::unordered_map<std::uint32_t, Process> processes_;
+};
+
+} // namespace perf_cpp
@@ -0,0 +1,132 @@
+/*
+ * This file is part of the perf_cpp library.
+ * Linux Perf C++ bindings
+ *
+ * Copyright (c) 2024,
+ *    Technische Universitaet Dresden, Germany
+ *
+ * perf_cpp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * perf_cpp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with perf_cpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+extern "C"
+{
+#include <linux/perf_event.h>
+}
+
+namespace perf_cpp
+{
+
+/**
+ * A symbol found by KernelSymbols::lookup(). name and module point into the
+ * index, copy them to keep them beyond its next process() or
+ * refresh_modules().
+ */
+struct KernelSymbol
+{
+    std::uint64_t start;
+    std::uint64_t end;
+    std::string_view name;
+    // empty for symbols of the kernel image
+    std::string_view module;
+};
+
+/**
+ * Index of the kernel text symbols from /proc/kallsyms.
+ *
+ * The file is read in one go and parsed by hand into a sorted array of
+ * 16-byte entries, with all names interned into a single string buffer.
+ * Symbols registered at runtime (BPF programs, ftrace trampolines) are
+ * tracked separately from PERF_RECORD_KSYMBOL, see EventAttr::set_ksymbol().
+ *
+ * If kernel addresses are hidden (kptr_restrict, missing CAP_SYSLOG), all
+ * addresses read as zero and the index stays empty.
+ *
+ * With data set, data and bss symbols are indexed as well, e.g. to name the
+ * addresses of statically allocated locks.
+ *
+ * Not thread-safe, lookups must not run concurrently with process() or
+ * refresh_modules().
+ */
+class KernelSymbols
+{
+public:
+    KernelSymbols(const std::filesystem::path& kallsyms = "/proc/kallsyms", bool data = false);
+
+    /**
+     * @returns the symbol containing address. Its name and module are views
+     * into the index, valid until the next process() or a refresh_modules()
+     * that reloads it.
+     */
+    std::optional<KernelSymbol> lookup(std::uint64_t address) const;
+
+    /**
+     * handles PERF_RECORD_KSYMBOL, anything else is ignored
+     */
+    void process(const perf_event_header* record);
+
+    /**
+     * Reloads the index if the set of loaded modules changed since the last
+     * load. Module loading does not produce a perf record, so call this
+     * periodically or after a lookup failed for an address in module space.
+     * @returns true if the index was reloaded
+     */
+    bool refresh_modules();
+
+    std::size_t size() const
+    {
+        return starts_.size() + dynamic_.size();
+    }
+
+private:
+    struct Entry
+    {
+        std::uint64_t end;
+        std::uint32_t name_offset;
+        std::uint16_t name_size;
+        // index into modules_ + 1, 0 for the kernel image
+        std::uint16_t module;
+    };
+
+    struct DynamicSymbol
+    {
+        std::uint64_t end;
+        std::string name;
+    };
+
+    void load();
+
+    std::filesystem::path path_;
+    bool data_;
+    std::string modules_state_;
+
+    // names_ is the interning buffer, names are referenced by offset
+    std::string names_;
+    std::vector<std::string> modules_;
+    std::vector<std::uint64_t> starts_;
+    std::vector<Entry> entries_;
+
+    std::map<std::uint64_t, DynamicSymbol> dynamic_;
+};
+
+} // namespace perf_cpp
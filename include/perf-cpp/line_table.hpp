@@ -0,0 +1,147 @@
+/*
+ * This file is part of the perf_cpp library.
+ * Linux Perf C++ bindings
+ *
+ * Copyright (c) 2024,
+ *    Technische Universitaet Dresden, Germany
+ *
+ * perf_cpp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * perf_cpp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with perf_cpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <perf-cpp/elf_symbols.hpp>
+
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace perf_cpp
+{
+
+struct SourceLocation
+{
+    // valid as long as the LineTable
+    std::string_view file;
+    std::uint32_t line;
+};
+
+/**
+ * Address to source line index, decoded from the .debug_line section
+ * (DWARF versions 2 to 5).
+ *
+ * The line programs of all compilation units are run once and their rows
+ * flattened into three parallel arrays (address, file, line) sorted by
+ * address, with file names interned. The end of every sequence is kept as a
+ * row without a file, so addresses between sequences resolve to nothing.
+ *
+ * Addresses are ELF virtual addresses, see SymbolIndex::file_address().
+ */
+class LineTable
+{
+public:
+    LineTable() = default;
+
+    /**
+     * Decodes .debug_line of file. Compressed debug sections are not
+     * supported and yield an empty table.
+     */
+    static LineTable from_elf(const ElfFile& file);
+
+    std::optional<SourceLocation> lookup(std::uint64_t address) const;
+
+    /**
+     * resolves a column of addresses, large batches are sorted and resolved
+     * in one pass like in SymbolIndex::lookup()
+     */
+    void lookup(const std::uint64_t* addresses, std::size_t count,
+                std::optional<SourceLocation>* result) const;
+
+    /**
+     * Stores the decoded table in a compact binary format, so that it does
+     * not have to be decoded again.
+     */
+    void save(const std::filesystem::path& path) const;
+
+    /**
+     * @returns the table stored with save(), nullopt if it is missing or invalid
+     */
+    static std::optional<LineTable> load(const std::filesystem::path& path);
+
+    std::size_t size() const
+    {
+        return addresses_.size();
+    }
+
+    bool empty() const
+    {
+        return addresses_.empty();
+    }
+
+private:
+    // marks the end of a sequence
+    static constexpr std::uint32_t no_file = ~0u;
+
+    std::optional<SourceLocation> at(std::size_t row) const;
+
+    std::vector<std::string> files_;
+    std::vector<std::uint64_t> addresses_;
+    std::vector<std::uint32_t> file_indices_;
+    std::vector<std::uint32_t> lines_;
+};
+
+/**
+ * Cache of LineTables by build-id, in memory and on disk.
+ *
+ * Tables are stored in cache_dir as <build-id>.lines, so every binary is only
+ * decoded once, also across runs. If a binary has no .debug_line, the
+ * separate debug file from /usr/lib/debug/.build-id is used. Thread-safe.
+ */
+class LineTableCache
+{
+public:
+    /**
+     * the default cache dir is $XDG_CACHE_HOME/perf-cpp/lines, or
+     * ~/.cache/perf-cpp/lines
+     */
+    static LineTableCache& instance();
+
+    LineTableCache(std::filesystem::path cache_dir) : cache_dir_(std::move(cache_dir))
+    {
+    }
+
+    /**
+     * @returns the line table of the binary at path, nullptr if it can not be read
+     */
+    std::shared_ptr<const LineTable> get(const std::filesystem::path& path);
+
+private:
+    std::shared_ptr<const LineTable> decode(const ElfFile& file,
+                                            const std::optional<std::string>& build_id);
+
+    std::filesystem::path cache_dir_;
+
+    std::mutex mutex_;
+    std::map<std::string, std::shared_ptr<const LineTable>> by_build_id_;
+    std::map<std::filesystem::path, std::pair<FileId, std::shared_ptr<const LineTable>>>
+        by_path_;
+};
+
+} // namespace perf_cpp
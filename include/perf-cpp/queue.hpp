@@ -0,0 +1,293 @@
+/*
+ * This file is part of the perf_cpp library.
+ * Linux Perf C++ bindings
+ *
+ * Copyright (c) 2024,
+ *    Technische Universitaet Dresden, Germany
+ *
+ * perf_cpp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * perf_cpp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with perf_cpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+
+namespace perf_cpp
+{
+
+constexpr std::size_t cache_line_size = 64;
+
+/**
+ * Counters of a bounded queue. pushed and popped are taken from the queue
+ * positions, so they cost nothing on the fast path. rejected counts the
+ * pushes that failed because the queue was full, i.e. the backpressure the
+ * producers saw.
+ */
+struct QueueStats
+{
+    std::uint64_t capacity = 0;
+    std::uint64_t pushed = 0;
+    std::uint64_t popped = 0;
+    std::uint64_t rejected = 0;
+
+    std::uint64_t depth() const
+    {
+        return pushed - popped;
+    }
+};
+
+namespace detail
+{
+inline std::size_t queue_capacity(std::size_t capacity)
+{
+    if (capacity < 2)
+    {
+        throw std::invalid_argument("queue capacity must be at least 2");
+    }
+
+    std::size_t res = 1;
+    while (res < capacity)
+    {
+        res *= 2;
+    }
+    return res;
+}
+} // namespace detail
+
+/**
+ * Bounded wait-free queue for exactly one producer and one consumer thread.
+ *
+ * Each side keeps a cached copy of the other side's position and only reloads
+ * it when the cached value says full (or empty), so in the steady state the
+ * shared cache lines are only touched once per wrap-around.
+ */
+template <typename T>
+class SpscQueue
+{
+public:
+    // capacity is rounded up to the next power of two
+    explicit SpscQueue(std::size_t capacity)
+    : capacity_(detail::queue_capacity(capacity)), mask_(capacity_ - 1),
+      slots_(std::make_unique<T[]>(capacity_))
+    {
+    }
+
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    // producer side
+    bool try_push(T&& value)
+    {
+        const auto tail = tail_.load(std::memory_order_relaxed);
+        if (tail - cached_head_ == capacity_)
+        {
+            cached_head_ = head_.load(std::memory_order_acquire);
+            if (tail - cached_head_ == capacity_)
+            {
+                rejected_.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+        }
+
+        slots_[tail & mask_] = std::move(value);
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // consumer side
+    bool try_pop(T& value)
+    {
+        const auto head = head_.load(std::memory_order_relaxed);
+        if (head == cached_tail_)
+        {
+            cached_tail_ = tail_.load(std::memory_order_acquire);
+            if (head == cached_tail_)
+            {
+                return false;
+            }
+        }
+
+        value = std::move(slots_[head & mask_]);
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool empty() const
+    {
+        return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire);
+    }
+
+    std::size_t capacity() const
+    {
+        return capacity_;
+    }
+
+    QueueStats stats() const
+    {
+        QueueStats stats;
+        stats.capacity = capacity_;
+        stats.popped = head_.load(std::memory_order_relaxed);
+        stats.pushed = tail_.load(std::memory_order_relaxed);
+        stats.rejected = rejected_.load(std::memory_order_relaxed);
+        return stats;
+    }
+
+private:
+    const std::size_t capacity_;
+    const std::size_t mask_;
+    std::unique_ptr<T[]> slots_;
+
+    // written by the consumer
+    alignas(cache_line_size) std::atomic<std::size_t> head_ = 0;
+    std::size_t cached_tail_ = 0;
+
+    // written by the producer
+    alignas(cache_line_size) std::atomic<std::size_t> tail_ = 0;
+    std::size_t cached_head_ = 0;
+    std::atomic<std::uint64_t> rejected_ = 0;
+};
+
+/**
+ * Bounded lock-free queue for any number of producers and consumers
+ * (Vyukov's array queue). With a single consumer it is the MPSC case that
+ * the reader threads need; a pool of consumers works just the same.
+ *
+ * Every slot carries a sequence number, so producers and consumers only
+ * contend on their own position counter and never on each other's.
+ */
+template <typename T>
+class MpmcQueue
+{
+public:
+    // capacity is rounded up to the next power of two
+    explicit MpmcQueue(std::size_t capacity)
+    : capacity_(detail::queue_capacity(capacity)), mask_(capacity_ - 1),
+      cells_(std::make_unique<Cell[]>(capacity_))
+    {
+        for (std::size_t i = 0; i < capacity_; i++)
+        {
+            cells_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    MpmcQueue(const MpmcQueue&) = delete;
+    MpmcQueue& operator=(const MpmcQueue&) = delete;
+
+    bool try_push(T&& value)
+    {
+        Cell* cell;
+        auto pos = enqueue_pos_.load(std::memory_order_relaxed);
+        while (true)
+        {
+            cell = &cells_[pos & mask_];
+            const auto seq = cell->sequence.load(std::memory_order_acquire);
+            const auto diff = static_cast<std::intptr_t>(seq) - static_cast<std::intptr_t>(pos);
+            if (diff == 0)
+            {
+                if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    break;
+                }
+            }
+            else if (diff < 0)
+            {
+                rejected_.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            else
+            {
+                pos = enqueue_pos_.load(std::memory_order_relaxed);
+            }
+        }
+
+        cell->value = std::move(value);
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool try_pop(T& value)
+    {
+        Cell* cell;
+        auto pos = dequeue_pos_.load(std::memory_order_relaxed);
+        while (true)
+        {
+            cell = &cells_[pos & mask_];
+            const auto seq = cell->sequence.load(std::memory_order_acquire);
+            const auto diff =
+                static_cast<std::intptr_t>(seq) - static_cast<std::intptr_t>(pos + 1);
+            if (diff == 0)
+            {
+                if (dequeue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    break;
+                }
+            }
+            else if (diff < 0)
+            {
+                return false;
+            }
+            else
+            {
+                pos = dequeue_pos_.load(std::memory_order_relaxed);
+            }
+        }
+
+        value = std::move(cell->value);
+        cell->sequence.store(pos + capacity_, std::memory_order_release);
+        return true;
+    }
+
+    bool empty() const
+    {
+        return dequeue_pos_.load(std::memory_order_seq_cst) ==
+               enqueue_pos_.load(std::memory_order_seq_cst);
+    }
+
+    std::size_t capacity() const
+    {
+        return capacity_;
+    }
+
+    QueueStats stats() const
+    {
+        QueueStats stats;
+        stats.capacity = capacity_;
+        stats.popped = dequeue_pos_.load(std::memory_order_relaxed);
+        stats.pushed = enqueue_pos_.load(std::memory_order_relaxed);
+        stats.rejected = rejected_.load(std::memory_order_relaxed);
+        return stats;
+    }
+
+private:
+    struct alignas(cache_line_size) Cell
+    {
+        std::atomic<std::size_t> sequence;
+        T value;
+    };
+
+    const std::size_t capacity_;
+    const std::size_t mask_;
+    std::unique_ptr<Cell[]> cells_;
+
+    alignas(cache_line_size) std::atomic<std::size_t> enqueue_pos_ = 0;
+    alignas(cache_line_size) std::atomic<std::size_t> dequeue_pos_ = 0;
+    alignas(cache_line_size) std::atomic<std::uint64_t> rejected_ = 0;
+};
+
+} // namespace perf_cpp
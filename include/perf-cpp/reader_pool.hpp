@@ -0,0 +1,182 @@
+/*
+ * This file is part of the perf_cpp library.
+ * Linux Perf C++ bindings
+ *
+ * Copyright (c) 2024,
+ *    Technische Universitaet Dresden, Germany
+ *
+ * perf_cpp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * perf_cpp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with perf_cpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <perf-cpp/arena.hpp>
+#include <perf-cpp/record.hpp>
+#include <perf-cpp/ring_buffer.hpp>
+#include <perf-cpp/types.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <utility>
+#include <vector>
+
+extern "C"
+{
+#include <poll.h>
+}
+
+namespace perf_cpp
+{
+
+/**
+ * Per-thread state of a ReaderPool reader, passed to the record handler
+ */
+struct ReaderContext
+{
+    ReaderContext(NumaNode n, Package p) : node(n), package(p)
+    {
+    }
+
+    NumaNode node;
+    Package package;
+    // Records copied for other threads, see RecordPipeline. It is first
+    // touched by the reader after pinning, so its pages end up on its node.
+    RecordBatch batch;
+    // Reader-local memory for decoded samples, see copy_sample()
+    Arena arena;
+};
+
+/**
+ * Drains per-cpu ring buffers with reader threads partitioned by NUMA node
+ * and package. Every reader is pinned to the cpus of its partition, so the
+ * buffers it reads (which the kernel allocates on the node of their cpu)
+ * never cross the interconnect.
+ */
+class ReaderPool
+{
+public:
+    ReaderPool(std::size_t threads_per_partition = 1,
+               std::chrono::milliseconds poll_timeout = std::chrono::milliseconds(100));
+
+    ReaderPool(const ReaderPool&) = delete;
+    ReaderPool& operator=(const ReaderPool&) = delete;
+
+    ~ReaderPool();
+
+    /**
+     * registers the buffer of cpu, the buffer has to outlive the pool. Only
+     * allowed before start().
+     */
+    void add(Cpu cpu, RingBuffer& buffer);
+
+    /**
+     * Starts the readers. handler(ReaderContext&, Cpu, const perf_event_header*)
+     * is called from the reader threads for every record; a single handler
+     * invocation never runs concurrently with another one of the same reader.
+     * A stopped pool can be started again, a running one throws.
+     */
+    template <typename Handler>
+    void start(Handler handler)
+    {
+        start(handler, [](ReaderContext&) {});
+    }
+
+    /**
+     * Same as above, additionally flush(ReaderContext&) is called after every
+     * round of draining all buffers of a reader, e.g. to submit its batch.
+     */
+    template <typename Handler, typename Flush>
+    void start(Handler handler, Flush flush)
+    {
+        prepare();
+        for (auto& reader : readers_)
+        {
+            threads_.emplace_back(
+                [this, &reader, handler, flush]() mutable
+                {
+                    pin(reader);
+                    ReaderContext context(reader.node, reader.package);
+                    context.batch.data.reserve(batch_reserve);
+                    run(reader, context, handler, flush);
+                });
+        }
+    }
+
+    /**
+     * stops all readers after a final drain of every buffer
+     */
+    void stop();
+
+    std::size_t threads() const
+    {
+        return readers_.size();
+    }
+
+private:
+    static constexpr std::size_t batch_reserve = 64 * 1024;
+
+    struct Reader
+    {
+        NumaNode node;
+        Package package;
+        std::vector<std::pair<Cpu, RingBuffer*>> buffers;
+    };
+
+    void prepare();
+    void partition();
+    void pin(const Reader& reader);
+
+    template <typename Handler, typename Flush>
+    void run(Reader& reader, ReaderContext& context, Handler& handler, Flush& flush)
+    {
+        std::vector<pollfd> fds;
+        for (const auto& buffer : reader.buffers)
+        {
+            fds.push_back(pollfd{ buffer.second->fd(), POLLIN, 0 });
+        }
+        fds.push_back(pollfd{ stop_fd_, POLLIN, 0 });
+
+        auto drain = [&]()
+        {
+            for (auto& buffer : reader.buffers)
+            {
+                const Cpu cpu = buffer.first;
+                buffer.second->consume([&](const perf_event_header* record)
+                                       { handler(context, cpu, record); });
+            }
+            flush(context);
+        };
+
+        while (!stopped_.load(std::memory_order_relaxed))
+        {
+            // a timeout also drains buffers that stay below their watermark
+            poll(fds.data(), fds.size(), poll_timeout_.count());
+            drain();
+        }
+        drain();
+    }
+
+    std::size_t threads_per_partition_;
+    std::chrono::milliseconds poll_timeout_;
+
+    std::vector<std::pair<Cpu, RingBuffer*>> buffers_;
+    std::vector<Reader> readers_;
+    std::vector<std::thread> threads_;
+
+    std::atomic<bool> stopped_ = false;
+    int stop_fd_ = -1;
+};
+
+} // namespace perf_cpp
@@ -0,0 +1,189 @@
+/*
+ * This file is part of the perf_cpp library.
+ * Linux Perf C++ bindings
+ *
+ * Copyright (c) 2024,
+ *    Technische Universitaet Dresden, Germany
+ *
+ * perf_cpp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * perf_cpp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with perf_cpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <perf-cpp/arena.hpp>
+#include <perf-cpp/types.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+extern "C"
+{
+#include <linux/perf_event.h>
+}
+
+namespace perf_cpp
+{
+
+/**
+ * The layout of a PERF_RECORD_SAMPLE depends on sample_type and read_format
+ * of the event that produced it. This describes it once, so records can be
+ * decoded without consulting the EventAttr again.
+ */
+struct RecordLayout
+{
+    RecordLayout() = default;
+
+    RecordLayout(const perf_event_attr& attr)
+    : sample_type(attr.sample_type), read_format(attr.read_format),
+      sample_id_all(attr.sample_id_all), branch_sample_type(attr.branch_sample_type),
+      sample_regs_user(attr.sample_regs_user)
+    {
+    }
+
+    std::uint64_t sample_type = 0;
+    std::uint64_t read_format = 0;
+    bool sample_id_all = false;
+    std::uint64_t branch_sample_type = 0;
+    std::uint64_t sample_regs_user = 0;
+};
+
+/**
+ * Non-owning view of a decoded PERF_RECORD_SAMPLE. Fields that are not part
+ * of the sample_type are left at their defaults. Pointers point into the
+ * record, which must outlive the view.
+ */
+struct SampleView
+{
+    std::uint64_t identifier = 0;
+    std::uint64_t ip = 0;
+    std::uint32_t pid = 0;
+    std::uint32_t tid = 0;
+    std::uint64_t time = 0;
+    std::uint64_t addr = 0;
+    std::uint64_t id = 0;
+    std::uint64_t stream_id = 0;
+    std::uint32_t cpu = 0;
+    std::uint64_t period = 0;
+
+    const std::uint64_t* callchain = nullptr;
+    std::uint64_t callchain_size = 0;
+
+    const std::byte* raw = nullptr;
+    std::uint32_t raw_size = 0;
+
+    // PERF_SAMPLE_REGS_USER: the registers of RecordLayout::sample_regs_user,
+    // in the order of their bits. Empty if the sample hit a kernel thread.
+    std::uint64_t regs_user_abi = PERF_SAMPLE_REGS_ABI_NONE;
+    std::uint64_t regs_user_mask = 0;
+    const std::uint64_t* regs_user = nullptr;
+
+    // PERF_SAMPLE_STACK_USER: the copy of the user stack, starting at the
+    // stack pointer. Only the part the kernel actually copied is included.
+    const std::byte* stack_user = nullptr;
+    std::uint64_t stack_user_size = 0;
+};
+
+/**
+ * Decodes a PERF_RECORD_SAMPLE
+ * @returns false if the record is truncated or not a sample
+ */
+bool decode_sample(const perf_event_header* header, const RecordLayout& layout,
+                   SampleView& sample);
+
+/**
+ * @returns user register reg (a PERF_REG_* index) of sample, if it was recorded
+ */
+std::optional<std::uint64_t> user_register(const SampleView& sample, unsigned reg);
+
+/**
+ * Copies the callchain, raw data, registers and stack of sample into arena,
+ * so that the returned view outlives the record it was decoded from
+ */
+SampleView copy_sample(const SampleView& sample, Arena& arena);
+
+/**
+ * Returns the timestamp of any record, if it carries one. Samples carry it if
+ * PERF_SAMPLE_TIME is set, all other records only with sample_id_all.
+ */
+std::optional<std::uint64_t> record_time(const perf_event_header* header,
+                                         const RecordLayout& layout);
+
+/**
+ * Records of any number of cpus, copied back-to-back into one buffer, so
+ * that they can be handed from a reader thread to another thread. Every
+ * record is preceded by the cpu it was read on as a uint64_t, which keeps
+ * the records 8-byte aligned.
+ */
+struct RecordBatch
+{
+    void append(Cpu cpu, const perf_event_header* record)
+    {
+        const std::uint64_t tag = cpu.as_int();
+        auto* tag_bytes = reinterpret_cast<const std::byte*>(&tag);
+        auto* record_bytes = reinterpret_cast<const std::byte*>(record);
+        data.insert(data.end(), tag_bytes, tag_bytes + sizeof(tag));
+        data.insert(data.end(), record_bytes, record_bytes + record->size);
+        records++;
+    }
+
+    template <typename F>
+    void for_each(F&& handler) const
+    {
+        std::size_t pos = 0;
+        while (pos + sizeof(std::uint64_t) + sizeof(perf_event_header) <= data.size())
+        {
+            auto tag = *reinterpret_cast<const std::uint64_t*>(data.data() + pos);
+            auto* record =
+                reinterpret_cast<const perf_event_header*>(data.data() + pos + sizeof(tag));
+            handler(Cpu(static_cast<int>(tag)), record);
+            pos += sizeof(tag) + record->size;
+        }
+    }
+
+    bool empty() const
+    {
+        return records == 0;
+    }
+
+    void clear()
+    {
+        data.clear();
+        records = 0;
+    }
+
+    std::vector<std::byte> data;
+    std::size_t records = 0;
+};
+
+/**
+ * Decodes the samples of records with layout and calls
+ * handler(Cpu, const SampleView&) for each, other records are skipped
+ */
+template <typename F>
+void for_each_sample(const RecordBatch& records, const RecordLayout& layout, F&& handler)
+{
+    records.for_each(
+        [&](Cpu cpu, const perf_event_header* record)
+        {
+            SampleView sample;
+            if (decode_sample(record, layout, sample))
+            {
+                handler(cpu, static_cast<const SampleView&>(sample));
+            }
+        });
+}
+
+} // namespace perf_cpp
@@ -0,0 +1,151 @@
+/*
+ * This file is part of the perf_cpp library.
+ * Linux Perf C++ bindings
+ *
+ * Copyright (c) 2024,
+ *    Technische Universitaet Dresden, Germany
+ *
+ * perf_cpp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * perf_cpp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with perf_cpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <perf-cpp/queue.hpp>
+#include <perf-cpp/record.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace perf_cpp
+{
+
+/**
+ * Hands RecordBatches from ring buffer readers to a pool of consumer threads.
+ *
+ * Decoding, symbolization and export are slow compared to draining a ring
+ * buffer. Running them on the reader would leave the kernel buffers full and
+ * lose records, so readers only copy records into a batch and submit it here.
+ *
+ * The queue is bounded. If it is full, the reader does not block by default:
+ * the batch is dropped and counted instead, the same thing the kernel would
+ * do if the reader stalled, only without losing the ring buffer contents of
+ * the next drain. Processed batches are recycled to the readers, so the
+ * steady state does not allocate.
+ *
+ * With a ReaderPool:
+ *   pool.start([&](ReaderContext& c, Cpu cpu, const perf_event_header* r)
+ *              { pipeline.append(c.batch, cpu, r); },
+ *              [&](ReaderContext& c) { pipeline.submit(c.batch); });
+ */
+class RecordPipeline
+{
+public:
+    enum class Overflow
+    {
+        // drop the batch and count its records in dropped_records()
+        DROP,
+        // spin until a consumer makes room
+        WAIT
+    };
+
+    RecordPipeline(std::size_t capacity = 1024, std::size_t batch_bytes = 256 * 1024,
+                   Overflow overflow = Overflow::DROP);
+
+    RecordPipeline(const RecordPipeline&) = delete;
+    RecordPipeline& operator=(const RecordPipeline&) = delete;
+
+    ~RecordPipeline();
+
+    /**
+     * Starts the consumers, consumer(const RecordBatch&) is called for every
+     * submitted batch on one of the consumer threads.
+     */
+    template <typename Consumer>
+    void start(std::size_t consumers, Consumer consumer)
+    {
+        for (std::size_t i = 0; i < consumers; i++)
+        {
+            threads_.emplace_back(
+                [this, consumer]() mutable
+                {
+                    RecordBatch batch;
+                    while (next(batch))
+                    {
+                        consumer(static_cast<const RecordBatch&>(batch));
+                        recycle(batch);
+                    }
+                });
+        }
+    }
+
+    /**
+     * copies record into batch and submits the batch once it is full
+     */
+    void append(RecordBatch& batch, Cpu cpu, const perf_event_header* record)
+    {
+        batch.append(cpu, record);
+        if (batch.data.size() >= batch_bytes_)
+        {
+            submit(batch);
+        }
+    }
+
+    /**
+     * Hands batch over to the consumers, it is replaced by an empty
+     * (recycled) batch. Empty batches are ignored.
+     */
+    void submit(RecordBatch& batch);
+
+    /**
+     * Stops the consumers after they processed everything that was submitted.
+     * Stop the producers first.
+     */
+    void stop();
+
+    QueueStats stats() const
+    {
+        return queue_.stats();
+    }
+
+    std::uint64_t dropped_records() const
+    {
+        return dropped_records_.load(std::memory_order_relaxed);
+    }
+
+private:
+    bool next(RecordBatch& batch);
+    void recycle(RecordBatch& batch);
+
+    std::size_t batch_bytes_;
+    Overflow overflow_;
+
+    MpmcQueue<RecordBatch> queue_;
+    MpmcQueue<RecordBatch> free_;
+
+    // consumers only sleep if the queue stays empty, producers only take the
+    // lock if someone is sleeping
+    std::mutex mutex_;
+    std::condition_variable not_empty_;
+    std::atomic<int> sleeping_ = 0;
+    std::atomic<bool> stopped_ = false;
+
+    alignas(cache_line_size) std::atomic<std::uint64_t> dropped_records_ = 0;
+
+    std::vector<std::thread> threads_;
+};
+
+} // namespace perf_cpp
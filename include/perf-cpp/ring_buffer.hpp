@@ -0,0 +1,258 @@
+/*
+ * This file is part of the perf_cpp library.
+ * Linux Perf C++ bindings
+ *
+ * Copyright (c) 2024,
+ *    Technische Universitaet Dresden, Germany
+ *
+ * perf_cpp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * perf_cpp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with perf_cpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <perf-cpp/event_attr.hpp>
+#include <perf-cpp/ring_telemetry.hpp>
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+extern "C"
+{
+#include <linux/perf_event.h>
+}
+
+namespace perf_cpp
+{
+
+/**
+ * The mmap()ed ring buffer of an EventGuard.
+ *
+ * In CONSUME mode the buffer is mapped writable and the reader advances
+ * data_tail, so the kernel never overwrites unread records. In OVERWRITE mode
+ * the buffer is mapped read-only and the kernel keeps overwriting the oldest
+ * records; combine it with perf_event_attr::write_backward to be able to find
+ * the newest record at data_head.
+ */
+class RingBuffer
+{
+public:
+    enum class Mode
+    {
+        CONSUME,
+        OVERWRITE
+    };
+
+    /**
+     * @param data_pages number of data pages, must be a power of two
+     */
+    RingBuffer(const EventGuard& ev, std::size_t data_pages, Mode mode = Mode::CONSUME);
+
+    RingBuffer(const RingBuffer&) = delete;
+    RingBuffer& operator=(const RingBuffer&) = delete;
+
+    RingBuffer(RingBuffer&& other);
+    RingBuffer& operator=(RingBuffer&& other);
+
+    ~RingBuffer();
+
+    Mode mode() const
+    {
+        return mode_;
+    }
+
+    int fd() const
+    {
+        return fd_;
+    }
+
+    perf_event_mmap_page* header() const
+    {
+        return header_;
+    }
+
+    const std::byte* data() const
+    {
+        return data_;
+    }
+
+    // size of the data area in bytes
+    std::size_t size() const
+    {
+        return size_;
+    }
+
+    std::size_t data_pages() const
+    {
+        return data_pages_;
+    }
+
+    /**
+     * false only after a failed resize() could not restore the old mapping
+     * either. An unmapped buffer reads as empty, resize() maps it again.
+     */
+    bool mapped() const
+    {
+        return header_ != nullptr;
+    }
+
+    // loss and overflow counters, updated by consume()
+    const RingTelemetry& telemetry() const
+    {
+        return *telemetry_;
+    }
+
+    RingTelemetry& telemetry()
+    {
+        return *telemetry_;
+    }
+
+    /**
+     * Reads the PERF_FORMAT_LOST counter of the event into telemetry(), if its
+     * read_format has it. consume() does so after every drain.
+     */
+    void update_format_lost();
+
+    std::uint64_t head() const
+    {
+        return header_ != nullptr ? __atomic_load_n(&header_->data_head, __ATOMIC_ACQUIRE) : 0;
+    }
+
+    std::uint64_t tail() const
+    {
+        return header_ != nullptr ? header_->data_tail : 0;
+    }
+
+    bool empty() const
+    {
+        return head() == tail();
+    }
+
+    // bytes written by the kernel but not consumed yet
+    std::size_t fill() const
+    {
+        return head() - tail();
+    }
+
+    /**
+     * copies len bytes at ring position pos to dest, taking care of the wrap-around
+     */
+    void copy_out(std::uint64_t pos, std::size_t len, std::byte* dest) const
+    {
+        const auto offset = pos & (size_ - 1);
+        const auto first = std::min(len, size_ - offset);
+        std::memcpy(dest, data_ + offset, first);
+        std::memcpy(dest + first, data_, len - first);
+    }
+
+    /**
+     * Replaces the mapping by one with data_pages pages. The kernel drops
+     * unread records when the old mapping goes away, so everything is drained
+     * into handler first; records arriving in between are lost, and in
+     * OVERWRITE mode the whole content is. If the new size can not be
+     * mapped, the old size is restored and the error thrown; if that fails
+     * too, the buffer is left unmapped (see mapped()).
+     *
+     * Must not run concurrently with any other reader of the buffer, e.g. a
+     * ReaderPool drain of it.
+     */
+    template <typename F>
+    void resize(std::size_t data_pages, F&& handler)
+    {
+        if (mode_ == Mode::CONSUME)
+        {
+            consume(std::forward<F>(handler));
+        }
+        remap(data_pages);
+    }
+
+    /**
+     * Calls handler(const perf_event_header*) for every record between tail
+     * and head, then hands the space back to the kernel. Records that wrap
+     * around the end of the buffer are passed as a contiguous copy.
+     * Only valid in CONSUME mode.
+     * @returns the number of bytes consumed
+     */
+    template <typename F>
+    std::size_t consume(F&& handler)
+    {
+        if (header_ == nullptr)
+        {
+            return 0;
+        }
+        const auto head_pos = head();
+        auto pos = tail();
+        const auto start = pos;
+
+        telemetry_->begin_drain(head_pos - pos);
+
+        while (pos < head_pos)
+        {
+            const auto offset = pos & (size_ - 1);
+            auto* record = reinterpret_cast<const perf_event_header*>(data_ + offset);
+
+            if (offset + sizeof(perf_event_header) > size_ || offset + record->size > size_)
+            {
+                perf_event_header wrapped;
+                copy_out(pos, sizeof(wrapped), reinterpret_cast<std::byte*>(&wrapped));
+                if (scratch_.size() < wrapped.size)
+                {
+                    scratch_.resize(wrapped.size);
+                }
+                copy_out(pos, wrapped.size, scratch_.data());
+                record = reinterpret_cast<const perf_event_header*>(scratch_.data());
+            }
+
+            if (record->size == 0)
+            {
+                break;
+            }
+            pos += record->size;
+            telemetry_->observe(record);
+            handler(record);
+        }
+
+        __atomic_store_n(&header_->data_tail, pos, __ATOMIC_RELEASE);
+        telemetry_->end_drain();
+        if (format_lost_)
+        {
+            update_format_lost();
+        }
+        return pos - start;
+    }
+
+private:
+    void map(std::size_t data_pages);
+    void remap(std::size_t data_pages);
+    void unmap();
+
+    int fd_ = -1;
+    Mode mode_ = Mode::CONSUME;
+    perf_event_mmap_page* header_ = nullptr;
+    std::byte* data_ = nullptr;
+    std::size_t size_ = 0;
+    std::size_t data_pages_ = 0;
+    std::size_t mapping_size_ = 0;
+    std::uint64_t read_format_ = 0;
+    // read_format has PERF_FORMAT_LOST, so every drain reads the event
+    bool format_lost_ = false;
+    std::vector<std::byte> scratch_;
+    std::unique_ptr<RingTelemetry> telemetry_;
+};
+
+} // namespace perf_cpp
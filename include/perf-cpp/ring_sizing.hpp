@@ -0,0 +1,138 @@
+/*
+ * This file is part of the perf_cpp library.
+ * Linux Perf C++ bindings
+ *
+ * Copyright (c) 2024,
+ *    Technische Universitaet Dresden, Germany
+ *
+ * perf_cpp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * perf_cpp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with perf_cpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <perf-cpp/event_attr.hpp>
+#include <perf-cpp/ring_buffer.hpp>
+
+#include <chrono>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+
+#include <cstddef>
+#include <cstdint>
+
+namespace perf_cpp
+{
+
+/**
+ * Picks ring buffer sizes from the expected data rate and the mlock budget
+ * reported by Capabilities, and grows or shrinks buffers at runtime based on
+ * their RingTelemetry.
+ *
+ * Sizes are chosen such that all buffers together always fit into the budget,
+ * so the mmap() of the last cpu does not fail with EPERM.
+ */
+class RingSizingPolicy
+{
+public:
+    /**
+     * @param events_per_second expected records per second and cpu
+     * @param record_size average record size in bytes
+     * @param drain_interval how often the buffers are drained
+     * @param buffers number of buffers that are going to be mapped (usually one per cpu)
+     */
+    RingSizingPolicy(double events_per_second, std::size_t record_size,
+                     std::chrono::milliseconds drain_interval, std::size_t buffers);
+
+    // data pages every buffer should be created with
+    std::size_t initial_pages() const
+    {
+        return initial_pages_;
+    }
+
+    // wakeup watermark in bytes, half of the initial buffer
+    std::uint32_t watermark() const;
+
+    // largest size a single buffer may grow to
+    std::size_t max_pages() const
+    {
+        return max_pages_;
+    }
+
+    /**
+     * sets the wakeup watermark of ev. This has to happen before opening, the
+     * kernel clamps it to the buffer size if the buffer shrinks later on.
+     */
+    void configure(EventAttr& ev) const
+    {
+        ev.set_watermark(watermark());
+    }
+
+    /**
+     * Decides on a new size for buffer from its telemetry since the last
+     * review: doubles it on lost records or if it ran more than 3/4 full,
+     * halves it (down to a quarter of initial_pages()) after several reviews
+     * below 1/8 fill. A buffer left unmapped by a failed resize gets
+     * initial_pages() again once the budget allows.
+     * @returns the new number of data pages, if it should change
+     */
+    std::optional<std::size_t> review(RingBuffer& buffer);
+
+    /**
+     * review()s the buffer and applies the new size, draining it into handler
+     * first. Safe to call concurrently for different buffers.
+     * @returns true if the buffer was resized
+     */
+    template <typename F>
+    bool adapt(RingBuffer& buffer, F&& handler)
+    {
+        auto pages = review(buffer);
+        if (!pages)
+        {
+            return false;
+        }
+
+        try
+        {
+            buffer.resize(*pages, std::forward<F>(handler));
+        }
+        catch (const std::system_error&)
+        {
+            release(buffer, *pages);
+            return false;
+        }
+        return true;
+    }
+
+private:
+    struct BufferState
+    {
+        std::uint64_t lost = 0;
+        unsigned idle_reviews = 0;
+    };
+
+    // gives back budget that was reserved for a resize that failed
+    void release(const RingBuffer& buffer, std::size_t failed_pages);
+
+    std::size_t budget_;
+    std::size_t initial_pages_;
+    std::size_t max_pages_;
+
+    std::mutex mutex_;
+    // pages currently mapped, including the header page of every buffer
+    std::size_t pages_in_use_;
+    std::unordered_map<const RingBuffer*, BufferState> states_;
+};
+
+} // namespace perf_cpp
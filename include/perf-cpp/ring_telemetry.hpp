@@ -0,0 +1,167 @@
+/*
+ * This file is part of the perf_cpp library.
+ * Linux Perf C++ bindings
+ *
+ * Copyright (c) 2024,
+ *    Technische Universitaet Dresden, Germany
+ *
+ * perf_cpp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * perf_cpp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with perf_cpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <perf-cpp/build_config.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <optional>
+
+#include <cstdint>
+
+extern "C"
+{
+#include <linux/perf_event.h>
+}
+
+namespace perf_cpp
+{
+
+/**
+ * Plain copy of the RingTelemetry counters at one point in time
+ */
+struct RingTelemetrySnapshot
+{
+    std::uint64_t records;
+    std::uint64_t bytes;
+    // number of PERF_RECORD_LOST records and the sum of the records they report
+    std::uint64_t lost_events;
+    std::uint64_t lost_records;
+    // PERF_RECORD_LOST_SAMPLES: samples dropped before they reached the buffer
+    std::uint64_t lost_samples;
+    std::uint64_t throttles;
+    std::uint64_t unthrottles;
+    // PERF_FORMAT_LOST, Linux 6.0+
+    std::uint64_t format_lost;
+    std::uint64_t drains;
+    // largest number of unread bytes seen at the start of a drain
+    std::uint64_t high_water;
+    std::chrono::nanoseconds last_drain_latency;
+    std::chrono::nanoseconds max_drain_latency;
+};
+
+/**
+ * Loss and overflow counters of a single ring buffer.
+ *
+ * The counters are written only by the thread draining the buffer and can be
+ * polled lock-free from any other thread. Each instance sits on its own cache
+ * lines, so polling does not slow down the drain of other cpus.
+ */
+class alignas(64) RingTelemetry
+{
+public:
+    void observe(const perf_event_header* record)
+    {
+        bump(records_);
+        bump(bytes_, record->size);
+
+        auto* payload = reinterpret_cast<const std::uint64_t*>(record + 1);
+        switch (record->type)
+        {
+        case PERF_RECORD_LOST:
+            // struct { u64 id; u64 lost; }
+            bump(lost_events_);
+            bump(lost_records_, payload[1]);
+            break;
+#ifdef HAVE_PERF_RECORD_LOST_SAMPLES
+        case PERF_RECORD_LOST_SAMPLES:
+            bump(lost_samples_, payload[0]);
+            break;
+#endif
+        case PERF_RECORD_THROTTLE:
+            bump(throttles_);
+            break;
+        case PERF_RECORD_UNTHROTTLE:
+            bump(unthrottles_);
+            break;
+        default:
+            break;
+        }
+    }
+
+    void begin_drain(std::uint64_t fill)
+    {
+        if (fill > high_water_.load(std::memory_order_relaxed))
+        {
+            high_water_.store(fill, std::memory_order_relaxed);
+        }
+        drain_start_ = std::chrono::steady_clock::now();
+    }
+
+    void end_drain()
+    {
+        const std::uint64_t latency = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                          std::chrono::steady_clock::now() - drain_start_)
+                                          .count();
+        bump(drains_);
+        last_drain_latency_.store(latency, std::memory_order_relaxed);
+        if (latency > max_drain_latency_.load(std::memory_order_relaxed))
+        {
+            max_drain_latency_.store(latency, std::memory_order_relaxed);
+        }
+    }
+
+    // start a new high-water period, e.g. after the buffer was resized
+    void reset_high_water()
+    {
+        high_water_.store(0, std::memory_order_relaxed);
+    }
+
+    void set_format_lost(std::uint64_t lost)
+    {
+        format_lost_.store(lost, std::memory_order_relaxed);
+    }
+
+    RingTelemetrySnapshot snapshot() const;
+
+private:
+    // single writer, so a plain load and store is enough and avoids the locked add
+    static void bump(std::atomic<std::uint64_t>& counter, std::uint64_t value = 1)
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    }
+
+    std::atomic<std::uint64_t> records_ = 0;
+    std::atomic<std::uint64_t> bytes_ = 0;
+    std::atomic<std::uint64_t> lost_events_ = 0;
+    std::atomic<std::uint64_t> lost_records_ = 0;
+    std::atomic<std::uint64_t> lost_samples_ = 0;
+    std::atomic<std::uint64_t> throttles_ = 0;
+    std::atomic<std::uint64_t> unthrottles_ = 0;
+    std::atomic<std::uint64_t> format_lost_ = 0;
+    std::atomic<std::uint64_t> drains_ = 0;
+    std::atomic<std::uint64_t> high_water_ = 0;
+    std::atomic<std::uint64_t> last_drain_latency_ = 0;
+    std::atomic<std::uint64_t> max_drain_latency_ = 0;
+
+    std::chrono::steady_clock::time_point drain_start_;
+};
+
+/**
+ * Reads the PERF_FORMAT_LOST value of an event opened with a read_format
+ * containing it. For a PERF_FORMAT_GROUP leader, it is the sum over the group.
+ * @returns std::nullopt if the kernel or the read_format does not provide it
+ */
+std::optional<std::uint64_t> read_format_lost(int fd, std::uint64_t read_format);
+
+} // namespace perf_cpp
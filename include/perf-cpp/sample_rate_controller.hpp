@@ -0,0 +1,123 @@
+/*
+ * This file is part of the perf_cpp library.
+ * Linux Perf C++ bindings
+ *
+ * Copyright (c) 2024,
+ *    Technische Universitaet Dresden, Germany
+ *
+ * perf_cpp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * perf_cpp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with perf_cpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <perf-cpp/event_attr.hpp>
+#include <perf-cpp/ring_buffer.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <vector>
+
+#include <cstdint>
+
+namespace perf_cpp
+{
+
+struct SampleRateBudget
+{
+    // consumer cpu time as a fraction of the capacity of the monitored cpus
+    double max_overhead = 0.01;
+    std::uint64_t min_period = 1000;
+    std::uint64_t max_period = 1ull << 40;
+    // buffer fill ratio at which the period of a cpu is increased
+    double max_fill = 0.75;
+};
+
+/**
+ * Adjusts the sample period of per-cpu sampling events at runtime via
+ * PERF_EVENT_IOC_PERIOD, so that the consumer stays within a cpu budget
+ * while sampling as densely as possible.
+ *
+ * Losses and throttling are taken from the RingTelemetry of the buffers,
+ * which their consume() keeps up to date. Drain threads report the cpu time
+ * they spent with account_consumer(), and update() is called periodically.
+ *
+ * Meant for events opened with sample_period(); for sample_freq() events the
+ * kernel interprets the value as frequency, so don't use it with those.
+ */
+class SampleRateController
+{
+public:
+    SampleRateController(std::uint64_t initial_period, SampleRateBudget budget = {});
+
+    /**
+     * registers the event and buffer of one cpu, both have to outlive the controller
+     * @returns the index to pass to period()
+     */
+    std::size_t add(EventGuard& guard, const RingBuffer& buffer);
+
+    void account_consumer(std::chrono::nanoseconds cpu_time)
+    {
+        consumer_ns_.fetch_add(cpu_time.count(), std::memory_order_relaxed);
+    }
+
+    /**
+     * Evaluates the counters since the last call and applies new periods.
+     * Call this periodically, e.g. once a second, from a single thread.
+     */
+    void update();
+
+    std::uint64_t period(std::size_t index) const
+    {
+        return cpus_[index]->period;
+    }
+
+    // measured overhead during the last update() interval
+    double overhead() const
+    {
+        return last_overhead_;
+    }
+
+    // cpu time of the calling thread, for use with account_consumer()
+    static std::chrono::nanoseconds thread_cpu_time();
+
+private:
+    struct CpuState
+    {
+        EventGuard* guard;
+        const RingBuffer* buffer;
+        std::uint64_t period;
+        // telemetry counters at the last update()
+        std::uint64_t lost = 0;
+        std::uint64_t throttles = 0;
+    };
+
+    // records the kernel dropped for the buffer, by any of the ways it reports them
+    static std::uint64_t lost_records(const RingTelemetrySnapshot& telemetry)
+    {
+        return telemetry.lost_records + telemetry.lost_samples + telemetry.format_lost;
+    }
+
+    std::uint64_t clamp(double period) const;
+
+    SampleRateBudget budget_;
+    std::uint64_t initial_period_;
+    std::vector<std::unique_ptr<CpuState>> cpus_;
+
+    std::atomic<std::uint64_t> consumer_ns_ = 0;
+    std::chrono::steady_clock::time_point last_update_;
+    double last_overhead_ = 0;
+};
+
+} // namespace perf_cpp
@@ -116,6 +116,29 @@ public:
     template <typename T>
     Package package_of(T t) const;
 
+    const std::set<NumaNode>& numa_nodes() const
+    {
+        return numa_nodes_;
+    }
+
+    NumaNode numa_node_of(Cpu cpu) const
+    {
+        return cpu_to_numa_node_.at(cpu);
+    }
+
+    std::set<Cpu> cpus_of(NumaNode node) const
+    {
+        std::set<Cpu> cpus;
+        for (const auto& elem : cpu_to_numa_node_)
+        {
+            if (elem.second == node)
+            {
+                cpus.emplace(elem.first);
+            }
+        }
+        return cpus;
+    }
+
     Cpu measuring_cpu_for_core(Core core) const
     {
         auto core_it = std::find_if(cpu_to_core_.begin(), cpu_to_core_.end(),
@@ -158,6 +181,8 @@ private:
     std::map<Cpu, Core> cpu_to_core_;
     std::map<Core, Package> core_to_package_;
     std::map<Cpu, Package> cpu_to_package_;
+    std::set<NumaNode> numa_nodes_;
+    std::map<Cpu, NumaNode> cpu_to_numa_node_;
 
     bool hypervised_ = false;
 };
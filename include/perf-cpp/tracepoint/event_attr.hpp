@@ -21,6 +21,12 @@
 #pragma once
 
 #include <perf-cpp/event_attr.hpp>
+#include <perf-cpp/tracepoint/format.hpp>
+
+#include <filesystem>
+#include <istream>
+#include <string>
+#include <vector>
 
 namespace perf_cpp
 {
@@ -44,10 +50,23 @@ public:
         ParseError(const std::string& what, int error_code);
     };
 
+    /**
+     * name is "<system>:<event>" (or "<system>/<event>"), e.g.
+     * "syscalls:sys_enter_openat"
+     */
     TracepointEventAttr(const std::string& name);
 
+    /**
+     * (re-)reads the format file of the tracepoint from tracefs, see Tracefs
+     */
     void parse_format();
 
+    /**
+     * parses the contents of a format file, e.g. one that was saved along
+     * with a recording
+     */
+    void parse_format(std::istream& format);
+
     const auto& fields() const
     {
         return fields_;
@@ -65,15 +84,12 @@ public:
         throw std::out_of_range("field not found");
     }
 
-    int id()
+    int id() const
     {
         return id_;
     }
 
 private:
-    void parse_format_line(const std::string& line);
-
-    const static std::filesystem::path base_path_;
     int id_;
     std::vector<tracepoint::EventField> fields_;
 };
@@ -0,0 +1,174 @@
+/*
+ * This file is part of the perf_cpp library.
+ * Linux Perf C++ bindings
+ *
+ * Copyright (c) 2024,
+ *    Technische Universitaet Dresden, Germany
+ *
+ * perf_cpp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * perf_cpp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with perf_cpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <perf-cpp/record.hpp>
+#include <perf-cpp/tracepoint/event_attr.hpp>
+#include <perf-cpp/tracepoint/format.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace perf_cpp
+{
+
+namespace tracepoint
+{
+
+/**
+ * Tracepoint fields of many records in columns. Integer fields are stored as
+ * uint64_t (sign-extended for signed fields, cast to int64_t to get the
+ * value back), all other fields as string_views into the records, so the
+ * records must outlive the batch. Row i of every column belongs to the same
+ * record.
+ */
+struct ColumnBatch
+{
+    std::size_t rows() const
+    {
+        return time.size();
+    }
+
+    void clear()
+    {
+        time.clear();
+        cpu.clear();
+        pid.clear();
+        tid.clear();
+        for (auto& column : integers)
+        {
+            column.clear();
+        }
+        for (auto& column : views)
+        {
+            column.clear();
+        }
+    }
+
+    // from the sample, if it has PERF_SAMPLE_TIME, _CPU or _TID, 0 otherwise
+    std::vector<std::uint64_t> time;
+    std::vector<std::uint32_t> cpu;
+    std::vector<std::uint32_t> pid;
+    std::vector<std::uint32_t> tid;
+
+    std::vector<std::vector<std::uint64_t>> integers;
+    std::vector<std::vector<std::string_view>> views;
+};
+
+/**
+ * Extracts a fixed set of tracepoint fields from raw sample data.
+ *
+ * The fields are looked up and classified once, when the plan is built,
+ * into a flat list of (offset, width, sign) operations for integer fields
+ * and (offset, size, kind) operations for strings and arrays. Extracting a
+ * record then needs no field lookup, no switch on the field size and no
+ * allocation, one bounds check covers all fixed-size fields.
+ *
+ * Plans built from a TracepointEventAttr only take records of that
+ * tracepoint (by common_type), so one RecordBatch with samples of several
+ * tracepoints can be run through one plan per tracepoint.
+ */
+class ExtractionPlan
+{
+public:
+    /**
+     * @throws std::out_of_range if one of the names is not a field of the tracepoint
+     */
+    ExtractionPlan(const TracepointEventAttr& event, const std::vector<std::string>& names);
+
+    /**
+     * a plan over the given format, without filtering by tracepoint id
+     */
+    ExtractionPlan(const std::vector<EventField>& format, const std::vector<std::string>& names);
+
+    /**
+     * @returns the column of field name in ColumnBatch::integers
+     * @throws std::out_of_range if it was not selected or is not an integer field
+     */
+    std::size_t integer_column(std::string_view name) const;
+
+    /**
+     * @returns the column of field name in ColumnBatch::views
+     * @throws std::out_of_range if it was not selected or is an integer field
+     */
+    std::size_t view_column(std::string_view name) const;
+
+    /**
+     * Appends the fields of one record's raw data as a row to batch (the
+     * time, cpu, pid and tid columns are left to the caller). The columns of
+     * batch are resized to those of this plan if they differ.
+     * @returns false, without appending anything, if raw is too short or
+     * belongs to another tracepoint
+     */
+    bool extract(const std::byte* raw, std::size_t raw_size, ColumnBatch& batch) const;
+
+    /**
+     * Appends a row for every sample of this tracepoint in records, decoded
+     * with layout, which must include PERF_SAMPLE_RAW.
+     * @returns the number of rows appended
+     */
+    std::size_t extract(const RecordBatch& records, const RecordLayout& layout,
+                        ColumnBatch& batch) const;
+
+    /**
+     * @returns a batch with the columns of this plan, but no rows
+     */
+    ColumnBatch make_batch() const;
+
+private:
+    struct IntegerOp
+    {
+        std::uint32_t offset;
+        std::uint8_t width;
+        // 64 - 8 * width: shifting left and back right by this extends the value
+        std::uint8_t shift;
+        bool is_signed;
+    };
+
+    struct ViewOp
+    {
+        std::uint32_t offset;
+        std::uint32_t size;
+        bool dynamic;
+        bool relative;
+        // cut at the first NUL
+        bool string;
+    };
+
+    void compile(const std::vector<EventField>& format, const std::vector<std::string>& names);
+
+    std::vector<IntegerOp> integer_ops_;
+    std::vector<ViewOp> view_ops_;
+    std::vector<std::string> integer_names_;
+    std::vector<std::string> view_names_;
+
+    // the raw data must be at least this long for the fixed part of the ops
+    std::size_t min_size_ = 0;
+    std::optional<std::uint16_t> common_type_;
+};
+
+} // namespace tracepoint
+} // namespace perf_cpp
@@ -0,0 +1,318 @@
+/*
+ * This file is part of the perf_cpp library.
+ * Linux Perf C++ bindings
+ *
+ * Copyright (c) 2024,
+ *    Technische Universitaet Dresden, Germany
+ *
+ * perf_cpp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * perf_cpp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with perf_cpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <perf-cpp/event_attr.hpp>
+#include <perf-cpp/tracepoint/event_attr.hpp>
+#include <perf-cpp/tracepoint/format.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+namespace perf_cpp
+{
+
+namespace tracepoint
+{
+
+class BoundFilter;
+
+/**
+ * A filter expression over the fields of a tracepoint, built with field():
+ *
+ *   auto filter = (field("prev_pid") == 42 || field("prev_comm").glob("java*")) &&
+ *                 !field("prev_state").in({ 0, 256 });
+ *
+ * The expression is only checked against a format when it is bound, so it
+ * can be built before the tracepoint is known.
+ */
+class Filter
+{
+public:
+    class InvalidFilter : public std::runtime_error
+    {
+    public:
+        InvalidFilter(const std::string& what) : std::runtime_error("invalid filter: " + what)
+        {
+        }
+    };
+
+    enum class Op
+    {
+        EQ,
+        NE,
+        LT,
+        LE,
+        GT,
+        GE,
+        // field & value != 0
+        MASK,
+        // string glob, as the kernel's ~ operator
+        GLOB,
+    };
+
+    // an integer constant of either signedness
+    struct Constant
+    {
+        std::uint64_t bits;
+        bool negative;
+    };
+
+    struct Node;
+
+    /**
+     * checks the expression against format
+     * @throws InvalidFilter if it uses unknown fields or mismatching types
+     */
+    BoundFilter bind(const std::vector<EventField>& format) const;
+    BoundFilter bind(const TracepointEventAttr& event) const;
+
+    friend Filter operator&&(const Filter& lhs, const Filter& rhs);
+    friend Filter operator||(const Filter& lhs, const Filter& rhs);
+    friend Filter operator!(const Filter& filter);
+
+private:
+    friend class FieldRef;
+
+    Filter(std::shared_ptr<const Node> node) : node_(std::move(node))
+    {
+    }
+
+    std::shared_ptr<const Node> node_;
+};
+
+/**
+ * A field of a tracepoint in a filter expression, see field()
+ */
+class FieldRef
+{
+public:
+    explicit FieldRef(std::string name) : name_(std::move(name))
+    {
+    }
+
+    template <typename T, typename = std::enable_if_t<std::is_integral_v<T>>>
+    Filter operator==(T value) const
+    {
+        return compare(Filter::Op::EQ, constant(value));
+    }
+
+    template <typename T, typename = std::enable_if_t<std::is_integral_v<T>>>
+    Filter operator!=(T value) const
+    {
+        return compare(Filter::Op::NE, constant(value));
+    }
+
+    template <typename T, typename = std::enable_if_t<std::is_integral_v<T>>>
+    Filter operator<(T value) const
+    {
+        return compare(Filter::Op::LT, constant(value));
+    }
+
+    template <typename T, typename = std::enable_if_t<std::is_integral_v<T>>>
+    Filter operator<=(T value) const
+    {
+        return compare(Filter::Op::LE, constant(value));
+    }
+
+    template <typename T, typename = std::enable_if_t<std::is_integral_v<T>>>
+    Filter operator>(T value) const
+    {
+        return compare(Filter::Op::GT, constant(value));
+    }
+
+    template <typename T, typename = std::enable_if_t<std::is_integral_v<T>>>
+    Filter operator>=(T value) const
+    {
+        return compare(Filter::Op::GE, constant(value));
+    }
+
+    // string fields
+    Filter operator==(std::string_view value) const;
+    Filter operator!=(std::string_view value) const;
+
+    /**
+     * matches string fields against a pattern with *, ? and [...]
+     */
+    Filter glob(std::string_view pattern) const;
+
+    /**
+     * lo <= field <= hi
+     */
+    template <typename T, typename = std::enable_if_t<std::is_integral_v<T>>>
+    Filter between(T lo, T hi) const
+    {
+        return *this >= lo && *this <= hi;
+    }
+
+    /**
+     * field is one of values
+     */
+    template <typename T, typename = std::enable_if_t<std::is_integral_v<T>>>
+    Filter in(const std::vector<T>& values) const
+    {
+        std::vector<Filter::Constant> constants;
+        for (auto value : values)
+        {
+            constants.push_back(constant(value));
+        }
+        return in(constants);
+    }
+
+    template <typename T, typename = std::enable_if_t<std::is_integral_v<T>>>
+    Filter in(std::initializer_list<T> values) const
+    {
+        return in(std::vector<T>(values));
+    }
+
+    /**
+     * any of bits is set in the field
+     */
+    template <typename T, typename = std::enable_if_t<std::is_integral_v<T>>>
+    Filter mask(T bits) const
+    {
+        return compare(Filter::Op::MASK, constant(bits));
+    }
+
+private:
+    template <typename T>
+    static Filter::Constant constant(T value)
+    {
+        if constexpr (std::is_signed_v<T>)
+        {
+            return Filter::Constant{ static_cast<std::uint64_t>(static_cast<std::int64_t>(value)),
+                                     value < 0 };
+        }
+        else
+        {
+            return Filter::Constant{ static_cast<std::uint64_t>(value), false };
+        }
+    }
+
+    Filter compare(Filter::Op op, Filter::Constant value) const;
+    Filter compare(Filter::Op op, std::string_view value) const;
+    Filter in(const std::vector<Filter::Constant>& values) const;
+
+    std::string name_;
+};
+
+inline FieldRef field(std::string name)
+{
+    return FieldRef(std::move(name));
+}
+
+/**
+ * A Filter checked against the format of a tracepoint. It compiles to the
+ * kernel's filter language (see Documentation/trace/events.rst), and can
+ * evaluate the same expression on raw sample data in userspace.
+ *
+ * Kernel-side filtering drops records before they reach the ring buffer.
+ * Older kernels reject some expressions (e.g. globs other than prefix or
+ * suffix matches); apply() then falls back to filtering in userspace, so
+ * consumers should always check accepts().
+ */
+class BoundFilter
+{
+public:
+    /**
+     * the expression in the kernel's filter language
+     */
+    const std::string& expression() const
+    {
+        return expression_;
+    }
+
+    /**
+     * Sets the filter on an opened tracepoint event, call it for the guard
+     * of every cpu. Once the kernel rejected it for one guard, accepts()
+     * filters the records of all of them in userspace.
+     * @returns true if the kernel filters the records of guard, false if it
+     * rejected the filter (EINVAL)
+     * @throws std::system_error on any other error
+     */
+    bool apply(EventGuard& guard);
+
+    /**
+     * evaluates the expression on the raw data of a sample, a default
+     * constructed BoundFilter matches everything
+     */
+    bool matches(const std::byte* raw, std::size_t raw_size) const;
+
+    /**
+     * true if the record passes the filter, without evaluating it again if
+     * the kernel already did
+     */
+    bool accepts(const std::byte* raw, std::size_t raw_size) const
+    {
+        return kernel_side() || matches(raw, raw_size);
+    }
+
+    /**
+     * true if the kernel accepted the filter on every guard it was applied to
+     */
+    bool kernel_side() const
+    {
+        return applied_ && !rejected_;
+    }
+
+private:
+    friend class Filter;
+
+    // the expression tree, flattened in post-order, so that the root is last
+    struct Instruction
+    {
+        enum class Type
+        {
+            AND,
+            OR,
+            NOT,
+            INTEGER,
+            STRING,
+        };
+
+        Type type;
+        // children of AND, OR and NOT, as indices into program_
+        std::size_t lhs = 0;
+        std::size_t rhs = 0;
+
+        Filter::Op op = Filter::Op::EQ;
+        EventField field;
+        Filter::Constant value{};
+        std::string text;
+    };
+
+    bool evaluate(std::size_t index, const std::byte* raw, std::size_t raw_size) const;
+
+    std::vector<Instruction> program_;
+    std::string expression_;
+    bool applied_ = false;
+    bool rejected_ = false;
+};
+
+} // namespace tracepoint
+} // namespace perf_cpp
@@ -21,10 +21,19 @@
 
 #pragma once
 
+#include <perf-cpp/record.hpp>
+
+#include <istream>
+#include <optional>
 #include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
 #include <vector>
 
 #include <cstddef>
+#include <cstdint>
+#include <cstring>
 
 #include <filesystem>
 
@@ -33,23 +42,61 @@ namespace perf_cpp
 
 namespace tracepoint
 {
+/**
+ * Describes one field of a tracepoint, as declared in its format file:
+ *
+ *   field:<type> <name>[<length>];	offset:<n>;	size:<n>;	signed:<0|1>;
+ *
+ * Fields are parsed once into these descriptors, so that decoding a sample
+ * does not have to look at the type name again.
+ */
 class EventField
 {
 public:
+    enum class Kind
+    {
+        // integers of 1, 2, 4 or 8 bytes, including enums and bool
+        INTEGER,
+        POINTER,
+        // char[N], NUL-terminated unless it fills the array
+        STRING,
+        // any other T[N]
+        ARRAY,
+        // __data_loc char[]: offset and length of a string in the record
+        DYNAMIC_STRING,
+        // __data_loc T[]
+        DYNAMIC_ARRAY,
+        // anything else, e.g. an embedded struct
+        OTHER
+    };
+
     EventField()
     {
     }
 
     EventField(const std::string& name, std::ptrdiff_t offset, std::size_t size)
-    : name_(name), offset_(offset), size_(size)
+    : name_(name), offset_(offset), size_(size), element_size_(size)
     {
+        kind_ = (size == 1 || size == 2 || size == 4 || size == 8) ? Kind::INTEGER : Kind::OTHER;
     }
 
+    /**
+     * parses the part of a format line after "field:"
+     * @throws std::invalid_argument if the line is malformed
+     */
+    static EventField parse(const std::string& line);
+
     const std::string& name() const
     {
         return name_;
     }
 
+    // the declared type without the field name and array length
+    const std::string& type() const
+    {
+        return type_;
+    }
+
     std::ptrdiff_t offset() const
     {
         return offset_;
@@ -60,30 +107,211 @@ public:
         return size_;
     }
 
+    Kind kind() const
+    {
+        return kind_;
+    }
+
+    // of the field, or of the elements of an array
+    bool is_signed() const
+    {
+        return signed_;
+    }
+
+    // size of one array element, size() for scalar fields
+    std::size_t element_size() const
+    {
+        return element_size_;
+    }
+
+    // number of elements of a fixed array, 0 if it is not one
+    std::size_t array_length() const
+    {
+        return array_length_;
+    }
+
+    // common_type, common_pid, ...: the header every tracepoint record starts with
+    bool is_common() const
+    {
+        return name_.compare(0, 7, "common_") == 0;
+    }
+
+    bool is_dynamic() const
+    {
+        return kind_ == Kind::DYNAMIC_STRING || kind_ == Kind::DYNAMIC_ARRAY;
+    }
+
+    // __rel_loc: the dynamic data is located relative to the end of the field
+    bool is_relative() const
+    {
+        return relative_;
+    }
+
     bool is_integer() const
     {
-        // Parsing the type name is hard... really you don't want to do that
-        switch (size())
+        return kind_ == Kind::INTEGER || kind_ == Kind::POINTER;
+    }
+
+    bool is_string() const
+    {
+        return kind_ == Kind::STRING || kind_ == Kind::DYNAMIC_STRING;
+    }
+
+    bool valid() const
+    {
+        return size_ > 0;
+    }
+
+    /**
+     * @returns the bytes of this field in the raw data of a sample, following
+     * __data_loc/__rel_loc to the dynamic data. nullopt if the record is too
+     * short for it.
+     */
+    std::optional<std::string_view> data(const std::byte* raw, std::size_t raw_size) const
+    {
+        if (offset_ < 0 || static_cast<std::size_t>(offset_) + size_ > raw_size)
+        {
+            return std::nullopt;
+        }
+        const auto* field = reinterpret_cast<const char*>(raw) + offset_;
+        if (!is_dynamic())
+        {
+            return std::string_view(field, size_);
+        }
+
+        // u32: offset in the low, length in the high 16 bits
+        std::uint32_t loc;
+        std::memcpy(&loc, field, sizeof(loc));
+        std::size_t begin = loc & 0xffff;
+        const std::size_t length = loc >> 16;
+        if (relative_)
+        {
+            // __rel_loc offsets start after the field itself
+            begin += offset_ + size_;
+        }
+        if (begin + length > raw_size)
+        {
+            return std::nullopt;
+        }
+        return std::string_view(reinterpret_cast<const char*>(raw) + begin, length);
+    }
+
+    /**
+     * @returns the value of an integer field, sign-extended if the field is
+     * signed and zero-extended otherwise
+     */
+    std::optional<std::uint64_t> integer(const std::byte* raw, std::size_t raw_size) const
+    {
+        auto bytes = data(raw, raw_size);
+        if (!bytes || !is_integer())
+        {
+            return std::nullopt;
+        }
+        switch (size_)
         {
         case 1:
+            return signed_ ? extend<std::int8_t>(bytes->data())
+                           : extend<std::uint8_t>(bytes->data());
         case 2:
+            return signed_ ? extend<std::int16_t>(bytes->data())
+                           : extend<std::uint16_t>(bytes->data());
         case 4:
+            return signed_ ? extend<std::int32_t>(bytes->data())
+                           : extend<std::uint32_t>(bytes->data());
         case 8:
-            return true;
+            return extend<std::uint64_t>(bytes->data());
         default:
-            return false;
+            return std::nullopt;
         }
     }
 
-    bool valid() const
+    /**
+     * @returns the text of a string field, up to the terminating NUL
+     */
+    std::optional<std::string_view> string(const std::byte* raw, std::size_t raw_size) const
     {
-        return size_ > 0;
+        auto bytes = data(raw, raw_size);
+        if (!bytes || !is_string())
+        {
+            return std::nullopt;
+        }
+        return bytes->substr(0, strnlen(bytes->data(), bytes->size()));
     }
 
 private:
+    template <typename T>
+    static std::uint64_t extend(const char* data)
+    {
+        T value;
+        std::memcpy(&value, data, sizeof(value));
+        return static_cast<std::uint64_t>(static_cast<std::int64_t>(value));
+    }
+
     std::string name_;
+    std::string type_;
     std::ptrdiff_t offset_;
     std::size_t size_ = 0;
+    Kind kind_ = Kind::OTHER;
+    bool signed_ = false;
+    // __rel_loc instead of __data_loc
+    bool relative_ = false;
+    std::size_t element_size_ = 0;
+    std::size_t array_length_ = 0;
 };
+
+class TracepointEventAttr;
+
+/**
+ * The parsed format file of a tracepoint: its id and its fields
+ */
+struct TracepointFormat
+{
+    TracepointFormat() = default;
+
+    TracepointFormat(int id, std::vector<EventField> fields) : id(id), fields(std::move(fields))
+    {
+    }
+
+    /**
+     * the format of event, as parsed when it was created
+     */
+    explicit TracepointFormat(const TracepointEventAttr& event);
+
+    /**
+     * @throws std::invalid_argument if a field is malformed or the id is missing
+     */
+    static TracepointFormat parse(std::istream& format);
+
+    const EventField& field(const std::string& name) const
+    {
+        for (const auto& field : fields)
+        {
+            if (field.name() == name)
+            {
+                return field;
+            }
+        }
+        throw std::out_of_range("field not found: " + name);
+    }
+
+    int id = -1;
+    std::vector<EventField> fields;
+};
+
+/**
+ * @returns the id of the tracepoint a sample was recorded from, i.e. its
+ * common_type field, if it carries raw data
+ */
+inline std::optional<std::uint16_t> common_type(const SampleView& sample)
+{
+    std::uint16_t type;
+    if (sample.raw == nullptr || sample.raw_size < sizeof(type))
+    {
+        return std::nullopt;
+    }
+    // common_type is the first field of every tracepoint
+    std::memcpy(&type, sample.raw, sizeof(type));
+    return type;
+}
 } // namespace tracepoint
 } // namespace perf_cpp
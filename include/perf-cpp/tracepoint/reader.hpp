@@ -23,6 +23,7 @@
 
 #include <perf-cpp/tracepoint/format.hpp>
 
+#include <perf-cpp/arena.hpp>
 #include <perf-cpp/event_composer.hpp>
 #include <perf-cpp/event_reader.hpp>
 #include <perf-cpp/event_resolver.hpp>
@@ -34,10 +35,12 @@
 
 #include <filesystem>
 #include <optional>
+#include <string_view>
 
 #include <ios>
 
 #include <cstddef>
+#include <cstring>
 
 extern "C"
 {
@@ -59,35 +62,28 @@ namespace perf_cpp
         public:
             struct RecordDynamicFormat
             {
+                // integer fields, sign-extended only if the field is signed
                 uint64_t get(const EventField& field) const
                 {
-                    switch (field.size())
-                    {
-                    case 1:
-                        return _get<int8_t>(field.offset());
-                    case 2:
-                        return _get<int16_t>(field.offset());
-                    case 4:
-                        return _get<int32_t>(field.offset());
-                    case 8:
-                        return _get<int64_t>(field.offset());
-                    default:
-                        return 0;
-                    }
+                    return field.integer(raw_data_, size_).value_or(0);
                 }
 
+                // fixed char arrays and __data_loc strings
                 std::string get_str(const EventField& field) const
                 {
-                    std::string ret;
-                    ret.resize(field.size());
-                    auto input_cstr = reinterpret_cast<const char*>(raw_data_ + field.offset());
-                    size_t i;
-                    for (i = 0; i < field.size() && input_cstr[i] != '\0'; i++)
-                    {
-                        ret[i] = input_cstr[i];
-                    }
-                    ret.resize(i);
-                    return ret;
+                    return std::string(field.string(raw_data_, size_).value_or(""));
+                }
+
+                // same as above, but the string lives in arena instead of the heap
+                std::string_view get_str(const EventField& field, Arena& arena) const
+                {
+                    return arena.copy(field.string(raw_data_, size_).value_or(""));
+                }
+
+                // the bytes of any field, following __data_loc to dynamic arrays
+                std::string_view get_data(const EventField& field) const
+                {
+                    return field.data(raw_data_, size_).value_or("");
                 }
 
                 template <typename TT>
@@ -0,0 +1,171 @@
+/*
+ * This file is part of the perf_cpp library.
+ * Linux Perf C++ bindings
+ *
+ * Copyright (c) 2024,
+ *    Technische Universitaet Dresden, Germany
+ *
+ * perf_cpp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * perf_cpp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with perf_cpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <perf-cpp/tracepoint/format.hpp>
+
+#include <filesystem>
+#include <istream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace perf_cpp
+{
+
+namespace tracepoint
+{
+
+/**
+ * Locates tracefs. Since Linux 4.1 it has its own mount point at
+ * /sys/kernel/tracing, before that (and still, as an automount) it lives in
+ * the tracing directory of debugfs, which is often only readable by root.
+ */
+class Tracefs
+{
+public:
+    /**
+     * tracefs as found in /proc/self/mounts when first called
+     */
+    static const Tracefs& instance()
+    {
+        static Tracefs tracefs(discover());
+        return tracefs;
+    }
+
+    explicit Tracefs(std::optional<std::filesystem::path> root) : root_(std::move(root))
+    {
+    }
+
+    /**
+     * Finds tracefs in a mount table (in the format of /proc/mounts),
+     * preferring /sys/kernel/tracing over other tracefs mounts and those
+     * over the tracing directory of debugfs.
+     * @returns nullopt if neither is mounted
+     */
+    static std::optional<std::filesystem::path> discover(std::istream& mounts);
+
+    /**
+     * discover() on /proc/self/mounts, checking the default locations if
+     * the mount table can not be read (e.g. in some containers)
+     */
+    static std::optional<std::filesystem::path> discover();
+
+    bool available() const
+    {
+        return root_.has_value();
+    }
+
+    /**
+     * the root of tracefs, /sys/kernel/tracing if it was not found, so that
+     * errors name a sensible path
+     */
+    std::filesystem::path root() const
+    {
+        return root_.value_or("/sys/kernel/tracing");
+    }
+
+    std::filesystem::path events() const
+    {
+        return root() / "events";
+    }
+
+private:
+    std::optional<std::filesystem::path> root_;
+};
+
+/**
+ * An index of the tracepoints in tracefs by subsystem.
+ *
+ * Nothing is read up front: the subsystems are listed on first use, the
+ * events of a subsystem when a lookup or pattern first needs them, and the
+ * format of an event when it is first asked for. Looking up a few
+ * tracepoints by name therefore only reads their directories, instead of
+ * all of available_events. Thread-safe.
+ */
+class TracepointCatalog
+{
+public:
+    static TracepointCatalog& instance()
+    {
+        static TracepointCatalog catalog(Tracefs::instance().events());
+        return catalog;
+    }
+
+    /**
+     * a catalog of the events directory of a tracefs
+     */
+    explicit TracepointCatalog(std::filesystem::path events);
+
+    /**
+     * name is "<subsystem>:<event>" or "<subsystem>/<event>"
+     */
+    bool contains(std::string_view name);
+
+    std::vector<std::string> subsystems();
+
+    /**
+     * @returns the event names of subsystem, sorted, without the subsystem
+     */
+    std::vector<std::string> events(std::string_view subsystem);
+
+    /**
+     * Finds the tracepoints whose "<subsystem>:<event>" names match pattern,
+     * a glob with *, ? and [...], e.g. "sched:sched_switch", "sched:*" or
+     * "*:*_exit". A pattern without ':' is matched against the event names
+     * of all subsystems. Only the subsystems matching the subsystem part of
+     * the pattern are read.
+     * @returns the names in "<subsystem>:<event>" form, sorted
+     */
+    std::vector<std::string> match(std::string_view pattern);
+
+    /**
+     * @returns the format of the tracepoint, read on first use
+     * @throws std::out_of_range if the tracepoint does not exist
+     * @throws std::runtime_error if its format can not be read or parsed
+     */
+    std::shared_ptr<const TracepointFormat> format(std::string_view name);
+
+private:
+    struct Subsystem
+    {
+        // sorted, nullopt until listed
+        std::optional<std::vector<std::string>> events;
+        std::map<std::string, std::shared_ptr<const TracepointFormat>, std::less<>> formats;
+    };
+
+    void list_subsystems();
+    Subsystem* find_subsystem(std::string_view name);
+    const std::vector<std::string>& list_events(const std::string& name, Subsystem& subsystem);
+
+    std::filesystem::path events_;
+    std::mutex mutex_;
+    bool listed_ = false;
+    std::map<std::string, Subsystem, std::less<>> subsystems_;
+};
+
+} // namespace tracepoint
+} // namespace perf_cpp
@@ -257,6 +257,37 @@ private:
     int id_;
 };
 
+class NumaNode
+{
+public:
+    explicit NumaNode(int id) : id_(id)
+    {
+    }
+
+    static NumaNode invalid()
+    {
+        return NumaNode(-1);
+    }
+
+    friend bool operator==(const NumaNode& lhs, const NumaNode& rhs)
+    {
+        return lhs.id_ == rhs.id_;
+    }
+
+    friend bool operator<(const NumaNode& lhs, const NumaNode& rhs)
+    {
+        return lhs.id_ < rhs.id_;
+    }
+
+    int as_int() const
+    {
+        return id_;
+    }
+
+private:
+    int id_;
+};
+
 class NecDevice
 {
 public:
@@ -350,6 +381,27 @@ struct formatter<perf_cpp::Cpu>
     }
 };
 
+template <>
+struct formatter<perf_cpp::NumaNode>
+{
+    constexpr auto parse(format_parse_context& ctx)
+    {
+        auto it = ctx.begin(), end = ctx.end();
+        if (it != end && *it != '}')
+        {
+            throw format_error("invalid format");
+        }
+
+        return it;
+    }
+
+    template <typename FormatContext>
+    auto format(const perf_cpp::NumaNode& node, FormatContext& ctx) const
+    {
+        return fmt::format_to(ctx.out(), "node {}", node.as_int());
+    }
+};
+
 template <>
 struct formatter<perf_cpp::NecDevice>
 {
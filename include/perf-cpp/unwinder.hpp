@@ -0,0 +1,177 @@
+/*
+ * This file is part of the perf_cpp library.
+ * Linux Perf C++ bindings
+ *
+ * Copyright (c) 2024,
+ *    Technische Universitaet Dresden, Germany
+ *
+ * perf_cpp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * perf_cpp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with perf_cpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <perf-cpp/address_space.hpp>
+#include <perf-cpp/elf_symbols.hpp>
+#include <perf-cpp/record.hpp>
+
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace perf_cpp
+{
+
+/**
+ * How to recover the caller's frame at one address, compiled from the
+ * .eh_frame CFI of a binary. Only the registers needed to walk the stack are
+ * tracked: the CFA (which becomes the caller's stack pointer), the return
+ * address and the frame pointer.
+ */
+struct UnwindRow
+{
+    enum class Cfa : std::uint8_t
+    {
+        // no CFI for this address, or a rule that can not be evaluated
+        UNKNOWN,
+        STACK_POINTER,
+        FRAME_POINTER,
+    };
+
+    enum class Rule : std::uint8_t
+    {
+        UNDEFINED,
+        SAME_VALUE,
+        // saved at CFA + offset
+        OFFSET,
+        UNKNOWN,
+    };
+
+    std::uint64_t address;
+    std::int32_t cfa_offset;
+    std::int32_t ra_offset;
+    std::int32_t fp_offset;
+    Cfa cfa;
+    Rule ra;
+    Rule fp;
+};
+
+/**
+ * The CFI of all FDEs of a binary's .eh_frame, executed once and flattened
+ * into rows sorted by address, so unwinding a frame is a binary search
+ * instead of running CFA programs. Supports x86_64 and aarch64 binaries,
+ * others yield an empty table.
+ *
+ * Addresses are ELF virtual addresses, see SymbolIndex::file_address().
+ */
+class UnwindTable
+{
+public:
+    UnwindTable(const ElfFile& file);
+
+    /**
+     * @returns the row describing address, nullptr if there is no CFI for it
+     */
+    const UnwindRow* lookup(std::uint64_t address) const;
+
+    std::size_t size() const
+    {
+        return rows_.size();
+    }
+
+private:
+    std::vector<std::uint64_t> addresses_;
+    std::vector<UnwindRow> rows_;
+};
+
+/**
+ * Cache of UnwindTables by build-id (or path), like SymbolCache. Thread-safe.
+ */
+class UnwindTableCache
+{
+public:
+    static UnwindTableCache& instance()
+    {
+        static UnwindTableCache cache;
+        return cache;
+    }
+
+    /**
+     * @returns the unwind table of the file, nullptr if it can not be read
+     */
+    std::shared_ptr<const UnwindTable> get(const std::filesystem::path& path);
+
+private:
+    std::mutex mutex_;
+    std::map<std::filesystem::path, std::pair<FileId, std::shared_ptr<const UnwindTable>>>
+        by_path_;
+    std::map<std::string, std::shared_ptr<const UnwindTable>> by_build_id_;
+};
+
+/**
+ * Unwinds user stacks from the register and stack snapshots of samples
+ * (EventAttr::set_sample_regs_user() with required_registers() and
+ * set_sample_stack_user()), for binaries without kernel-usable callchains.
+ *
+ * Every frame is unwound with the .eh_frame CFI of the binary mapped at its
+ * address, if there is a row for it. Code without CFI (e.g. JIT code) is
+ * unwound by following the frame pointer chain. Unwinding stops at the end
+ * of the stack snapshot, at an undefined return address, or when the stack
+ * pointer stops growing.
+ *
+ * Unwinding is expensive compared to reading a kernel callchain, so it is
+ * meant to run on consumer threads (e.g. of a RecordPipeline) on samples
+ * copied with copy_sample(), not on the reader threads. An Unwinder keeps a
+ * cache of the binaries it has seen and is not thread-safe, use one per
+ * thread. The tracker must not be modified while unwind() runs.
+ */
+class Unwinder
+{
+public:
+    Unwinder(const AddressSpaceTracker& tracker) : tracker_(tracker)
+    {
+    }
+
+    /**
+     * @returns the mask of PERF_REG_* registers the unwinder needs for the
+     * architecture this is compiled for
+     */
+    static std::uint64_t required_registers();
+
+    /**
+     * Writes the return addresses of the stack of sample into frames, the
+     * first one being the sampled instruction pointer.
+     * @returns the number of frames written
+     */
+    std::size_t unwind(const SampleView& sample, std::uint64_t* frames, std::size_t max_frames);
+
+private:
+    struct Binary
+    {
+        std::shared_ptr<const SymbolIndex> symbols;
+        std::shared_ptr<const UnwindTable> table;
+    };
+
+    const UnwindRow* find_row(std::uint32_t pid, std::uint64_t address, std::uint64_t time);
+
+    const AddressSpaceTracker& tracker_;
+    // by interned filename of the mapping
+    std::unordered_map<const std::string*, Binary> binaries_;
+};
+
+} // namespace perf_cpp
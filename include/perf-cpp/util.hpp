@@ -16,6 +16,8 @@ std::set<std::uint32_t> parse_list(std::string list);
 std::set<std::uint32_t> parse_list_from_file(std::filesystem::path file);
 
 int perf_event_paranoid();
+std::uint64_t perf_event_mlock_kb();
+std::uint64_t perf_event_max_sample_rate();
 int perf_event_open(struct perf_event_attr* perf_attr, std::variant<Cpu, Thread> location,
                     int group_fd, unsigned long flags, int cgroup_fd = -1);
 
@@ -0,0 +1,391 @@
+/*
+ * This file is part of the perf_cpp library.
+ * Linux Perf C++ bindings
+ *
+ * Copyright (c) 2024,
+ *    Technische Universitaet Dresden, Germany
+ *
+ * perf_cpp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * perf_cpp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with perf_cpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <perf-cpp/address_space.hpp>
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <cstring>
+
+extern "C"
+{
+#include <sys/mman.h>
+}
+
+namespace perf_cpp
+{
+
+namespace
+{
+struct MmapPayload
+{
+    std::uint32_t pid;
+    std::uint32_t tid;
+    std::uint64_t addr;
+    std::uint64_t len;
+    std::uint64_t pgoff;
+};
+
+// the part of PERF_RECORD_MMAP2 between pgoff and the filename
+struct Mmap2Payload
+{
+    union
+    {
+        struct
+        {
+            std::uint32_t maj;
+            std::uint32_t min;
+            std::uint64_t ino;
+            std::uint64_t ino_generation;
+        };
+        struct
+        {
+            std::uint8_t build_id_size;
+            std::uint8_t reserved_1;
+            std::uint16_t reserved_2;
+            std::uint8_t build_id[20];
+        };
+    };
+    std::uint32_t prot;
+    std::uint32_t flags;
+};
+
+struct TaskPayload
+{
+    std::uint32_t pid;
+    std::uint32_t ppid;
+    std::uint32_t tid;
+    std::uint32_t ptid;
+    std::uint64_t time;
+};
+
+template <typename T>
+bool read_payload(const perf_event_header* record, std::size_t offset, T& value)
+{
+    if (sizeof(*record) + offset + sizeof(T) > record->size)
+    {
+        return false;
+    }
+    std::memcpy(&value, reinterpret_cast<const std::byte*>(record + 1) + offset, sizeof(T));
+    return true;
+}
+
+std::string_view read_string(const perf_event_header* record, std::size_t offset)
+{
+    if (sizeof(*record) + offset >= record->size)
+    {
+        return {};
+    }
+    const auto* str = reinterpret_cast<const char*>(record + 1) + offset;
+    return std::string_view(str, strnlen(str, record->size - sizeof(*record) - offset));
+}
+} // namespace
+
+void AddressSpaceTracker::process(const perf_event_header* record)
+{
+    switch (record->type)
+    {
+    case PERF_RECORD_MMAP:
+    case PERF_RECORD_MMAP2:
+    {
+        MmapPayload mmap;
+        if (!read_payload(record, 0, mmap) || mmap.len == 0)
+        {
+            return;
+        }
+
+        Mapping mapping{ mmap.addr, mmap.addr + mmap.len, mmap.pgoff, nullptr, std::nullopt,
+                         time_of(record) };
+        std::size_t filename_offset = sizeof(mmap);
+
+        if (record->type == PERF_RECORD_MMAP2)
+        {
+            Mmap2Payload mmap2;
+            if (!read_payload(record, sizeof(mmap), mmap2) || !(mmap2.prot & PROT_EXEC))
+            {
+                return;
+            }
+#ifdef PERF_RECORD_MISC_MMAP_BUILD_ID
+            if ((record->misc & PERF_RECORD_MISC_MMAP_BUILD_ID) &&
+                mmap2.build_id_size <= sizeof(mmap2.build_id))
+            {
+                std::string id;
+                for (std::size_t i = 0; i < mmap2.build_id_size; i++)
+                {
+                    id += fmt::format("{:02x}", mmap2.build_id[i]);
+                }
+                mapping.build_id = std::move(id);
+            }
+#endif
+            filename_offset += sizeof(mmap2);
+        }
+        else if (record->misc & PERF_RECORD_MISC_MMAP_DATA)
+        {
+            return;
+        }
+
+        mapping.filename = intern(read_string(record, filename_offset));
+        add_mapping(mmap.pid, std::move(mapping));
+        break;
+    }
+    case PERF_RECORD_COMM:
+    {
+        std::uint32_t pid;
+        if (!read_payload(record, 0, pid))
+        {
+            return;
+        }
+
+        auto& process = processes_[pid];
+        process.comm = std::string(read_string(record, 2 * sizeof(std::uint32_t)));
+        if (record->misc & PERF_RECORD_MISC_COMM_EXEC)
+        {
+            // the mmap records of the new image follow the comm record
+            retire_all(process, time_of(record));
+        }
+        break;
+    }
+    case PERF_RECORD_FORK:
+    {
+        TaskPayload task;
+        if (read_payload(record, 0, task))
+        {
+            last_time_ = std::max(last_time_, task.time);
+            fork(task.pid, task.ppid, task.time);
+        }
+        break;
+    }
+    case PERF_RECORD_EXIT:
+    {
+        TaskPayload task;
+        if (!read_payload(record, 0, task))
+        {
+            return;
+        }
+        last_time_ = std::max(last_time_, task.time);
+
+        // the address space only goes away with the last thread, which is
+        // reported as the main thread
+        auto it = processes_.find(task.pid);
+        if (task.pid == task.tid && it != processes_.end())
+        {
+            retire_all(it->second, task.time);
+            it->second.exit_time = task.time;
+        }
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+std::uint64_t AddressSpaceTracker::time_of(const perf_event_header* record)
+{
+    if (auto time = record_time(record, layout_))
+    {
+        last_time_ = std::max(last_time_, *time);
+        return *time;
+    }
+    return last_time_;
+}
+
+const std::string* AddressSpaceTracker::intern(std::string_view str)
+{
+    // node-based, the pointers stay valid on rehash
+    return &*strings_.emplace(str).first;
+}
+
+void AddressSpaceTracker::add_mapping(std::uint32_t pid, Mapping mapping)
+{
+    auto& process = processes_[pid];
+    auto& live = process.live;
+
+    auto it = live.upper_bound(mapping.start);
+    if (it != live.begin() && std::prev(it)->second.end > mapping.start)
+    {
+        --it;
+    }
+
+    // close everything the new mapping overlaps, keep the parts outside of it
+    std::vector<Mapping> rest;
+    while (it != live.end() && it->first < mapping.end)
+    {
+        auto old = it->second;
+        it = live.erase(it);
+
+        if (old.start < mapping.start)
+        {
+            auto left = old;
+            left.end = mapping.start;
+            rest.push_back(left);
+        }
+        if (old.end > mapping.end)
+        {
+            auto right = old;
+            right.start = mapping.end;
+            right.pgoff += mapping.end - old.start;
+            rest.push_back(right);
+        }
+
+        old.to_time = mapping.from_time;
+        if (old.from_time < old.to_time)
+        {
+            process.history.push_back(std::move(old));
+        }
+    }
+
+    for (auto& part : rest)
+    {
+        live.emplace(part.start, std::move(part));
+    }
+    live.emplace(mapping.start, std::move(mapping));
+}
+
+void AddressSpaceTracker::retire_all(Process& process, std::uint64_t time)
+{
+    for (auto& entry : process.live)
+    {
+        auto& mapping = entry.second;
+        mapping.to_time = time;
+        if (mapping.from_time < mapping.to_time)
+        {
+            process.history.push_back(std::move(mapping));
+        }
+    }
+    process.live.clear();
+}
+
+void AddressSpaceTracker::fork(std::uint32_t pid, std::uint32_t ppid, std::uint64_t time)
+{
+    if (pid == ppid)
+    {
+        // a new thread, it shares the address space
+        return;
+    }
+
+    auto& child = processes_[pid];
+    // a reused pid, whatever was there before is gone
+    retire_all(child, time);
+    child.exit_time.reset();
+
+    auto parent = processes_.find(ppid);
+    if (parent == processes_.end())
+    {
+        return;
+    }
+
+    child.comm = parent->second.comm;
+    for (const auto& entry : parent->second.live)
+    {
+        auto mapping = entry.second;
+        mapping.from_time = time;
+        child.live.emplace(entry.first, std::move(mapping));
+    }
+}
+
+const Mapping* AddressSpaceTracker::find(std::uint32_t pid, std::uint64_t address,
+                                         std::optional<std::uint64_t> time) const
+{
+    auto process = processes_.find(pid);
+    if (process == processes_.end())
+    {
+        return nullptr;
+    }
+
+    const auto& live = process->second.live;
+    auto it = live.upper_bound(address);
+    if (it != live.begin())
+    {
+        const auto& mapping = std::prev(it)->second;
+        if (mapping.contains(address) && (!time || mapping.valid_at(*time)))
+        {
+            return &mapping;
+        }
+    }
+
+    if (!time)
+    {
+        return nullptr;
+    }
+
+    // most lookups that get here are for recently replaced mappings
+    const auto& history = process->second.history;
+    for (auto mapping = history.rbegin(); mapping != history.rend(); ++mapping)
+    {
+        if (mapping->contains(address) && mapping->valid_at(*time))
+        {
+            return &*mapping;
+        }
+    }
+    return nullptr;
+}
+
+void AddressSpaceTracker::find(std::uint32_t pid, const std::uint64_t* addresses,
+                               std::size_t count, std::optional<std::uint64_t> time,
+                               const Mapping** result) const
+{
+    const Mapping* last = nullptr;
+    for (std::size_t i = 0; i < count; i++)
+    {
+        // consecutive frames are often in the same object
+        if (last != nullptr && last->contains(addresses[i]))
+        {
+            result[i] = last;
+            continue;
+        }
+        result[i] = last = find(pid, addresses[i], time);
+    }
+}
+
+std::optional<std::string> AddressSpaceTracker::comm(std::uint32_t pid) const
+{
+    auto process = processes_.find(pid);
+    if (process == processes_.end() || process->second.comm.empty())
+    {
+        return std::nullopt;
+    }
+    return process->second.comm;
+}
+
+void AddressSpaceTracker::expire(std::uint64_t time)
+{
+    for (auto it = processes_.begin(); it != processes_.end();)
+    {
+        auto& process = it->second;
+        process.history.erase(std::remove_if(process.history.begin(), process.history.end(),
+                                             [time](const Mapping& mapping)
+                                             { return mapping.to_time <= time; }),
+                              process.history.end());
+
+        if (process.exit_time && *process.exit_time <= time && process.live.empty() &&
+            process.history.empty())
+        {
+            it = processes_.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+
+} // namespace perf_cpp
@@ -0,0 +1,399 @@
+/*
+ * This file is part of the perf_cpp library.
+ * Linux Perf C++ bindings
+ *
+ * Copyright (c) 2024,
+ *    Technische Universitaet Dresden, Germany
+ *
+ * perf_cpp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * perf_cpp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with perf_cpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <perf-cpp/analysis/block_latency.hpp>
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace perf_cpp
+{
+
+namespace analysis
+{
+
+namespace
+{
+// request keys are (device index << 48) | sector, 48 bits of 512 byte
+// sectors are 128 PiB
+constexpr unsigned sector_bits = 48;
+constexpr std::uint64_t sector_mask = (std::uint64_t(1) << sector_bits) - 1;
+} // namespace
+
+const char* to_string(BlockOp op)
+{
+    switch (op)
+    {
+    case BlockOp::READ:
+        return "read";
+    case BlockOp::WRITE:
+        return "write";
+    case BlockOp::DISCARD:
+        return "discard";
+    case BlockOp::FLUSH:
+        return "flush";
+    case BlockOp::OTHER:
+        return "other";
+    }
+    return "other";
+}
+
+BlockOp block_op(std::string_view rwbs)
+{
+    // blk_fill_rwbs(): an optional F (preflush), then the operation F
+    // (flush), W, D, DE (secure erase), R or N, then modifiers such as F
+    // (FUA), A, S and M. A preflush counts for the operation it precedes.
+    const auto op = rwbs.find_first_not_of('F');
+    if (op == std::string_view::npos)
+    {
+        return rwbs.empty() ? BlockOp::OTHER : BlockOp::FLUSH;
+    }
+    switch (rwbs[op])
+    {
+    case 'R':
+        return BlockOp::READ;
+    case 'W':
+        return BlockOp::WRITE;
+    case 'D':
+    case 'E':
+        return BlockOp::DISCARD;
+    default:
+        return BlockOp::OTHER;
+    }
+}
+
+BlockLatencyAnalyzer::DeviceStats::DeviceStats(BlockDevice device, std::uint64_t index,
+                                               unsigned precision)
+: device(device), index_(index)
+{
+    device_latency_.fill(LatencyHistogram(precision));
+    queue_latency_.fill(LatencyHistogram(precision));
+}
+
+void BlockLatencyAnalyzer::DeviceStats::advance(std::uint64_t time, std::uint64_t interval,
+                                                std::size_t max_points)
+{
+    if (interval_begin_ == 0)
+    {
+        interval_begin_ = time;
+        last_change_ = time;
+        return;
+    }
+    // a late sample, the depth it changes is counted from now on
+    if (time <= last_change_)
+    {
+        return;
+    }
+
+    // after a long gap, only the intervals that still fit the series matter
+    const auto intervals = (time - interval_begin_) / interval;
+    if (intervals > max_points)
+    {
+        area_ = 0;
+        depth_max_ = depth_;
+        interval_begin_ += (intervals - max_points) * interval;
+        last_change_ = interval_begin_;
+    }
+
+    while (time >= interval_begin_ + interval)
+    {
+        const auto end = interval_begin_ + interval;
+        area_ += depth_ * (end - last_change_);
+        series_.push_back(DepthPoint{ interval_begin_,
+                                      static_cast<double>(area_) / static_cast<double>(interval),
+                                      depth_max_ });
+        if (series_.size() > max_points)
+        {
+            series_.pop_front();
+        }
+        interval_begin_ = end;
+        last_change_ = end;
+        area_ = 0;
+        depth_max_ = depth_;
+    }
+
+    area_ += depth_ * (time - last_change_);
+    last_change_ = time;
+}
+
+BlockLatencyAnalyzer::Fields::Fields(const tracepoint::TracepointFormat& format)
+: type(static_cast<std::uint16_t>(format.id)), dev(format.field("dev")),
+  sector(format.field("sector")), rwbs(format.field("rwbs"))
+{
+}
+
+BlockLatencyAnalyzer::BlockLatencyAnalyzer(const tracepoint::TracepointEventAttr& issue,
+                                           const tracepoint::TracepointEventAttr& complete,
+                                           Options options)
+: BlockLatencyAnalyzer(std::nullopt, tracepoint::TracepointFormat(issue),
+                       tracepoint::TracepointFormat(complete), std::move(options))
+{
+}
+
+BlockLatencyAnalyzer::BlockLatencyAnalyzer(const tracepoint::TracepointEventAttr& insert,
+                                           const tracepoint::TracepointEventAttr& issue,
+                                           const tracepoint::TracepointEventAttr& complete,
+                                           Options options)
+: BlockLatencyAnalyzer(tracepoint::TracepointFormat(insert), tracepoint::TracepointFormat(issue),
+                       tracepoint::TracepointFormat(complete), std::move(options))
+{
+}
+
+BlockLatencyAnalyzer::BlockLatencyAnalyzer(
+    const std::optional<tracepoint::TracepointFormat>& insert,
+    const tracepoint::TracepointFormat& issue, const tracepoint::TracepointFormat& complete,
+    Options options)
+: options_(std::move(options)), issue_(issue), complete_(complete),
+  queue_(options_.reorder_window), requests_(options_.max_requests)
+{
+    if (insert)
+    {
+        insert_.emplace(*insert);
+    }
+}
+
+void BlockLatencyAnalyzer::prepare(EventAttr& attr)
+{
+    attr.sample_period(1);
+    attr.set_sample_type(PERF_SAMPLE_RAW | PERF_SAMPLE_TID | PERF_SAMPLE_TIME);
+}
+
+tracepoint::Filter BlockLatencyAnalyzer::device_filter(const std::vector<BlockDevice>& devices)
+{
+    std::vector<std::uint32_t> devs;
+    for (const auto& device : devices)
+    {
+        devs.push_back(device.kernel_dev());
+    }
+    return tracepoint::field("dev").in(devs);
+}
+
+tracepoint::Filter BlockLatencyAnalyzer::filter() const
+{
+    if (options_.devices.empty())
+    {
+        throw std::logic_error("no block devices selected");
+    }
+    return device_filter(options_.devices);
+}
+
+void BlockLatencyAnalyzer::process(const SampleView& sample)
+{
+    const auto type = tracepoint::common_type(sample);
+    const Fields* fields = nullptr;
+    Event event{ sample.time, 0, 0, Type::ISSUE, BlockOp::OTHER };
+    if (type == issue_.type)
+    {
+        fields = &issue_;
+    }
+    else if (type == complete_.type)
+    {
+        fields = &complete_;
+        event.type = Type::COMPLETE;
+    }
+    else if (insert_ && type == insert_->type)
+    {
+        fields = &*insert_;
+        event.type = Type::INSERT;
+    }
+    else
+    {
+        return;
+    }
+
+    const auto dev = fields->dev.integer(sample.raw, sample.raw_size);
+    const auto sector = fields->sector.integer(sample.raw, sample.raw_size);
+    if (!dev || !sector)
+    {
+        return;
+    }
+    event.dev = static_cast<std::uint32_t>(*dev);
+    event.sector = *sector;
+
+    // the filter may not have been applied, or was rejected by the kernel
+    if (!options_.devices.empty() &&
+        std::none_of(options_.devices.begin(), options_.devices.end(),
+                     [&](const BlockDevice& d) { return d.kernel_dev() == event.dev; }))
+    {
+        return;
+    }
+
+    if (auto rwbs = fields->rwbs.string(sample.raw, sample.raw_size))
+    {
+        event.op = block_op(*rwbs);
+    }
+
+    queue_.push(event.time, event, [this](const Event& e) { handle(e); });
+}
+
+void BlockLatencyAnalyzer::process(const RecordBatch& records, const RecordLayout& layout)
+{
+    for_each_sample(records, layout, [this](Cpu, const SampleView& sample) { process(sample); });
+}
+
+void BlockLatencyAnalyzer::flush()
+{
+    queue_.flush([this](const Event& e) { handle(e); });
+}
+
+void BlockLatencyAnalyzer::handle(const Event& event)
+{
+    auto* stats = device(event.dev);
+    if (stats == nullptr)
+    {
+        return;
+    }
+    const auto key = (stats->index_ << sector_bits) | (event.sector & sector_mask);
+    const auto interval = static_cast<std::uint64_t>(options_.depth_interval.count());
+    const auto op = static_cast<std::size_t>(event.op);
+
+    switch (event.type)
+    {
+    case Type::INSERT:
+        if (!insert(key, Request{ event.time, 0, event.op }, event.time))
+        {
+            counters_.dropped++;
+        }
+        break;
+    case Type::ISSUE:
+    {
+        auto* request = requests_.find(key);
+        if (request == nullptr)
+        {
+            if (!insert(key, Request{ 0, event.time, event.op }, event.time))
+            {
+                counters_.dropped++;
+                return;
+            }
+        }
+        else if (request->issued != 0)
+        {
+            // requeued and issued again, it is still one request in flight
+            request->issued = event.time;
+            return;
+        }
+        else
+        {
+            if (event.time >= request->inserted)
+            {
+                stats->queue_latency_[op].record(event.time - request->inserted);
+            }
+            request->issued = event.time;
+            request->op = event.op;
+        }
+        stats->advance(event.time, interval, options_.max_depth_points);
+        stats->depth_++;
+        stats->depth_max_ = std::max(stats->depth_max_, stats->depth_);
+        break;
+    }
+    case Type::COMPLETE:
+    {
+        const auto request = requests_.take(key);
+        if (!request || request->issued == 0)
+        {
+            counters_.unmatched++;
+            return;
+        }
+        if (event.time >= request->issued)
+        {
+            stats->device_latency_[static_cast<std::size_t>(request->op)].record(
+                event.time - request->issued);
+        }
+        stats->advance(event.time, interval, options_.max_depth_points);
+        if (stats->depth_ > 0)
+        {
+            stats->depth_--;
+        }
+        break;
+    }
+    }
+}
+
+bool BlockLatencyAnalyzer::insert(std::uint64_t key, const Request& request, std::uint64_t time)
+{
+    const auto stale = static_cast<std::uint64_t>(options_.stale_after.count());
+    const auto interval = static_cast<std::uint64_t>(options_.depth_interval.count());
+    return requests_.insert_evicting(
+        key, request, time, stale,
+        [](const Request& other) { return std::max(other.inserted, other.issued); },
+        [&](std::uint64_t other, const Request& evicted)
+        {
+            counters_.stale++;
+            if (evicted.issued == 0)
+            {
+                return;
+            }
+            // the request no longer counts as in flight
+            const auto index = other >> sector_bits;
+            for (auto& [dev, stats] : devices_)
+            {
+                if (stats.index_ == index && stats.depth_ > 0)
+                {
+                    stats.advance(time, interval, options_.max_depth_points);
+                    stats.depth_--;
+                }
+            }
+        });
+}
+
+BlockLatencyAnalyzer::DeviceStats* BlockLatencyAnalyzer::device(std::uint32_t dev)
+{
+    auto it = devices_.find(dev);
+    if (it != devices_.end())
+    {
+        return &it->second;
+    }
+    if (devices_.size() >= options_.max_devices)
+    {
+        counters_.untracked++;
+        return nullptr;
+    }
+    // devices are never removed, so the index stays unique
+    return &devices_
+                .emplace(dev, DeviceStats(BlockDevice::from_kernel_dev(dev), devices_.size(),
+                                          options_.precision))
+                .first->second;
+}
+
+void BlockLatencyAnalyzer::reset()
+{
+    for (auto& [dev, stats] : devices_)
+    {
+        for (auto& histogram : stats.device_latency_)
+        {
+            histogram.clear();
+        }
+        for (auto& histogram : stats.queue_latency_)
+        {
+            histogram.clear();
+        }
+        // the depth stays, its series starts over with the next event
+        stats.series_.clear();
+        stats.interval_begin_ = 0;
+        stats.area_ = 0;
+        stats.depth_max_ = stats.depth_;
+    }
+    counters_ = Counters();
+    queue_.reset_late();
+}
+
+} // namespace analysis
+} // namespace perf_cpp
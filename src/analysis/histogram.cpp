@@ -0,0 +1,112 @@
+/*
+ * This file is part of the perf_cpp library.
+ * Linux Perf C++ bindings
+ *
+ * Copyright (c) 2024,
+ *    Technische Universitaet Dresden, Germany
+ *
+ * perf_cpp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * perf_cpp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with perf_cpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <perf-cpp/analysis/histogram.hpp>
+
+#include <cmath>
+#include <stdexcept>
+
+namespace perf_cpp
+{
+
+namespace analysis
+{
+
+LatencyHistogram::LatencyHistogram(unsigned precision, unsigned max_value_bits)
+: precision_(precision)
+{
+    if (precision < 1 || precision > 16 || max_value_bits <= precision || max_value_bits > 64)
+    {
+        throw std::invalid_argument("histogram precision must be in 1..16 and below the range");
+    }
+    // the largest value in range has msb max_value_bits - 1
+    counts_.resize(static_cast<std::size_t>(max_value_bits - precision + 1) << precision, 0);
+}
+
+void LatencyHistogram::merge(const LatencyHistogram& other)
+{
+    if (other.precision_ != precision_ || other.counts_.size() != counts_.size())
+    {
+        throw std::invalid_argument("can only merge histograms of the same precision and range");
+    }
+    for (std::size_t i = 0; i < counts_.size(); i++)
+    {
+        counts_[i] += other.counts_[i];
+    }
+    count_ += other.count_;
+    sum_ += other.sum_;
+    min_ = std::min(min_, other.min_);
+    max_ = std::max(max_, other.max_);
+}
+
+void LatencyHistogram::clear()
+{
+    std::fill(counts_.begin(), counts_.end(), 0);
+    count_ = 0;
+    sum_ = 0;
+    min_ = std::numeric_limits<std::uint64_t>::max();
+    max_ = 0;
+}
+
+std::uint64_t LatencyHistogram::percentile(double quantile) const
+{
+    if (count_ == 0)
+    {
+        return 0;
+    }
+
+    const auto rank = std::max<std::uint64_t>(
+        1, static_cast<std::uint64_t>(std::ceil(std::clamp(quantile, 0.0, 1.0) * count_)));
+    std::uint64_t seen = 0;
+    for (std::size_t i = 0; i < counts_.size(); i++)
+    {
+        seen += counts_[i];
+        if (seen >= rank)
+        {
+            return std::clamp(highest(i), min(), max_);
+        }
+    }
+    return max_;
+}
+
+std::uint64_t LatencyHistogram::lowest(std::size_t index) const
+{
+    const std::size_t group = index >> precision_;
+    if (group == 0)
+    {
+        return index;
+    }
+    const std::uint64_t sub = index & ((std::size_t(1) << precision_) - 1);
+    return ((std::uint64_t(1) << precision_) + sub) << (group - 1);
+}
+
+std::uint64_t LatencyHistogram::highest(std::size_t index) const
+{
+    const std::size_t group = index >> precision_;
+    if (group == 0)
+    {
+        return index;
+    }
+    return lowest(index) + (std::uint64_t(1) << (group - 1)) - 1;
+}
+
+} // namespace analysis
+} // namespace perf_cpp
@@ -0,0 +1,336 @@
+/*
+ * This file is part of the perf_cpp library.
+ * Linux Perf C++ bindings
+ *
+ * Copyright (c) 2024,
+ *    Technische Universitaet Dresden, Germany
+ *
+ * perf_cpp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * perf_cpp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with perf_cpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <perf-cpp/analysis/lock_contention.hpp>
+
+#include <fmt/format.h>
+
+#include <algorithm>
+
+namespace perf_cpp
+{
+
+namespace analysis
+{
+
+const char* lock_type(std::uint32_t flags)
+{
+    using namespace lock_flags;
+    // the table of perf lock contention
+    switch (flags & (spin | read | write | rt | percpu | mutex))
+    {
+    case spin:
+        return "spinlock";
+    case spin | read:
+        return "rwlock:R";
+    case spin | write:
+        return "rwlock:W";
+    case read:
+        return "rwsem:R";
+    case write:
+        return "rwsem:W";
+    case rt:
+        return "rt-mutex";
+    case rt | read:
+        return "rwlock-rt:R";
+    case rt | write:
+        return "rwlock-rt:W";
+    case percpu | read:
+        return "pcpu-sem:R";
+    case percpu | write:
+        return "pcpu-sem:W";
+    case mutex:
+        return "mutex";
+    case mutex | spin:
+        // optimistic spinning on the owner
+        return "mutex-spin";
+    default:
+        return "unknown";
+    }
+}
+
+LockContentionAnalyzer::LockContentionAnalyzer(
+    const tracepoint::TracepointEventAttr& contention_begin,
+    const tracepoint::TracepointEventAttr& contention_end, Options options)
+: LockContentionAnalyzer(
+      tracepoint::TracepointFormat(contention_begin), tracepoint::TracepointFormat(contention_end),
+      options)
+{
+}
+
+LockContentionAnalyzer::LockContentionAnalyzer(
+    const tracepoint::TracepointFormat& contention_begin,
+    const tracepoint::TracepointFormat& contention_end, Options options)
+: options_(options), begin_type_(static_cast<std::uint16_t>(contention_begin.id)),
+  end_type_(static_cast<std::uint16_t>(contention_end.id)),
+  begin_lock_(contention_begin.field("lock_addr")),
+  begin_flags_(contention_begin.field("flags")), end_lock_(contention_end.field("lock_addr")),
+  queue_(options.reorder_window), waits_(options.max_tasks)
+{
+}
+
+void LockContentionAnalyzer::prepare(EventAttr& attr, bool stacks)
+{
+    attr.sample_period(1);
+    attr.set_sample_type(PERF_SAMPLE_RAW | PERF_SAMPLE_TID | PERF_SAMPLE_TIME |
+                         PERF_SAMPLE_CPU);
+    if (stacks)
+    {
+        attr.set_sample_type(PERF_SAMPLE_CALLCHAIN);
+    }
+}
+
+void LockContentionAnalyzer::process(const SampleView& sample)
+{
+    const auto type = tracepoint::common_type(sample);
+    Event event{ sample.time, 0, sample.pid, sample.tid, sample.cpu, 0, false, CallTree::root };
+    if (type == begin_type_)
+    {
+        event.begin = true;
+        event.lock = begin_lock_.integer(sample.raw, sample.raw_size).value_or(0);
+        event.flags = static_cast<std::uint32_t>(
+            begin_flags_.integer(sample.raw, sample.raw_size).value_or(0));
+        if (options_.stacks && sample.callchain != nullptr)
+        {
+            if (stacks_.size() < options_.max_stack_nodes)
+            {
+                event.stack = stacks_.add(sample.callchain, sample.callchain_size, 0);
+            }
+            else
+            {
+                counters_.dropped_stacks++;
+            }
+        }
+    }
+    else if (type == end_type_)
+    {
+        event.lock = end_lock_.integer(sample.raw, sample.raw_size).value_or(0);
+    }
+    else
+    {
+        return;
+    }
+
+    queue_.push(event.time, event, [this](const Event& e) { handle(e); });
+}
+
+void LockContentionAnalyzer::process(const RecordBatch& records, const RecordLayout& layout)
+{
+    for_each_sample(records, layout,
+                    [&](Cpu cpu, const SampleView& sample)
+                    {
+                        // the batch knows the cpu even without PERF_SAMPLE_CPU
+                        if ((layout.sample_type & PERF_SAMPLE_CPU) != 0)
+                        {
+                            process(sample);
+                            return;
+                        }
+                        auto copy = sample;
+                        copy.cpu = static_cast<std::uint32_t>(cpu.as_int());
+                        process(copy);
+                    });
+}
+
+void LockContentionAnalyzer::flush()
+{
+    queue_.flush([this](const Event& e) { handle(e); });
+}
+
+void LockContentionAnalyzer::handle(const Event& event)
+{
+    if (event.begin)
+    {
+        begin(event);
+    }
+    else
+    {
+        end(event);
+    }
+}
+
+void LockContentionAnalyzer::begin(const Event& event)
+{
+    const auto stale = static_cast<std::uint64_t>(options_.stale_after.count());
+    const Wait wait{ event.lock, event.time, event.flags, event.stack };
+    if (auto* pending = waits_.find(event.tid))
+    {
+        // a mutex begins again when it stops spinning and goes to sleep, the
+        // wait goes on. Any other lock is nested in the wait for this one,
+        // unless we lost the end of that wait.
+        if (pending->lock == event.lock)
+        {
+            pending->flags = event.flags;
+        }
+        else if (event.time > pending->since && event.time - pending->since > stale)
+        {
+            *pending = wait;
+        }
+        return;
+    }
+
+    // mostly waits whose end we lost
+    if (!waits_.insert_evicting(event.tid, wait, event.time, stale,
+                                [](const Wait& other) { return other.since; }))
+    {
+        counters_.dropped++;
+    }
+}
+
+void LockContentionAnalyzer::end(const Event& event)
+{
+    auto* pending = waits_.find(event.tid);
+    if (pending == nullptr)
+    {
+        counters_.unmatched++;
+        return;
+    }
+    // the end of a nested contention
+    if (pending->lock != event.lock)
+    {
+        return;
+    }
+    const auto wait = *waits_.take(event.tid);
+    if (event.time < wait.since)
+    {
+        return;
+    }
+    const auto wait_time = event.time - wait.since;
+
+    if (cpus_.size() <= event.cpu)
+    {
+        cpus_.resize(event.cpu + 1, CpuStats(options_.precision));
+    }
+    cpus_[event.cpu].wait_time.record(wait_time);
+    cpus_[event.cpu].total += wait_time;
+
+    auto lock = locks_.find(wait.lock);
+    if (lock == locks_.end() && locks_.size() < options_.max_locks)
+    {
+        lock = locks_.emplace(wait.lock, LockStats(options_.precision)).first;
+    }
+    if (lock != locks_.end())
+    {
+        lock->second.wait_time.record(wait_time);
+        lock->second.total += wait_time;
+        lock->second.flags = wait.flags;
+    }
+
+    auto task = tasks_.find(event.tid);
+    if (task == tasks_.end() && tasks_.size() < options_.max_tracked_tasks)
+    {
+        task = tasks_.emplace(event.tid, TaskStats{ event.pid, 0, 0 }).first;
+    }
+    if (task != tasks_.end())
+    {
+        task->second.contentions++;
+        task->second.total += wait_time;
+    }
+
+    if (lock == locks_.end() || task == tasks_.end())
+    {
+        counters_.untracked++;
+    }
+
+    if (wait.stack != CallTree::root)
+    {
+        stacks_.add_weight(wait.stack, wait_time);
+    }
+}
+
+LatencyHistogram LockContentionAnalyzer::wait_time() const
+{
+    LatencyHistogram merged(options_.precision);
+    for (const auto& cpu : cpus_)
+    {
+        merged.merge(cpu.wait_time);
+    }
+    return merged;
+}
+
+std::vector<LockContentionAnalyzer::Row>
+LockContentionAnalyzer::report(std::size_t count, const KernelSymbols* symbols) const
+{
+    std::vector<Row> rows;
+    rows.reserve(locks_.size());
+    for (const auto& [address, lock] : locks_)
+    {
+        if (lock.wait_time.count() != 0)
+        {
+            rows.push_back(Row{ address, {}, lock_type(lock.flags), lock.wait_time.count(),
+                                lock.total, lock.wait_time.max() });
+        }
+    }
+
+    const auto by_total = [](const Row& lhs, const Row& rhs)
+    { return lhs.total != rhs.total ? lhs.total > rhs.total : lhs.lock < rhs.lock; };
+    if (rows.size() > count)
+    {
+        std::partial_sort(rows.begin(), rows.begin() + count, rows.end(), by_total);
+        rows.resize(count);
+    }
+    else
+    {
+        std::sort(rows.begin(), rows.end(), by_total);
+    }
+
+    if (symbols != nullptr)
+    {
+        for (auto& row : rows)
+        {
+            if (auto symbol = symbols->lookup(row.lock))
+            {
+                row.name = row.lock == symbol->start
+                               ? std::string(symbol->name)
+                               : fmt::format("{}+{:#x}", symbol->name, row.lock - symbol->start);
+            }
+        }
+    }
+    return rows;
+}
+
+void LockContentionAnalyzer::reset()
+{
+    for (auto& cpu : cpus_)
+    {
+        cpu.wait_time.clear();
+        cpu.total = 0;
+    }
+    locks_.clear();
+    tasks_.clear();
+    // only waits in progress and queued samples still refer to nodes, keep
+    // their stacks and drop the others
+    CallTree stacks;
+    const auto keep = [&](CallTree::NodeId& stack)
+    {
+        if (stack != CallTree::root)
+        {
+            stack = stacks.import(stacks_, stack);
+        }
+    };
+    waits_.for_each([&](std::uint64_t, Wait& wait) { keep(wait.stack); });
+    queue_.for_each([&](Event& event) { keep(event.stack); });
+    stacks_ = std::move(stacks);
+    counters_ = Counters();
+    queue_.reset_late();
+}
+
+} // namespace analysis
+} // namespace perf_cpp
@@ -0,0 +1,309 @@
+/*
+ * This file is part of the perf_cpp library.
+ * Linux Perf C++ bindings
+ *
+ * Copyright (c) 2024,
+ *    Technische Universitaet Dresden, Germany
+ *
+ * perf_cpp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * perf_cpp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with perf_cpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <perf-cpp/analysis/sched_latency.hpp>
+
+#include <algorithm>
+
+namespace perf_cpp
+{
+
+namespace analysis
+{
+
+const char* to_string(BlockReason reason)
+{
+    switch (reason)
+    {
+    case BlockReason::PREEMPTED:
+        return "preempted";
+    case BlockReason::SLEEPING:
+        return "sleeping";
+    case BlockReason::UNINTERRUPTIBLE:
+        return "uninterruptible";
+    case BlockReason::STOPPED:
+        return "stopped";
+    case BlockReason::IDLE:
+        return "idle";
+    case BlockReason::OTHER:
+        return "other";
+    }
+    return "other";
+}
+
+BlockReason block_reason(std::uint64_t prev_state)
+{
+    // TASK_REPORT: the low 8 bits are the state letters R S D T t X Z P I,
+    // anything above marks a preemption (TASK_REPORT_MAX, or TASK_STATE_MAX
+    // before Linux 4.14)
+    const auto state = prev_state & 0xff;
+    if (state == 0)
+    {
+        return BlockReason::PREEMPTED;
+    }
+    switch (state & -state)
+    {
+    case 0x01:
+        return BlockReason::SLEEPING;
+    case 0x02:
+        return BlockReason::UNINTERRUPTIBLE;
+    case 0x04:
+    case 0x08:
+        return BlockReason::STOPPED;
+    case 0x80:
+        return BlockReason::IDLE;
+    default:
+        return BlockReason::OTHER;
+    }
+}
+
+SchedLatencyAnalyzer::SchedLatencyAnalyzer(
+    const tracepoint::TracepointEventAttr& sched_switch,
+    const tracepoint::TracepointEventAttr& sched_wakeup,
+    const tracepoint::TracepointEventAttr& sched_migrate_task, Options options)
+: SchedLatencyAnalyzer(
+      tracepoint::TracepointFormat(sched_switch), tracepoint::TracepointFormat(sched_wakeup),
+      tracepoint::TracepointFormat(sched_migrate_task), options)
+{
+}
+
+SchedLatencyAnalyzer::SchedLatencyAnalyzer(const tracepoint::TracepointFormat& sched_switch,
+                                           const tracepoint::TracepointFormat& sched_wakeup,
+                                           const tracepoint::TracepointFormat& sched_migrate_task,
+                                           Options options)
+: options_(options), switch_type_(static_cast<std::uint16_t>(sched_switch.id)),
+  wakeup_type_(static_cast<std::uint16_t>(sched_wakeup.id)),
+  migrate_type_(static_cast<std::uint16_t>(sched_migrate_task.id)),
+  prev_pid_(sched_switch.field("prev_pid")), prev_state_(sched_switch.field("prev_state")),
+  next_pid_(sched_switch.field("next_pid")), wakeup_pid_(sched_wakeup.field("pid")),
+  migrate_pid_(sched_migrate_task.field("pid")), queue_(options.reorder_window),
+  states_(options.max_threads),
+  run_queue_latency_(options.precision)
+{
+    off_cpu_time_.fill(LatencyHistogram(options.precision));
+}
+
+void SchedLatencyAnalyzer::prepare(EventAttr& attr, bool stacks)
+{
+    attr.sample_period(1);
+    attr.set_sample_type(PERF_SAMPLE_RAW | PERF_SAMPLE_TID | PERF_SAMPLE_TIME);
+    if (stacks)
+    {
+        attr.set_sample_type(PERF_SAMPLE_CALLCHAIN);
+    }
+}
+
+void SchedLatencyAnalyzer::process(const SampleView& sample)
+{
+    const auto type = tracepoint::common_type(sample);
+    Event event{ sample.time, Type::SWITCH, 0, 0, 0, CallTree::root };
+    const auto field = [&](const tracepoint::EventField& f)
+    { return static_cast<std::uint32_t>(f.integer(sample.raw, sample.raw_size).value_or(0)); };
+
+    if (type == switch_type_)
+    {
+        event.pid = field(prev_pid_);
+        event.next_pid = field(next_pid_);
+        event.prev_state = prev_state_.integer(sample.raw, sample.raw_size).value_or(0);
+        // sched_switch is sampled in the context of the thread switching out
+        if (options_.stacks && sample.callchain != nullptr)
+        {
+            if (off_cpu_stacks_.size() < options_.max_stack_nodes)
+            {
+                event.stack = off_cpu_stacks_.add(sample.callchain, sample.callchain_size, 0);
+            }
+            else
+            {
+                counters_.dropped_stacks++;
+            }
+        }
+    }
+    else if (type == wakeup_type_)
+    {
+        event.type = Type::WAKEUP;
+        event.pid = field(wakeup_pid_);
+    }
+    else if (type == migrate_type_)
+    {
+        event.type = Type::MIGRATE;
+        event.pid = field(migrate_pid_);
+    }
+    else
+    {
+        return;
+    }
+
+    queue_.push(event.time, event, [this](const Event& e) { handle(e); });
+}
+
+void SchedLatencyAnalyzer::process(const RecordBatch& records, const RecordLayout& layout)
+{
+    for_each_sample(records, layout, [this](Cpu, const SampleView& sample) { process(sample); });
+}
+
+void SchedLatencyAnalyzer::flush()
+{
+    queue_.flush([this](const Event& e) { handle(e); });
+}
+
+void SchedLatencyAnalyzer::handle(const Event& event)
+{
+    switch (event.type)
+    {
+    case Type::SWITCH:
+        // pid 0 is the idle task of every cpu
+        if (event.pid != 0)
+        {
+            switch_out(event);
+        }
+        if (event.next_pid != 0)
+        {
+            switch_in(event);
+        }
+        break;
+    case Type::WAKEUP:
+        if (event.pid != 0)
+        {
+            auto* state = states_.find(event.pid);
+            if (state == nullptr)
+            {
+                update(event.pid, event.time, ThreadState{ 0, event.time });
+            }
+            else if (state->runnable_since == 0)
+            {
+                // waking a thread that is runnable already does not restart its wait
+                state->runnable_since = event.time;
+            }
+        }
+        break;
+    case Type::MIGRATE:
+        migrations_++;
+        if (auto* thread = stats(event.pid))
+        {
+            thread->migrations++;
+        }
+        break;
+    }
+}
+
+void SchedLatencyAnalyzer::switch_out(const Event& event)
+{
+    ThreadState state;
+    state.off_cpu_since = event.time;
+    state.reason = block_reason(event.prev_state);
+    state.stack = event.stack;
+    // a preempted thread waits in the run queue right away
+    if (state.reason == BlockReason::PREEMPTED)
+    {
+        state.runnable_since = event.time;
+    }
+    update(event.pid, event.time, state);
+}
+
+void SchedLatencyAnalyzer::switch_in(const Event& event)
+{
+    const auto state = states_.take(event.next_pid);
+    if (!state)
+    {
+        return;
+    }
+    auto* thread = stats(event.next_pid);
+
+    if (state->runnable_since != 0 && event.time >= state->runnable_since)
+    {
+        const auto latency = event.time - state->runnable_since;
+        run_queue_latency_.record(latency);
+        if (thread != nullptr)
+        {
+            thread->run_queue_latency.record(latency);
+        }
+    }
+
+    if (state->off_cpu_since != 0 && event.time >= state->off_cpu_since)
+    {
+        const auto off_cpu = event.time - state->off_cpu_since;
+        off_cpu_time_[static_cast<std::size_t>(state->reason)].record(off_cpu);
+        if (thread != nullptr)
+        {
+            thread->off_cpu_time += off_cpu;
+        }
+        if (state->stack != CallTree::root)
+        {
+            off_cpu_stacks_.add_weight(state->stack, off_cpu);
+        }
+    }
+}
+
+void SchedLatencyAnalyzer::update(std::uint32_t tid, std::uint64_t time, const ThreadState& state)
+{
+    // mostly threads that sleep for good, or exited while we were not looking
+    const auto stale = static_cast<std::uint64_t>(options_.stale_after.count());
+    if (!states_.insert_evicting(tid, state, time, stale,
+                                 [](const ThreadState& other)
+                                 { return std::max(other.off_cpu_since, other.runnable_since); }))
+    {
+        counters_.dropped++;
+    }
+}
+
+SchedLatencyAnalyzer::ThreadStats* SchedLatencyAnalyzer::stats(std::uint32_t tid)
+{
+    auto it = threads_.find(tid);
+    if (it != threads_.end())
+    {
+        return &it->second;
+    }
+    if (threads_.size() >= options_.max_tracked_threads)
+    {
+        counters_.untracked++;
+        return nullptr;
+    }
+    return &threads_.emplace(tid, ThreadStats(options_.precision)).first->second;
+}
+
+void SchedLatencyAnalyzer::reset()
+{
+    run_queue_latency_.clear();
+    for (auto& histogram : off_cpu_time_)
+    {
+        histogram.clear();
+    }
+    migrations_ = 0;
+    threads_.clear();
+    // only thread states and queued samples still refer to nodes, keep their
+    // stacks and drop the others
+    CallTree stacks;
+    const auto keep = [&](CallTree::NodeId& stack)
+    {
+        if (stack != CallTree::root)
+        {
+            stack = stacks.import(off_cpu_stacks_, stack);
+        }
+    };
+    states_.for_each([&](std::uint64_t, ThreadState& state) { keep(state.stack); });
+    queue_.for_each([&](Event& event) { keep(event.stack); });
+    off_cpu_stacks_ = std::move(stacks);
+    counters_ = Counters();
+    queue_.reset_late();
+}
+
+} // namespace analysis
+} // namespace perf_cpp
@@ -0,0 +1,260 @@
+/*
+ * This file is part of the perf_cpp library.
+ * Linux Perf C++ bindings
+ *
+ * Copyright (c) 2024,
+ *    Technische Universitaet Dresden, Germany
+ *
+ * perf_cpp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * perf_cpp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with perf_cpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <perf-cpp/analysis/syscall_latency.hpp>
+
+#include <algorithm>
+
+namespace perf_cpp
+{
+
+namespace analysis
+{
+
+namespace
+{
+std::uint64_t process_key(std::int64_t syscall, std::uint32_t pid)
+{
+    return (static_cast<std::uint64_t>(static_cast<std::uint32_t>(syscall)) << 32) | pid;
+}
+
+SyscallLatencyAnalyzer::Row make_row(std::int64_t syscall, std::optional<std::uint32_t> pid,
+                                     const LatencyHistogram& histogram,
+                                     const std::vector<double>& quantiles)
+{
+    SyscallLatencyAnalyzer::Row row{
+        syscall, pid, histogram.count(), histogram.min(), histogram.max(), histogram.mean(), {}
+    };
+    for (auto quantile : quantiles)
+    {
+        row.percentiles.push_back(histogram.percentile(quantile));
+    }
+    return row;
+}
+} // namespace
+
+SyscallLatencyAnalyzer::SyscallLatencyAnalyzer(const tracepoint::TracepointEventAttr& enter,
+                                               const tracepoint::TracepointEventAttr& exit,
+                                               Options options)
+: SyscallLatencyAnalyzer(tracepoint::TracepointFormat(enter), tracepoint::TracepointFormat(exit),
+                         options)
+{
+}
+
+SyscallLatencyAnalyzer::SyscallLatencyAnalyzer(const tracepoint::TracepointFormat& enter,
+                                               const tracepoint::TracepointFormat& exit,
+                                               Options options)
+: options_(options), enter_type_(static_cast<std::uint16_t>(enter.id)),
+  exit_type_(static_cast<std::uint16_t>(exit.id)), enter_id_(enter.field("id")),
+  exit_id_(exit.field("id")), in_flight_(options.max_threads)
+{
+}
+
+void SyscallLatencyAnalyzer::prepare(EventAttr& attr)
+{
+    attr.sample_period(1);
+    attr.set_sample_type(PERF_SAMPLE_RAW | PERF_SAMPLE_TID | PERF_SAMPLE_TIME);
+}
+
+void SyscallLatencyAnalyzer::process(const SampleView& sample)
+{
+    const auto type = tracepoint::common_type(sample);
+    if (type == enter_type_)
+    {
+        if (auto id = enter_id_.integer(sample.raw, sample.raw_size))
+        {
+            enter(sample, static_cast<std::int64_t>(*id));
+        }
+    }
+    else if (type == exit_type_)
+    {
+        if (auto id = exit_id_.integer(sample.raw, sample.raw_size))
+        {
+            exit(sample, static_cast<std::int64_t>(*id));
+        }
+    }
+}
+
+void SyscallLatencyAnalyzer::process(const RecordBatch& records, const RecordLayout& layout)
+{
+    for_each_sample(records, layout, [this](Cpu, const SampleView& sample) { process(sample); });
+}
+
+void SyscallLatencyAnalyzer::enter(const SampleView& sample, std::int64_t syscall)
+{
+    const InFlight entry{ syscall, sample.time, sample.pid };
+    const auto stale = static_cast<std::uint64_t>(options_.stale_after.count());
+    if (!in_flight_.insert_evicting(sample.tid, entry, sample.time, stale,
+                                    [](const InFlight& other) { return other.time; }))
+    {
+        dropped_enters_++;
+    }
+}
+
+void SyscallLatencyAnalyzer::exit(const SampleView& sample, std::int64_t syscall)
+{
+    const auto entry = in_flight_.take(sample.tid);
+    // a different syscall means we missed the exit of the entered one, and
+    // the enter of this one
+    if (!entry || entry->syscall != syscall || sample.time < entry->time)
+    {
+        unmatched_exits_++;
+        return;
+    }
+    const auto latency = sample.time - entry->time;
+
+    if (begin_ == 0)
+    {
+        begin_ = sample.time;
+    }
+    end_ = sample.time;
+
+    auto* all = find_or_add(by_syscall_, static_cast<std::uint64_t>(syscall),
+                            options_.max_syscalls);
+    auto* process =
+        all != nullptr
+            ? find_or_add(by_process_, process_key(syscall, entry->pid), options_.max_processes)
+            : nullptr;
+    if (all != nullptr)
+    {
+        all->record(latency);
+    }
+    if (process != nullptr)
+    {
+        process->record(latency);
+    }
+    else
+    {
+        untracked_++;
+    }
+
+    if (callback_)
+    {
+        if (interval_begin_ == 0)
+        {
+            interval_begin_ = sample.time;
+        }
+        // samples of different cpus can be slightly out of order
+        else if (sample.time > interval_begin_ &&
+                 sample.time - interval_begin_ >= static_cast<std::uint64_t>(interval_.count()))
+        {
+            callback_(report(interval_quantiles_));
+            reset();
+            interval_begin_ = sample.time;
+        }
+    }
+}
+
+LatencyHistogram*
+SyscallLatencyAnalyzer::find_or_add(std::unordered_map<std::uint64_t, LatencyHistogram>& map,
+                                    std::uint64_t key, std::size_t limit)
+{
+    auto it = map.find(key);
+    if (it != map.end())
+    {
+        return &it->second;
+    }
+    if (map.size() >= limit)
+    {
+        return nullptr;
+    }
+    return &map.emplace(key, LatencyHistogram(options_.precision)).first->second;
+}
+
+void SyscallLatencyAnalyzer::report_every(std::chrono::nanoseconds interval,
+                                          std::vector<double> quantiles,
+                                          std::function<void(const Report&)> callback)
+{
+    interval_ = interval;
+    interval_quantiles_ = std::move(quantiles);
+    callback_ = std::move(callback);
+    interval_begin_ = 0;
+}
+
+const LatencyHistogram* SyscallLatencyAnalyzer::histogram(std::int64_t syscall,
+                                                          std::optional<std::uint32_t> pid) const
+{
+    const auto& map = pid ? by_process_ : by_syscall_;
+    const auto key = pid ? process_key(syscall, *pid) : static_cast<std::uint64_t>(syscall);
+    auto it = map.find(key);
+    return it == map.end() ? nullptr : &it->second;
+}
+
+SyscallLatencyAnalyzer::Report
+SyscallLatencyAnalyzer::report(const std::vector<double>& quantiles) const
+{
+    Report report;
+    report.begin = begin_;
+    report.end = end_;
+    report.quantiles = quantiles;
+    report.dropped_enters = dropped_enters_;
+    report.unmatched_exits = unmatched_exits_;
+    report.untracked = untracked_;
+
+    for (const auto& [key, histogram] : by_syscall_)
+    {
+        if (histogram.count() != 0)
+        {
+            report.rows.push_back(
+                make_row(static_cast<std::int64_t>(key), std::nullopt, histogram, quantiles));
+        }
+    }
+    for (const auto& [key, histogram] : by_process_)
+    {
+        if (histogram.count() != 0)
+        {
+            const auto syscall = static_cast<std::int32_t>(key >> 32);
+            report.rows.push_back(make_row(syscall, static_cast<std::uint32_t>(key), histogram,
+                                           quantiles));
+        }
+    }
+
+    std::sort(report.rows.begin(), report.rows.end(),
+              [](const Row& lhs, const Row& rhs)
+              {
+                  if (lhs.syscall != rhs.syscall)
+                  {
+                      return lhs.syscall < rhs.syscall;
+                  }
+                  // nullopt (all processes) sorts first
+                  return lhs.pid < rhs.pid;
+              });
+    return report;
+}
+
+void SyscallLatencyAnalyzer::reset()
+{
+    // the same syscalls usually come again, so keep their histograms
+    // allocated, but make room for new processes
+    for (auto& entry : by_syscall_)
+    {
+        entry.second.clear();
+    }
+    by_process_.clear();
+    begin_ = 0;
+    end_ = 0;
+    dropped_enters_ = 0;
+    unmatched_exits_ = 0;
+    untracked_ = 0;
+}
+
+} // namespace analysis
+} // namespace perf_cpp
@@ -0,0 +1,139 @@
+/*
+ * This file is part of the perf_cpp library.
+ * Linux Perf C++ bindings
+ *
+ * Copyright (c) 2024,
+ *    Technische Universitaet Dresden, Germany
+ *
+ * perf_cpp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * perf_cpp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with perf_cpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <perf-cpp/arena.hpp>
+
+namespace perf_cpp
+{
+
+ChunkPool::~ChunkPool()
+{
+    for (auto* chunk : chunks_)
+    {
+        ::operator delete(chunk);
+    }
+}
+
+std::byte* ChunkPool::acquire()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!chunks_.empty())
+        {
+            auto* chunk = chunks_.back();
+            chunks_.pop_back();
+            return chunk;
+        }
+    }
+    return static_cast<std::byte*>(::operator new(chunk_size_));
+}
+
+void ChunkPool::release(std::byte* chunk)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (chunks_.size() < max_cached_)
+        {
+            chunks_.push_back(chunk);
+            return;
+        }
+    }
+    ::operator delete(chunk);
+}
+
+Arena::Arena(Arena&& other) noexcept
+: chunk_size_(other.chunk_size_), pool_(other.pool_), chunks_(std::move(other.chunks_)),
+  current_(other.current_), pos_(other.pos_), end_(other.end_), large_(std::move(other.large_)),
+  allocated_(other.allocated_)
+{
+    other.chunks_.clear();
+    other.large_.clear();
+    other.current_ = 0;
+    other.pos_ = other.end_ = nullptr;
+    other.allocated_ = 0;
+}
+
+Arena& Arena::operator=(Arena&& other) noexcept
+{
+    if (this != &other)
+    {
+        release();
+        chunk_size_ = other.chunk_size_;
+        pool_ = other.pool_;
+        std::swap(chunks_, other.chunks_);
+        std::swap(large_, other.large_);
+        std::swap(current_, other.current_);
+        std::swap(pos_, other.pos_);
+        std::swap(end_, other.end_);
+        std::swap(allocated_, other.allocated_);
+    }
+    return *this;
+}
+
+void* Arena::allocate_slow(std::size_t bytes, std::size_t align)
+{
+    if (bytes + align > chunk_size_)
+    {
+        // don't waste the rest of the current chunk on an outlier
+        auto* block = ::operator new(bytes + align);
+        large_.push_back(block);
+        allocated_ += bytes;
+        auto pos = (reinterpret_cast<std::uintptr_t>(block) + align - 1) & ~(align - 1);
+        return reinterpret_cast<void*>(pos);
+    }
+
+    if (!chunks_.empty() && current_ + 1 < chunks_.size())
+    {
+        // reuse a chunk from before the last reset()
+        current_++;
+    }
+    else
+    {
+        chunks_.push_back(pool_ != nullptr
+                              ? pool_->acquire()
+                              : static_cast<std::byte*>(::operator new(chunk_size_)));
+        current_ = chunks_.size() - 1;
+    }
+
+    pos_ = chunks_[current_];
+    end_ = pos_ + chunk_size_;
+    return allocate(bytes, align);
+}
+
+void Arena::release()
+{
+    reset();
+    for (auto* chunk : chunks_)
+    {
+        if (pool_ != nullptr)
+        {
+            pool_->release(chunk);
+        }
+        else
+        {
+            ::operator delete(chunk);
+        }
+    }
+    chunks_.clear();
+    pos_ = end_ = nullptr;
+}
+
+} // namespace perf_cpp
@@ -0,0 +1,298 @@
+/*
+ * This file is part of the perf_cpp library.
+ * Linux Perf C++ bindings
+ *
+ * Copyright (c) 2024,
+ *    Technische Universitaet Dresden, Germany
+ *
+ * perf_cpp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * perf_cpp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with perf_cpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <perf-cpp/call_tree.hpp>
+#include <perf-cpp/topology.hpp>
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace perf_cpp
+{
+
+namespace
+{
+constexpr char binary_magic[4] = { 'P', 'C', 'C', 'T' };
+constexpr std::uint32_t binary_version = 1;
+
+std::size_t hash(CallTree::NodeId parent, std::uint64_t ip)
+{
+    // murmur3 finalizer, ips are aligned and clustered, so mix well
+    std::uint64_t h = ip ^ (static_cast<std::uint64_t>(parent) * 0x9e3779b97f4a7c15ull);
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ull;
+    h ^= h >> 33;
+    return h;
+}
+
+template <typename T>
+void write_value(std::ostream& out, T value)
+{
+    out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template <typename T>
+T read_value(std::istream& in)
+{
+    T value;
+    if (!in.read(reinterpret_cast<char*>(&value), sizeof(value)))
+    {
+        throw std::runtime_error("truncated call tree");
+    }
+    return value;
+}
+} // namespace
+
+CallTree::CallTree() : slots_(1024, 0)
+{
+    nodes_.push_back(Node{ 0, root, 0 });
+}
+
+CallTree::NodeId CallTree::intern(NodeId parent, std::uint64_t ip)
+{
+    const std::size_t mask = slots_.size() - 1;
+    for (std::size_t slot = hash(parent, ip) & mask;; slot = (slot + 1) & mask)
+    {
+        const NodeId id = slots_[slot];
+        if (id == 0)
+        {
+            const NodeId res = nodes_.size();
+            nodes_.push_back(Node{ ip, parent, 0 });
+            slots_[slot] = res;
+            // keep the load factor below 1/2, probe sequences stay short
+            if (nodes_.size() * 2 > slots_.size())
+            {
+                grow();
+            }
+            return res;
+        }
+
+        const auto& node = nodes_[id];
+        if (node.ip == ip && node.parent == parent)
+        {
+            return id;
+        }
+    }
+}
+
+void CallTree::grow()
+{
+    std::vector<NodeId> slots(slots_.size() * 2, 0);
+    const std::size_t mask = slots.size() - 1;
+    for (NodeId id = 1; id < nodes_.size(); id++)
+    {
+        std::size_t slot = hash(nodes_[id].parent, nodes_[id].ip) & mask;
+        while (slots[slot] != 0)
+        {
+            slot = (slot + 1) & mask;
+        }
+        slots[slot] = id;
+    }
+    slots_ = std::move(slots);
+}
+
+CallTree::NodeId CallTree::add(const std::uint64_t* callchain, std::size_t size,
+                               std::uint64_t weight)
+{
+    NodeId node = root;
+    // the callchain is innermost first, the tree is built from the outside
+    for (std::size_t i = size; i-- > 0;)
+    {
+        if (callchain[i] >= PERF_CONTEXT_MAX)
+        {
+            continue;
+        }
+        node = intern(node, callchain[i]);
+    }
+    nodes_[node].self += weight;
+    total_weight_ += weight;
+    return node;
+}
+
+CallTree::NodeId CallTree::import(const CallTree& other, NodeId node)
+{
+    std::vector<std::uint64_t> ips;
+    for (; node != root; node = other.nodes_.at(node).parent)
+    {
+        ips.push_back(other.nodes_[node].ip);
+    }
+
+    NodeId res = root;
+    for (auto ip = ips.rbegin(); ip != ips.rend(); ++ip)
+    {
+        res = intern(res, *ip);
+    }
+    return res;
+}
+
+void CallTree::merge(const CallTree& other)
+{
+    // parents come before their children, so the parent is always mapped already
+    std::vector<NodeId> mapping(other.nodes_.size(), root);
+    for (NodeId id = 1; id < other.nodes_.size(); id++)
+    {
+        const auto& node = other.nodes_[id];
+        mapping[id] = intern(mapping[node.parent], node.ip);
+    }
+
+    for (NodeId id = 0; id < other.nodes_.size(); id++)
+    {
+        nodes_[mapping[id]].self += other.nodes_[id].self;
+    }
+    total_weight_ += other.total_weight_;
+}
+
+std::vector<std::uint64_t> CallTree::totals() const
+{
+    std::vector<std::uint64_t> res(nodes_.size());
+    for (NodeId id = nodes_.size(); id-- > 0;)
+    {
+        res[id] += nodes_[id].self;
+        if (id != root)
+        {
+            res[nodes_[id].parent] += res[id];
+        }
+    }
+    return res;
+}
+
+void CallTree::write_folded(std::ostream& out,
+                            const std::function<std::string(std::uint64_t)>& symbolize) const
+{
+    // names are cached per node, every frame is symbolized exactly once
+    std::vector<std::string> names(nodes_.size());
+    auto name = [&](NodeId id) -> const std::string&
+    {
+        if (names[id].empty())
+        {
+            names[id] = symbolize ? symbolize(nodes_[id].ip) : fmt::format("{:#x}", nodes_[id].ip);
+        }
+        return names[id];
+    };
+
+    std::vector<NodeId> stack;
+    std::string line;
+    for (NodeId id = 1; id < nodes_.size(); id++)
+    {
+        if (nodes_[id].self == 0)
+        {
+            continue;
+        }
+
+        stack.clear();
+        for (NodeId node = id; node != root; node = nodes_[node].parent)
+        {
+            stack.push_back(node);
+        }
+
+        line.clear();
+        for (auto it = stack.rbegin(); it != stack.rend(); ++it)
+        {
+            if (!line.empty())
+            {
+                line += ';';
+            }
+            line += name(*it);
+        }
+        out << line << ' ' << nodes_[id].self << '\n';
+    }
+}
+
+void CallTree::write_binary(std::ostream& out) const
+{
+    out.write(binary_magic, sizeof(binary_magic));
+    write_value<std::uint32_t>(out, binary_version);
+    write_value<std::uint64_t>(out, nodes_.size());
+    for (const auto& node : nodes_)
+    {
+        write_value<std::uint32_t>(out, node.parent);
+        write_value<std::uint64_t>(out, node.ip);
+        write_value<std::uint64_t>(out, node.self);
+    }
+}
+
+CallTree CallTree::read_binary(std::istream& in)
+{
+    char magic[sizeof(binary_magic)];
+    if (!in.read(magic, sizeof(magic)) || std::memcmp(magic, binary_magic, sizeof(magic)) != 0 ||
+        read_value<std::uint32_t>(in) != binary_version)
+    {
+        throw std::runtime_error("not a call tree");
+    }
+
+    const auto count = read_value<std::uint64_t>(in);
+    CallTree tree;
+    // node ids of the file to node ids of the tree
+    std::vector<NodeId> mapping;
+    for (std::uint64_t id = 0; id < count; id++)
+    {
+        const auto parent = read_value<std::uint32_t>(in);
+        const auto ip = read_value<std::uint64_t>(in);
+        const auto self = read_value<std::uint64_t>(in);
+
+        NodeId node = root;
+        if (id != 0)
+        {
+            const auto size = tree.nodes_.size();
+            if (parent >= id)
+            {
+                throw std::runtime_error("malformed call tree");
+            }
+            node = tree.intern(mapping[parent], ip);
+            // write_binary() never writes a (parent, ip) pair twice
+            if (tree.nodes_.size() == size)
+            {
+                throw std::runtime_error("malformed call tree");
+            }
+        }
+        mapping.push_back(node);
+        tree.nodes_[node].self += self;
+        tree.total_weight_ += self;
+    }
+    return tree;
+}
+
+CallTreeShards::CallTreeShards()
+{
+    int max_cpu = 0;
+    for (const auto& cpu : Topology::instance().cpus())
+    {
+        max_cpu = std::max(max_cpu, cpu.as_int());
+    }
+    shards_.resize(max_cpu + 1);
+}
+
+CallTree CallTreeShards::merge() const
+{
+    CallTree res;
+    for (const auto& shard : shards_)
+    {
+        res.merge(shard);
+    }
+    return res;
+}
+
+} // namespace perf_cpp
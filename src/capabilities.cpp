@@ -0,0 +1,230 @@
+/*
+ * This file is part of the perf_cpp library.
+ * Linux Perf C++ bindings
+ *
+ * Copyright (c) 2024,
+ *    Technische Universitaet Dresden, Germany
+ *
+ * perf_cpp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * perf_cpp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with perf_cpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <perf-cpp/capabilities.hpp>
+#include <perf-cpp/topology.hpp>
+#include <perf-cpp/util.hpp>
+
+#include <fstream>
+#include <limits>
+#include <string>
+
+extern "C"
+{
+#include <sys/resource.h>
+#include <unistd.h>
+}
+
+namespace perf_cpp
+{
+
+namespace
+{
+// from linux/capability.h, which is not always installed
+constexpr int CAP_IPC_LOCK_BIT = 14;
+constexpr int CAP_SYS_ADMIN_BIT = 21;
+constexpr int CAP_PERFMON_BIT = 38;
+
+std::uint64_t effective_capabilities()
+{
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line))
+    {
+        if (line.find("CapEff:") == 0)
+        {
+            return std::stoull(line.substr(7), nullptr, 16);
+        }
+    }
+    return 0;
+}
+
+std::uint64_t get_rlimit(int resource, std::uint64_t fallback)
+{
+    struct rlimit limit;
+    if (getrlimit(resource, &limit) == -1)
+    {
+        return fallback;
+    }
+    if (limit.rlim_cur == RLIM_INFINITY)
+    {
+        return std::numeric_limits<std::uint64_t>::max();
+    }
+    return limit.rlim_cur;
+}
+
+template <typename T, typename F>
+T sysctl_or(F read, T fallback)
+{
+    try
+    {
+        return read();
+    }
+    catch (const std::exception&)
+    {
+        return fallback;
+    }
+}
+
+std::size_t round_down_pow2(std::size_t value)
+{
+    if (value == 0)
+    {
+        return 0;
+    }
+
+    std::size_t res = 1;
+    while (res <= value / 2)
+    {
+        res *= 2;
+    }
+    return res;
+}
+} // namespace
+
+Capabilities::Capabilities()
+{
+    paranoid_ = sysctl_or<int>(perf_event_paranoid, paranoid_);
+    mlock_kb_ = sysctl_or<std::uint64_t>(perf_event_mlock_kb, mlock_kb_);
+    max_sample_rate_ = sysctl_or<std::uint64_t>(perf_event_max_sample_rate, max_sample_rate_);
+
+    auto caps = effective_capabilities();
+    cap_ipc_lock_ = caps & (1ull << CAP_IPC_LOCK_BIT);
+    cap_sys_admin_ = caps & (1ull << CAP_SYS_ADMIN_BIT);
+    cap_perfmon_ = caps & (1ull << CAP_PERFMON_BIT);
+
+    nofile_limit_ = get_rlimit(RLIMIT_NOFILE, nofile_limit_);
+    memlock_limit_ = get_rlimit(RLIMIT_MEMLOCK, memlock_limit_);
+
+    online_cpus_ = std::max<std::size_t>(Topology::instance().cpus().size(), 1);
+    page_size_ = sysconf(_SC_PAGESIZE);
+}
+
+bool Capabilities::is_permitted(const perf_event_attr& attr, bool cpu_wide) const
+{
+    if (privileged())
+    {
+        return true;
+    }
+
+    if (!any_allowed())
+    {
+        return false;
+    }
+
+    if (!attr.exclude_kernel && !kernel_allowed())
+    {
+        return false;
+    }
+
+    if (cpu_wide && !cpu_wide_allowed())
+    {
+        return false;
+    }
+
+    if (cpu_wide && attr.type == PERF_TYPE_TRACEPOINT && (attr.sample_type & PERF_SAMPLE_RAW) &&
+        !raw_tracepoints_allowed())
+    {
+        return false;
+    }
+
+    return true;
+}
+
+bool Capabilities::is_valid(const perf_event_attr& attr) const
+{
+    // perf_event_open() refuses this with EINVAL, whatever the privileges
+    return !attr.freq || attr.sample_freq <= max_sample_rate_;
+}
+
+bool Capabilities::adjust(perf_event_attr& attr, bool cpu_wide) const
+{
+    if (!kernel_allowed())
+    {
+        attr.exclude_kernel = 1;
+    }
+
+    if (attr.freq && attr.sample_freq > max_sample_rate_)
+    {
+        attr.sample_freq = max_sample_rate_;
+    }
+
+    return is_permitted(attr, cpu_wide);
+}
+
+std::size_t Capabilities::mmap_page_budget() const
+{
+    // Mirrors the accounting in perf_mmap(): perf_event_mlock_kb is granted
+    // per online cpu, whatever exceeds it is charged against RLIMIT_MEMLOCK.
+    // That check is skipped with CAP_IPC_LOCK or perf_event_paranoid == -1.
+    if (cap_ipc_lock_ || paranoid_ < 0 ||
+        memlock_limit_ == std::numeric_limits<std::uint64_t>::max())
+    {
+        return std::numeric_limits<std::size_t>::max();
+    }
+
+    std::size_t mlock_pages = (mlock_kb_ * 1024 / page_size_) * online_cpus_;
+    return mlock_pages + memlock_limit_ / page_size_;
+}
+
+std::size_t Capabilities::max_data_pages(std::size_t buffers) const
+{
+    if (buffers == 0)
+    {
+        return 0;
+    }
+
+    auto budget = mmap_page_budget();
+    if (budget == std::numeric_limits<std::size_t>::max())
+    {
+        // any size is fine, but there is no point in going beyond what
+        // perf itself considers sane for a single buffer
+        budget = buffers * (1 + (std::size_t(1) << 20));
+    }
+
+    auto per_buffer = budget / buffers;
+    if (per_buffer < 2)
+    {
+        return 0;
+    }
+    // one page per buffer is the header
+    return round_down_pow2(per_buffer - 1);
+}
+
+MaxConfiguration Capabilities::max_configuration(std::size_t cpus) const
+{
+    MaxConfiguration config;
+    config.cpu_wide = cpu_wide_allowed();
+    config.kernel = kernel_allowed();
+    config.raw_tracepoints = raw_tracepoints_allowed();
+    config.max_sample_freq = max_sample_rate_;
+
+    // leave some descriptors for stdio and whatever else the application uses
+    constexpr std::uint64_t reserved_fds = 64;
+    cpus = std::max<std::size_t>(cpus, 1);
+    config.events_per_cpu =
+        nofile_limit_ > reserved_fds ? (nofile_limit_ - reserved_fds) / cpus : 0;
+
+    config.data_pages_per_buffer = max_data_pages(cpus);
+    return config;
+}
+
+} // namespace perf_cpp
@@ -0,0 +1,171 @@
+/*
+ * This file is part of the perf_cpp library.
+ * Linux Perf C++ bindings
+ *
+ * Copyright (c) 2024,
+ *    Technische Universitaet Dresden, Germany
+ *
+ * perf_cpp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * perf_cpp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with perf_cpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+namespace perf_cpp
+{
+
+/**
+ * Bounds-checked reader over DWARF data (.debug_line, .eh_frame). Reading
+ * past the end sets failed() and returns zeros, so parsers only have to
+ * check once per unit instead of after every field.
+ */
+class DwarfCursor
+{
+public:
+    DwarfCursor(const std::byte* begin, const std::byte* end) : pos_(begin), end_(end)
+    {
+    }
+
+    template <typename T>
+    T read()
+    {
+        T value{};
+        if (static_cast<std::size_t>(end_ - pos_) < sizeof(T))
+        {
+            failed_ = true;
+            pos_ = end_;
+            return value;
+        }
+        std::memcpy(&value, pos_, sizeof(T));
+        pos_ += sizeof(T);
+        return value;
+    }
+
+    std::uint64_t uleb()
+    {
+        std::uint64_t value = 0;
+        unsigned shift = 0;
+        while (pos_ < end_)
+        {
+            const auto byte = static_cast<std::uint8_t>(*pos_++);
+            if (shift < 64)
+            {
+                value |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+            }
+            shift += 7;
+            if (!(byte & 0x80))
+            {
+                return value;
+            }
+        }
+        failed_ = true;
+        return value;
+    }
+
+    std::int64_t sleb()
+    {
+        std::int64_t value = 0;
+        unsigned shift = 0;
+        while (pos_ < end_)
+        {
+            const auto byte = static_cast<std::uint8_t>(*pos_++);
+            if (shift < 64)
+            {
+                value |= static_cast<std::int64_t>(byte & 0x7f) << shift;
+            }
+            shift += 7;
+            if (!(byte & 0x80))
+            {
+                if (shift < 64 && (byte & 0x40))
+                {
+                    value |= -(static_cast<std::int64_t>(1) << shift);
+                }
+                return value;
+            }
+        }
+        failed_ = true;
+        return value;
+    }
+
+    std::string_view cstr()
+    {
+        const auto* str = reinterpret_cast<const char*>(pos_);
+        const auto len = strnlen(str, end_ - pos_);
+        if (pos_ + len == end_)
+        {
+            failed_ = true;
+            pos_ = end_;
+            return {};
+        }
+        pos_ += len + 1;
+        return std::string_view(str, len);
+    }
+
+    // a section offset, 4 or 8 bytes depending on the DWARF format
+    std::uint64_t offset(bool dwarf64)
+    {
+        return dwarf64 ? read<std::uint64_t>() : read<std::uint32_t>();
+    }
+
+    std::uint64_t address(std::size_t size)
+    {
+        switch (size)
+        {
+        case 4:
+            return read<std::uint32_t>();
+        case 8:
+            return read<std::uint64_t>();
+        default:
+            skip(size);
+            return 0;
+        }
+    }
+
+    void skip(std::uint64_t bytes)
+    {
+        if (static_cast<std::uint64_t>(end_ - pos_) < bytes)
+        {
+            failed_ = true;
+            pos_ = end_;
+            return;
+        }
+        pos_ += bytes;
+    }
+
+    const std::byte* pos() const
+    {
+        return pos_;
+    }
+
+    bool at_end() const
+    {
+        return pos_ >= end_;
+    }
+
+    bool failed() const
+    {
+        return failed_;
+    }
+
+private:
+    const std::byte* pos_;
+    const std::byte* end_;
+    bool failed_ = false;
+};
+
+} // namespace perf_cpp
@@ -0,0 +1,510 @@
+/*
+ * This file is part of the perf_cpp library.
+ * Linux Perf C++ bindings
+ *
+ * Copyright (c) 2024,
+ *    Technische Universitaet Dresden, Germany
+ *
+ * perf_cpp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * perf_cpp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with perf_cpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <perf-cpp/elf_symbols.hpp>
+#include <perf-cpp/error.hpp>
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+#include <stdexcept>
+
+extern "C"
+{
+#include <elf.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+}
+
+namespace perf_cpp
+{
+
+namespace
+{
+// batches smaller than this are resolved with one binary search per address
+constexpr std::size_t min_sorted_batch = 64;
+
+// All accesses to the mapped file go through this, a truncated or corrupt
+// file must not take the profiler down with it.
+template <typename T>
+const T* at(const ElfFile& file, std::uint64_t offset, std::uint64_t count = 1)
+{
+    if (offset > file.size() || count > (file.size() - offset) / sizeof(T))
+    {
+        return nullptr;
+    }
+    return reinterpret_cast<const T*>(file.data() + offset);
+}
+
+const Elf64_Ehdr& elf_header(const ElfFile& file)
+{
+    return *reinterpret_cast<const Elf64_Ehdr*>(file.data());
+}
+
+const Elf64_Shdr* section_headers(const ElfFile& file)
+{
+    const auto& ehdr = elf_header(file);
+    if (ehdr.e_shentsize != sizeof(Elf64_Shdr))
+    {
+        return nullptr;
+    }
+    return at<Elf64_Shdr>(file, ehdr.e_shoff, ehdr.e_shnum);
+}
+
+const Elf64_Phdr* program_headers(const ElfFile& file)
+{
+    const auto& ehdr = elf_header(file);
+    if (ehdr.e_phentsize != sizeof(Elf64_Phdr))
+    {
+        return nullptr;
+    }
+    return at<Elf64_Phdr>(file, ehdr.e_phoff, ehdr.e_phnum);
+}
+
+std::optional<std::string> find_build_id(const ElfFile& file, std::uint64_t offset,
+                                         std::uint64_t size)
+{
+    const auto* begin = at<std::byte>(file, offset, size);
+    if (begin == nullptr)
+    {
+        return std::nullopt;
+    }
+
+    auto align4 = [](std::uint64_t value) { return (value + 3) & ~3ull; };
+
+    std::uint64_t pos = 0;
+    while (pos + sizeof(Elf64_Nhdr) <= size)
+    {
+        Elf64_Nhdr note;
+        std::memcpy(&note, begin + pos, sizeof(note));
+        const auto name_pos = pos + sizeof(note);
+        const auto desc_pos = name_pos + align4(note.n_namesz);
+        if (desc_pos + note.n_descsz > size)
+        {
+            break;
+        }
+
+        if (note.n_type == NT_GNU_BUILD_ID && note.n_namesz == 4 &&
+            std::memcmp(begin + name_pos, "GNU", 4) == 0)
+        {
+            std::string res;
+            for (std::uint64_t i = 0; i < note.n_descsz; i++)
+            {
+                res += fmt::format("{:02x}", static_cast<unsigned>(begin[desc_pos + i]));
+            }
+            return res;
+        }
+        pos = desc_pos + align4(note.n_descsz);
+    }
+    return std::nullopt;
+}
+} // namespace
+
+ElfFile::ElfFile(const std::filesystem::path& path) : path_(path)
+{
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+    {
+        throw_errno();
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) == -1)
+    {
+        auto error = make_system_error();
+        close(fd);
+        throw error;
+    }
+
+    if (static_cast<std::size_t>(st.st_size) < sizeof(Elf64_Ehdr))
+    {
+        close(fd);
+        throw std::runtime_error(fmt::format("{} is not an ELF file", path.string()));
+    }
+
+    void* data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+    {
+        throw_errno();
+    }
+    data_ = static_cast<const std::byte*>(data);
+    size_ = st.st_size;
+
+    const auto& ehdr = elf_header(*this);
+    if (std::memcmp(ehdr.e_ident, ELFMAG, SELFMAG) != 0 || ehdr.e_ident[EI_CLASS] != ELFCLASS64 ||
+        ehdr.e_ident[EI_DATA] != ELFDATA2LSB)
+    {
+        munmap(data, size_);
+        throw std::runtime_error(
+            fmt::format("{} is not a 64-bit little-endian ELF file", path.string()));
+    }
+}
+
+ElfFile::~ElfFile()
+{
+    munmap(const_cast<std::byte*>(data_), size_);
+}
+
+std::uint16_t ElfFile::machine() const
+{
+    return elf_header(*this).e_machine;
+}
+
+std::optional<std::string> ElfFile::build_id() const
+{
+    const auto& ehdr = elf_header(*this);
+
+    if (const auto* sections = section_headers(*this))
+    {
+        for (std::size_t i = 0; i < ehdr.e_shnum; i++)
+        {
+            if (sections[i].sh_type == SHT_NOTE)
+            {
+                if (auto id = find_build_id(*this, sections[i].sh_offset, sections[i].sh_size))
+                {
+                    return id;
+                }
+            }
+        }
+    }
+
+    // files without section headers still have the note in a PT_NOTE segment
+    if (const auto* segments = program_headers(*this))
+    {
+        for (std::size_t i = 0; i < ehdr.e_phnum; i++)
+        {
+            if (segments[i].p_type == PT_NOTE)
+            {
+                if (auto id = find_build_id(*this, segments[i].p_offset, segments[i].p_filesz))
+                {
+                    return id;
+                }
+            }
+        }
+    }
+    return std::nullopt;
+}
+
+std::optional<ElfSection> ElfFile::section(std::string_view name) const
+{
+    const auto& ehdr = elf_header(*this);
+    const auto* sections = section_headers(*this);
+    if (sections == nullptr || ehdr.e_shstrndx >= ehdr.e_shnum)
+    {
+        return std::nullopt;
+    }
+
+    const auto& names = sections[ehdr.e_shstrndx];
+    const auto* strings = at<char>(*this, names.sh_offset, names.sh_size);
+    if (strings == nullptr)
+    {
+        return std::nullopt;
+    }
+
+    for (std::size_t i = 0; i < ehdr.e_shnum; i++)
+    {
+        const auto& section = sections[i];
+        if (section.sh_name >= names.sh_size || section.sh_type == SHT_NOBITS)
+        {
+            continue;
+        }
+
+        const char* section_name = strings + section.sh_name;
+        const auto max_size = names.sh_size - section.sh_name;
+        if (std::string_view(section_name, strnlen(section_name, max_size)) != name)
+        {
+            continue;
+        }
+
+        const auto* data = at<std::byte>(*this, section.sh_offset, section.sh_size);
+        if (data == nullptr)
+        {
+            return std::nullopt;
+        }
+        return ElfSection{ data, section.sh_size, section.sh_flags, section.sh_addr };
+    }
+    return std::nullopt;
+}
+
+SymbolIndex::SymbolIndex(std::shared_ptr<const ElfFile> file)
+: file_(std::move(file)), build_id_(file_->build_id())
+{
+    const auto& ehdr = elf_header(*file_);
+    if (const auto* segments = program_headers(*file_))
+    {
+        for (std::size_t i = 0; i < ehdr.e_phnum; i++)
+        {
+            if (segments[i].p_type == PT_LOAD)
+            {
+                segments_.push_back(
+                    LoadSegment{ segments[i].p_offset, segments[i].p_vaddr, segments[i].p_filesz });
+            }
+        }
+    }
+
+    read_symbols();
+}
+
+void SymbolIndex::read_symbols()
+{
+    const auto& ehdr = elf_header(*file_);
+    const auto* sections = section_headers(*file_);
+    if (sections == nullptr)
+    {
+        return;
+    }
+
+    struct Candidate
+    {
+        ElfSymbol symbol;
+        // end of the containing section, for symbols without a size
+        std::uint64_t section_end;
+        bool global;
+    };
+    std::vector<Candidate> candidates;
+
+    for (std::size_t i = 0; i < ehdr.e_shnum; i++)
+    {
+        const auto& section = sections[i];
+        if ((section.sh_type != SHT_SYMTAB && section.sh_type != SHT_DYNSYM) ||
+            section.sh_entsize != sizeof(Elf64_Sym) || section.sh_link >= ehdr.e_shnum)
+        {
+            continue;
+        }
+
+        const auto& strtab = sections[section.sh_link];
+        const auto* strings = at<char>(*file_, strtab.sh_offset, strtab.sh_size);
+        const auto count = section.sh_size / sizeof(Elf64_Sym);
+        const auto* syms = at<Elf64_Sym>(*file_, section.sh_offset, count);
+        if (strings == nullptr || syms == nullptr)
+        {
+            continue;
+        }
+
+        for (std::size_t s = 0; s < count; s++)
+        {
+            const auto& sym = syms[s];
+            const auto type = ELF64_ST_TYPE(sym.st_info);
+            if ((type != STT_FUNC && type != STT_GNU_IFUNC) || sym.st_shndx == SHN_UNDEF ||
+                sym.st_shndx >= ehdr.e_shnum || sym.st_value == 0 || sym.st_name >= strtab.sh_size)
+            {
+                continue;
+            }
+
+            const char* name = strings + sym.st_name;
+            const auto& containing = sections[sym.st_shndx];
+            candidates.push_back(Candidate{
+                ElfSymbol{ sym.st_value, sym.st_value + sym.st_size,
+                           std::string_view(name, strnlen(name, strtab.sh_size - sym.st_name)) },
+                containing.sh_addr + containing.sh_size,
+                ELF64_ST_BIND(sym.st_info) != STB_LOCAL });
+        }
+    }
+
+    // .symtab and .dynsym overlap, and aliases share an address: keep the
+    // biggest, then global symbol for every address
+    std::sort(candidates.begin(), candidates.end(),
+              [](const Candidate& a, const Candidate& b)
+              {
+                  if (a.symbol.start != b.symbol.start)
+                  {
+                      return a.symbol.start < b.symbol.start;
+                  }
+                  if (a.symbol.end != b.symbol.end)
+                  {
+                      return a.symbol.end > b.symbol.end;
+                  }
+                  return a.global > b.global;
+              });
+
+    symbols_.reserve(candidates.size());
+    for (std::size_t i = 0; i < candidates.size(); i++)
+    {
+        if (!symbols_.empty() && symbols_.back().start == candidates[i].symbol.start)
+        {
+            continue;
+        }
+
+        auto symbol = candidates[i].symbol;
+        if (symbol.end == symbol.start)
+        {
+            // like perf, let symbols without a size (mostly assembly) extend
+            // up to the next symbol
+            symbol.end = candidates[i].section_end;
+            for (std::size_t next = i + 1; next < candidates.size(); next++)
+            {
+                if (candidates[next].symbol.start != symbol.start)
+                {
+                    symbol.end = std::min(symbol.end, candidates[next].symbol.start);
+                    break;
+                }
+            }
+        }
+        symbols_.push_back(symbol);
+    }
+
+    starts_.reserve(symbols_.size());
+    for (const auto& symbol : symbols_)
+    {
+        starts_.push_back(symbol.start);
+    }
+}
+
+const ElfSymbol* SymbolIndex::lookup(std::uint64_t address) const
+{
+    auto it = std::upper_bound(starts_.begin(), starts_.end(), address);
+    if (it == starts_.begin())
+    {
+        return nullptr;
+    }
+
+    const auto& symbol = symbols_[std::distance(starts_.begin(), it) - 1];
+    return address < symbol.end ? &symbol : nullptr;
+}
+
+void SymbolIndex::lookup(const std::uint64_t* addresses, std::size_t count,
+                         const ElfSymbol** result) const
+{
+    if (count < min_sorted_batch)
+    {
+        for (std::size_t i = 0; i < count; i++)
+        {
+            result[i] = lookup(addresses[i]);
+        }
+        return;
+    }
+
+    std::vector<std::uint32_t> order(count);
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(),
+              [addresses](std::uint32_t a, std::uint32_t b)
+              { return addresses[a] < addresses[b]; });
+
+    // one forward pass over the symbols for the whole batch
+    std::size_t symbol = 0;
+    for (auto i : order)
+    {
+        const auto address = addresses[i];
+        while (symbol < starts_.size() && starts_[symbol] <= address)
+        {
+            symbol++;
+        }
+
+        result[i] = (symbol > 0 && address < symbols_[symbol - 1].end) ? &symbols_[symbol - 1]
+                                                                        : nullptr;
+    }
+}
+
+std::optional<std::uint64_t> SymbolIndex::file_address(std::uint64_t address,
+                                                       std::uint64_t map_start,
+                                                       std::uint64_t map_pgoff) const
+{
+    if (address < map_start)
+    {
+        return std::nullopt;
+    }
+
+    const auto offset = address - map_start + map_pgoff;
+    for (const auto& segment : segments_)
+    {
+        if (offset >= segment.offset && offset < segment.offset + segment.filesz)
+        {
+            return offset - segment.offset + segment.vaddr;
+        }
+    }
+    return std::nullopt;
+}
+
+std::optional<FileId> FileId::of(const std::filesystem::path& path)
+{
+    struct stat st;
+    if (stat(path.c_str(), &st) == -1)
+    {
+        return std::nullopt;
+    }
+    return FileId{ st.st_dev, st.st_ino, st.st_mtim.tv_sec };
+}
+
+std::shared_ptr<const SymbolIndex> SymbolCache::get(const std::filesystem::path& path)
+{
+    const auto id = FileId::of(path);
+    if (!id)
+    {
+        return nullptr;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = by_path_.find(path);
+        if (it != by_path_.end() && it->second.first == *id)
+        {
+            return it->second.second;
+        }
+    }
+
+    // parse without holding the lock, other files can be resolved meanwhile
+    std::shared_ptr<const ElfFile> file;
+    try
+    {
+        file = std::make_shared<const ElfFile>(path);
+    }
+    catch (const std::exception&)
+    {
+        return nullptr;
+    }
+
+    auto build_id = file->build_id();
+    if (build_id)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = by_build_id_.find(*build_id);
+        if (it != by_build_id_.end())
+        {
+            by_path_[path] = { *id, it->second };
+            return it->second;
+        }
+    }
+
+    auto index = std::make_shared<const SymbolIndex>(file);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (build_id)
+    {
+        // another thread may have won the race, use its index
+        index = by_build_id_.emplace(*build_id, index).first->second;
+    }
+    by_path_[path] = { *id, index };
+    return index;
+}
+
+void SymbolCache::clear()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    by_path_.clear();
+    by_build_id_.clear();
+}
+
+} // namespace perf_cpp
@@ -20,6 +20,7 @@
  */
 
 #include <perf-cpp/build_config.hpp>
+#include <perf-cpp/capabilities.hpp>
 #include <perf-cpp/event_attr.hpp>
 #include <perf-cpp/event_resolver.hpp>
 
@@ -44,20 +45,117 @@ std::set<Cpu> get_cpu_set_for(EventAttr ev)
 {
     std::set<Cpu> cpus = std::set<Cpu>();
 
+    // don't probe every cpu if the kernel is going to refuse all of them
+    if (!Capabilities::instance().adjust(ev.attr(), true))
+    {
+        return cpus;
+    }
+
+    OpenError error;
     for (const auto& cpu : Topology::instance().cpus())
     {
-        try
+        if (ev.try_open(cpu, error, -1).has_value())
         {
-            EventGuard ev_instance = ev.open(cpu, -1);
-
             cpus.emplace(cpu);
         }
-        catch (const std::system_error& e)
+    }
+
+    return cpus;
+}
+
+OpenError::OpenError(int errnum, const perf_event_attr& attr, std::variant<Cpu, Thread> location)
+: errnum_(errnum)
+{
+    switch (errnum)
+    {
+    case 0:
+        reason_ = Reason::NONE;
+        break;
+    case EACCES:
+    case EPERM:
+        // reached from the noexcept try_open(), so reading the capabilities
+        // must not throw out of here
+        try
+        {
+            const auto& caps = Capabilities::instance();
+            if (!caps.is_permitted(attr, std::holds_alternative<Cpu>(location)))
+            {
+                reason_ = Reason::PARANOID;
+            }
+            else if (!caps.privileged())
+            {
+                reason_ = Reason::MISSING_CAPABILITY;
+            }
+            else
+            {
+                // privileged and still refused, e.g. by a security module
+                reason_ = Reason::OTHER;
+            }
+        }
+        catch (const std::exception&)
         {
+            reason_ = Reason::OTHER;
         }
+        break;
+    case EBUSY:
+        reason_ = Reason::PMU_BUSY;
+        break;
+    case EOPNOTSUPP:
+        reason_ = Reason::NOT_SUPPORTED;
+        break;
+    case ENOENT:
+    case ENODEV:
+    case ESRCH:
+        reason_ = Reason::NO_SUCH_EVENT;
+        break;
+    case EINVAL:
+    case E2BIG:
+        reason_ = Reason::INVALID_ARGUMENT;
+        break;
+    case EMFILE:
+    case ENFILE:
+        reason_ = Reason::TOO_MANY_FILES;
+        break;
+    default:
+        reason_ = Reason::OTHER;
+        break;
     }
+}
 
-    return cpus;
+std::string OpenError::message() const
+{
+    std::string reason;
+    switch (reason_)
+    {
+    case Reason::NONE:
+        return "no error";
+    case Reason::PARANOID:
+        reason = fmt::format("forbidden by perf_event_paranoid={}",
+                             Capabilities::instance().paranoid());
+        break;
+    case Reason::MISSING_CAPABILITY:
+        reason = "missing CAP_PERFMON or CAP_SYS_ADMIN";
+        break;
+    case Reason::PMU_BUSY:
+        reason = "PMU busy";
+        break;
+    case Reason::NOT_SUPPORTED:
+        reason = "not supported by the PMU";
+        break;
+    case Reason::NO_SUCH_EVENT:
+        reason = "no such event, cpu or thread";
+        break;
+    case Reason::INVALID_ARGUMENT:
+        reason = "invalid event configuration";
+        break;
+    case Reason::TOO_MANY_FILES:
+        reason = "too many open files";
+        break;
+    case Reason::OTHER:
+        reason = "unknown reason";
+        break;
+    }
+    return fmt::format("{} ({})", reason, code().message());
 }
 
 template <typename T>
@@ -204,56 +302,68 @@ const std::set<Cpu>& EventAttr::supported_cpus() const
 
 bool EventAttr::event_is_openable()
 {
+    // set exclude_kernel etc. up front instead of finding out by a failing open
+    Capabilities::instance().adjust(attr_, false);
+
     update_availability();
 
-    if (availability_ == Availability::UNAVAILABLE)
+    // the profile can't predict everything, so retry without kernel after
+    // a permission problem or a PMU that never counts in the kernel (which
+    // fails with EINVAL or EOPNOTSUPP)
+    auto reason = unavailability_reason_.reason();
+    if (availability_ == Availability::UNAVAILABLE && !attr_.exclude_kernel &&
+        (reason == OpenError::Reason::PARANOID ||
+         reason == OpenError::Reason::MISSING_CAPABILITY ||
+         reason == OpenError::Reason::INVALID_ARGUMENT ||
+         reason == OpenError::Reason::NOT_SUPPORTED))
     {
         attr_.exclude_kernel = 1;
         update_availability();
+    }
 
-        if (availability_ == Availability::UNAVAILABLE)
-        {
-            throw EventAttr::InvalidEvent("not available!");
+    if (availability_ == Availability::UNAVAILABLE)
+    {
+        throw EventAttr::InvalidEvent("not available: " + unavailability_reason_.message());
 
-            return false;
-        }
+        return false;
     }
     return true;
 }
 
 void EventAttr::update_availability()
 {
+    const auto& caps = Capabilities::instance();
+
+    OpenError proc_error;
     bool proc = false;
-    bool system = false;
-    try
+    if (!caps.is_valid(attr_))
     {
-        EventGuard proc_ev = open(Thread(0));
-
-        if (proc_ev.get_fd() != -1)
-        {
-            proc = true;
-        }
+        // an invalid configuration, not a permission problem
+        proc_error = OpenError(EINVAL, attr_, Thread(0));
     }
-    catch (const std::system_error& e)
+    else if (caps.is_permitted(attr_, false))
     {
+        proc = try_open(Thread(0), proc_error).has_value();
     }
-
-    try
+    else
     {
-        EventGuard sys_ev = open(*supported_cpus().begin());
-
-        if (sys_ev.get_fd() != -1)
-        {
-            system = true;
-        }
+        proc_error = OpenError(EACCES, attr_, Thread(0));
     }
-    catch (const std::system_error& e)
+
+    OpenError sys_error;
+    bool system = false;
+    if (!supported_cpus().empty() && caps.is_valid(attr_) && caps.is_permitted(attr_, true))
     {
+        system = try_open(*supported_cpus().begin(), sys_error).has_value();
     }
 
+    unavailability_reason_ = OpenError();
     if (proc == false && system == false)
     {
         availability_ = Availability::UNAVAILABLE;
+        // the process-mode error is the more interesting one, system mode is
+        // expected to fail for unprivileged users.
+        unavailability_reason_ = proc_error ? proc_error : sys_error;
     }
     else if (proc == true && system == false)
     {
@@ -345,7 +455,10 @@ std::ostream& operator<<(std::ostream& stream, const EventAttr& event)
         { PERF_FORMAT_TOTAL_TIME_ENABLED, "PERF_FORMAT_TOTAL_TIME_ENABLED" },
         { PERF_FORMAT_TOTAL_TIME_RUNNING, "PERF_FORMAT_TOTAL_TIME_RUNNING" },
         { PERF_FORMAT_ID, "PERF_FORMAT_ID" },
-        { PERF_FORMAT_GROUP, "PERF_FORMAT_GROUP" }
+        { PERF_FORMAT_GROUP, "PERF_FORMAT_GROUP" },
+#ifdef HAVE_PERF_FORMAT_LOST
+        { PERF_FORMAT_LOST, "PERF_FORMAT_LOST" },
+#endif
     };
 
     print_bits(stream, "read_format", read_format, event.attr_.read_format);
@@ -665,6 +778,12 @@ EventGuard EventAttr::open(std::variant<Cpu, Thread> location, int cgroup_fd)
     return EventGuard(*this, location, -1, cgroup_fd);
 }
 
+std::optional<EventGuard> EventAttr::try_open(std::variant<Cpu, Thread> location,
+                                              OpenError& error, int cgroup_fd) noexcept
+{
+    return EventGuard::try_open(*this, location, -1, cgroup_fd, error);
+}
+
 EventGuard EventAttr::open_as_group_leader(std::variant<Cpu, Thread> location, int cgroup_fd)
 {
     attr_.read_format |= PERF_FORMAT_GROUP;
@@ -679,9 +798,39 @@ EventGuard EventGuard::open_child(EventAttr& child, std::variant<Cpu, Thread> lo
     return EventGuard(child, location, fd_, cgroup_fd);
 }
 
+std::optional<EventGuard> EventGuard::try_open_child(EventAttr& child,
+                                                    std::variant<Cpu, Thread> location,
+                                                    OpenError& error, int cgroup_fd) noexcept
+{
+    return try_open(child, location, fd_, cgroup_fd, error);
+}
+
+std::optional<EventGuard> EventGuard::try_open(EventAttr& ev, std::variant<Cpu, Thread> location,
+                                               int group_fd, int cgroup_fd,
+                                               OpenError& error) noexcept
+{
+    int fd = perf_event_open(&ev.attr(), location, group_fd, 0, cgroup_fd);
+
+    if (fd < 0)
+    {
+        error = OpenError(errno, ev.attr(), location);
+        return std::nullopt;
+    }
+
+    if (fcntl(fd, F_SETFL, O_NONBLOCK))
+    {
+        error = OpenError(errno, ev.attr(), location);
+        close(fd);
+        return std::nullopt;
+    }
+
+    error = OpenError();
+    return EventGuard(fd, ev.attr().read_format);
+}
+
 EventGuard::EventGuard(EventAttr& ev, std::variant<Cpu, Thread> location, int group_fd,
                        int cgroup_fd)
-: fd_(-1)
+: fd_(-1), read_format_(ev.attr().read_format)
 {
 
     fd_ = perf_event_open(&ev.attr(), location, group_fd, 0, cgroup_fd);
@@ -721,6 +870,14 @@ void EventGuard::set_output(const EventGuard& other_ev)
     }
 }
 
+void EventGuard::set_period(std::uint64_t period)
+{
+    if (ioctl(fd_, PERF_EVENT_IOC_PERIOD, &period) == -1)
+    {
+        throw_errno();
+    }
+}
+
 void EventGuard::set_syscall_filter(const std::vector<int64_t>& syscall_filter)
 {
     if (syscall_filter.empty())
@@ -731,8 +888,11 @@ void EventGuard::set_syscall_filter(const std::vector<int64_t>& syscall_filter)
     std::vector<std::string> names;
     std::transform(syscall_filter.cbegin(), syscall_filter.end(), std::back_inserter(names),
                    [](const auto& elem) { return fmt::format("id == {}", elem); });
-    std::string filter = fmt::format("{}", fmt::join(names, "||"));
+    set_filter(fmt::format("{}", fmt::join(names, "||")));
+}
 
+void EventGuard::set_filter(const std::string& filter)
+{
     if (ioctl(fd_, PERF_EVENT_IOC_SET_FILTER, filter.c_str()) == -1)
     {
         throw_errno();
@@ -0,0 +1,208 @@
+/*
+ * This file is part of the perf_cpp library.
+ * Linux Perf C++ bindings
+ *
+ * Copyright (c) 2024,
+ *    Technische Universitaet Dresden, Germany
+ *
+ * perf_cpp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * perf_cpp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with perf_cpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <perf-cpp/event_group_set.hpp>
+#include <perf-cpp/topology.hpp>
+
+#include <atomic>
+#include <exception>
+#include <map>
+#include <thread>
+
+extern "C"
+{
+#include <sys/ioctl.h>
+}
+
+namespace perf_cpp
+{
+
+namespace
+{
+// Opens the groups for the given cpus. Gives up early if another worker
+// already failed, as everything is going to be rolled back anyway.
+std::vector<CpuEventGroup> open_groups(EventAttr leader, std::vector<EventAttr> members,
+                                       const std::vector<Cpu>& cpus, int cgroup_fd,
+                                       const std::atomic<bool>& failed)
+{
+    // The leader is the only one that has to be disabled, children are
+    // scheduled together with their leader.
+    leader.set_disabled();
+
+    std::vector<CpuEventGroup> groups;
+    groups.reserve(cpus.size());
+
+    for (const auto& cpu : cpus)
+    {
+        if (failed.load(std::memory_order_relaxed))
+        {
+            break;
+        }
+
+        auto& group = groups.emplace_back(cpu, leader.open_as_group_leader(cpu, cgroup_fd));
+        group.members.reserve(members.size());
+        for (auto& member : members)
+        {
+            group.members.emplace_back(group.leader.open_child(member, cpu, cgroup_fd));
+        }
+    }
+    return groups;
+}
+} // namespace
+
+EventGroupSet EventGroupSet::open(const EventAttr& leader, const std::vector<EventAttr>& members,
+                                  const std::set<Cpu>& cpus, Parallelism parallelism,
+                                  int cgroup_fd)
+{
+    std::atomic<bool> failed = false;
+
+    if (parallelism == Parallelism::SERIAL)
+    {
+        return EventGroupSet(
+            open_groups(leader, members, std::vector<Cpu>(cpus.begin(), cpus.end()), cgroup_fd,
+                        failed));
+    }
+
+    std::map<int, std::vector<Cpu>> cpus_per_worker;
+    for (const auto& cpu : cpus)
+    {
+        const auto& topology = Topology::instance();
+        const int worker = parallelism == Parallelism::PER_PACKAGE
+                               ? topology.package_of(cpu).as_int()
+                               : topology.numa_node_of(cpu).as_int();
+        cpus_per_worker[worker].emplace_back(cpu);
+    }
+
+    struct Worker
+    {
+        std::vector<CpuEventGroup> groups;
+        std::exception_ptr error;
+    };
+
+    std::vector<Worker> workers(cpus_per_worker.size());
+    std::vector<std::thread> threads;
+    threads.reserve(cpus_per_worker.size());
+
+    auto worker_it = workers.begin();
+    for (const auto& worker_cpus : cpus_per_worker)
+    {
+        threads.emplace_back(
+            [&, &worker = *worker_it, &worker_cpus = worker_cpus.second]()
+            {
+                try
+                {
+                    worker.groups = open_groups(leader, members, worker_cpus, cgroup_fd, failed);
+                }
+                catch (...)
+                {
+                    failed = true;
+                    worker.error = std::current_exception();
+                }
+            });
+        ++worker_it;
+    }
+
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    std::vector<CpuEventGroup> groups;
+    groups.reserve(cpus.size());
+    for (auto& worker : workers)
+    {
+        if (worker.error)
+        {
+            // the EventGuards in all workers close their fds on the way out
+            std::rethrow_exception(worker.error);
+        }
+        std::move(worker.groups.begin(), worker.groups.end(), std::back_inserter(groups));
+    }
+    return EventGroupSet(std::move(groups));
+}
+
+EventGroupSet::EventGroupSet(std::vector<CpuEventGroup>&& groups) : groups_(std::move(groups))
+{
+    leader_fds_.reserve(groups_.size());
+    for (const auto& group : groups_)
+    {
+        leader_fds_.push_back(group.leader.get_fd());
+    }
+}
+
+void EventGroupSet::enable()
+{
+    // Keep this loop free of anything but the ioctl, the time between the
+    // first and the last iteration is the start skew between the cpus.
+    auto it = leader_fds_.begin();
+    for (; it != leader_fds_.end(); ++it)
+    {
+        if (ioctl(*it, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP) == -1)
+        {
+            break;
+        }
+    }
+
+    if (it != leader_fds_.end())
+    {
+        auto error = make_system_error();
+        for (auto enabled = leader_fds_.begin(); enabled != it; ++enabled)
+        {
+            ioctl(*enabled, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+        }
+        throw error;
+    }
+    enabled_ = true;
+}
+
+void EventGroupSet::disable()
+{
+    bool failed = false;
+    int error = 0;
+    for (auto fd : leader_fds_)
+    {
+        // try to disable everything, even if a single ioctl failed
+        if (ioctl(fd, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP) == -1 && !failed)
+        {
+            failed = true;
+            error = errno;
+        }
+    }
+    enabled_ = false;
+
+    if (failed)
+    {
+        throw std::system_error(error, std::system_category());
+    }
+}
+
+EventGroupSet::~EventGroupSet()
+{
+    if (enabled_)
+    {
+        for (auto fd : leader_fds_)
+        {
+            ioctl(fd, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+        }
+    }
+}
+
+} // namespace perf_cpp
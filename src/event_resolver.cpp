@@ -25,6 +25,7 @@
 #endif
 #include <perf-cpp/event_resolver.hpp>
 #include <perf-cpp/topology.hpp>
+#include <perf-cpp/tracepoint/tracefs.hpp>
 #include <perf-cpp/util.hpp>
 
 #include <filesystem>
@@ -144,27 +145,7 @@ std::vector<SysfsEventAttr> EventResolver::get_pmu_events()
 
 std::vector<std::string> EventResolver::get_tracepoint_event_names()
 {
-    try
-    {
-        std::ifstream ifs_available_events;
-        ifs_available_events.exceptions(std::ios::failbit | std::ios::badbit);
-
-        ifs_available_events.open("/sys/kernel/debug/tracing/available_events");
-        ifs_available_events.exceptions(std::ios::badbit);
-
-        std::vector<std::string> available;
-
-        for (std::string tracepoint; std::getline(ifs_available_events, tracepoint);)
-        {
-            available.emplace_back(std::move(tracepoint));
-        }
-
-        return available;
-    }
-    catch (const std::ios_base::failure& e)
-    {
-        return {};
-    }
+    return tracepoint::TracepointCatalog::instance().match("*:*");
 }
 
 EventResolver::EventResolver()
@@ -0,0 +1,230 @@
+/*
+ * This file is part of the perf_cpp library.
+ * Linux Perf C++ bindings
+ *
+ * Copyright (c) 2024,
+ *    Technische Universitaet Dresden, Germany
+ *
+ * perf_cpp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * perf_cpp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with perf_cpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <perf-cpp/error.hpp>
+#include <perf-cpp/flight_recorder.hpp>
+
+#include <algorithm>
+#include <limits>
+
+extern "C"
+{
+#include <signal.h>
+#include <sys/ioctl.h>
+}
+
+namespace perf_cpp
+{
+
+std::atomic<FlightRecorder*> FlightRecorder::armed_ = nullptr;
+
+FlightRecorder::FlightRecorder(const EventAttr& ev, const std::set<Cpu>& cpus,
+                               std::size_t data_pages, int cgroup_fd)
+{
+    EventAttr recorder_ev = ev;
+    recorder_ev.attr().write_backward = 1;
+    recorder_ev.set_sample_type(PERF_SAMPLE_TIME);
+    recorder_ev.set_sample_id_all();
+    layout_ = RecordLayout(recorder_ev.attr());
+
+    recorders_.reserve(cpus.size());
+    for (const auto& cpu : cpus)
+    {
+        EventGuard guard = recorder_ev.open(cpu, cgroup_fd);
+        RingBuffer buffer(guard, data_pages, RingBuffer::Mode::OVERWRITE);
+        fds_.push_back(guard.get_fd());
+        recorders_.push_back(CpuRecorder{ cpu, std::move(guard), std::move(buffer) });
+    }
+}
+
+FlightRecorder::~FlightRecorder()
+{
+    disarm_signal();
+}
+
+void FlightRecorder::pause()
+{
+    for (auto fd : fds_)
+    {
+        if (ioctl(fd, PERF_EVENT_IOC_PAUSE_OUTPUT, 1) == -1)
+        {
+            throw_errno();
+        }
+    }
+}
+
+void FlightRecorder::resume()
+{
+    for (auto fd : fds_)
+    {
+        if (ioctl(fd, PERF_EVENT_IOC_PAUSE_OUTPUT, 0) == -1)
+        {
+            throw_errno();
+        }
+    }
+}
+
+std::vector<RecordSnapshot> FlightRecorder::snapshot(std::chrono::nanoseconds window)
+{
+    // position and size of a record in the ring buffer
+    struct RecordRef
+    {
+        std::uint64_t pos;
+        std::uint16_t size;
+        std::optional<std::uint64_t> time;
+    };
+
+    pause();
+
+    std::vector<std::vector<RecordRef>> found(recorders_.size());
+    std::uint64_t newest = 0;
+
+    for (std::size_t i = 0; i < recorders_.size(); i++)
+    {
+        auto& buffer = recorders_[i].buffer;
+        // nothing consumes an overwritten buffer, so poll its loss here
+        buffer.update_format_lost();
+
+        // With write_backward, data_head moves down from 0, so the newest
+        // record is at data_head and older ones follow at higher positions.
+        // Records are valid up to one buffer size after data_head, or up to
+        // position 0 if the buffer has not wrapped yet.
+        const auto head = buffer.head();
+        const auto end = head + std::min<std::uint64_t>(-head, buffer.size());
+
+        std::vector<std::byte> record_buf(std::numeric_limits<std::uint16_t>::max());
+        auto* record = reinterpret_cast<const perf_event_header*>(record_buf.data());
+
+        for (auto pos = head; pos + sizeof(perf_event_header) <= end;)
+        {
+            buffer.copy_out(pos, sizeof(perf_event_header), record_buf.data());
+            if (record->size < sizeof(perf_event_header) || pos + record->size > end)
+            {
+                // never written, or the oldest record is partially overwritten
+                break;
+            }
+            buffer.copy_out(pos, record->size, record_buf.data());
+
+            auto time = record_time(record, layout_);
+            if (time && *time > newest)
+            {
+                newest = *time;
+            }
+            found[i].push_back(RecordRef{ pos, record->size, time });
+            pos += record->size;
+        }
+    }
+
+    const std::uint64_t window_ns = window.count();
+    const std::uint64_t cutoff = newest > window_ns ? newest - window_ns : 0;
+
+    std::vector<RecordSnapshot> snapshots;
+    snapshots.reserve(recorders_.size());
+    for (std::size_t i = 0; i < recorders_.size(); i++)
+    {
+        auto& snap = snapshots.emplace_back(recorders_[i].cpu);
+        auto& refs = found[i];
+
+        // refs are newest first, drop everything past the window
+        auto last = std::find_if(refs.begin(), refs.end(), [cutoff](const auto& ref)
+                                 { return ref.time && *ref.time < cutoff; });
+        refs.erase(last, refs.end());
+
+        std::size_t total = 0;
+        for (const auto& ref : refs)
+        {
+            total += ref.size;
+        }
+        snap.data.resize(total);
+
+        auto* dest = snap.data.data();
+        for (auto ref = refs.rbegin(); ref != refs.rend(); ++ref)
+        {
+            recorders_[i].buffer.copy_out(ref->pos, ref->size, dest);
+            dest += ref->size;
+        }
+    }
+
+    triggered_.store(false, std::memory_order_release);
+    resume();
+
+    return snapshots;
+}
+
+void FlightRecorder::signal_handler(int)
+{
+    // only async-signal-safe things in here: ioctl() and lock-free atomics
+    FlightRecorder* recorder = armed_.load(std::memory_order_acquire);
+    if (recorder == nullptr)
+    {
+        return;
+    }
+
+    for (auto fd : recorder->fds_)
+    {
+        ioctl(fd, PERF_EVENT_IOC_PAUSE_OUTPUT, 1);
+    }
+    recorder->triggered_.store(true, std::memory_order_release);
+}
+
+void FlightRecorder::arm_signal(int signum)
+{
+    FlightRecorder* expected = nullptr;
+    if (!armed_.compare_exchange_strong(expected, this) && expected != this)
+    {
+        throw std::runtime_error("another FlightRecorder is already armed!");
+    }
+    if (armed_signal_ == signum)
+    {
+        return;
+    }
+    if (armed_signal_ != -1)
+    {
+        sigaction(armed_signal_, &previous_action_, nullptr);
+        armed_signal_ = -1;
+    }
+
+    struct sigaction action = {};
+    action.sa_handler = &FlightRecorder::signal_handler;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+
+    if (sigaction(signum, &action, &previous_action_) == -1)
+    {
+        armed_ = nullptr;
+        throw_errno();
+    }
+    armed_signal_ = signum;
+}
+
+void FlightRecorder::disarm_signal()
+{
+    if (armed_signal_ == -1)
+    {
+        return;
+    }
+
+    sigaction(armed_signal_, &previous_action_, nullptr);
+    armed_signal_ = -1;
+    armed_ = nullptr;
+}
+
+} // namespace perf_cpp
@@ -0,0 +1,488 @@
+/*
+ * This file is part of the perf_cpp library.
+ * Linux Perf C++ bindings
+ *
+ * Copyright (c) 2024,
+ *    Technische Universitaet Dresden, Germany
+ *
+ * perf_cpp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * perf_cpp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with perf_cpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <perf-cpp/jit_symbols.hpp>
+
+#include <algorithm>
+#include <cstring>
+
+extern "C"
+{
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+}
+
+namespace perf_cpp
+{
+
+namespace
+{
+// see tools/perf/util/jitdump.h in the kernel tree
+constexpr std::uint32_t jitdump_magic = 0x4A695444;
+
+enum JitRecordType : std::uint32_t
+{
+    JIT_CODE_LOAD = 0,
+    JIT_CODE_MOVE = 1,
+};
+
+struct JitHeader
+{
+    std::uint32_t magic;
+    std::uint32_t version;
+    std::uint32_t total_size;
+    std::uint32_t elf_mach;
+    std::uint32_t pad1;
+    std::uint32_t pid;
+    std::uint64_t timestamp;
+    std::uint64_t flags;
+};
+
+struct JitRecordHeader
+{
+    std::uint32_t id;
+    std::uint32_t total_size;
+    std::uint64_t timestamp;
+};
+
+struct JitCodeLoad
+{
+    std::uint32_t pid;
+    std::uint32_t tid;
+    std::uint64_t vma;
+    std::uint64_t code_addr;
+    std::uint64_t code_size;
+    std::uint64_t code_index;
+    // followed by the name and the code
+};
+
+struct JitCodeMove
+{
+    std::uint32_t pid;
+    std::uint32_t tid;
+    std::uint64_t vma;
+    std::uint64_t old_code_addr;
+    std::uint64_t new_code_addr;
+    std::uint64_t code_size;
+    std::uint64_t code_index;
+};
+
+// size of pid, tid, addr, len, pgoff of MMAP/MMAP2 and of the MMAP2 extension
+constexpr std::size_t mmap_size = 32;
+constexpr std::size_t mmap2_extra_size = 32;
+
+bool is_jitdump(const std::filesystem::path& path)
+{
+    const auto name = path.filename().string();
+    return name.rfind("jit-", 0) == 0 && path.extension() == ".dump";
+}
+
+bool parse_hex(const char*& pos, const char* end, std::uint64_t& value)
+{
+    if (end - pos > 2 && pos[0] == '0' && (pos[1] == 'x' || pos[1] == 'X'))
+    {
+        pos += 2;
+    }
+
+    const char* start = pos;
+    value = 0;
+    for (; pos < end; pos++)
+    {
+        const char c = *pos;
+        if (c >= '0' && c <= '9')
+        {
+            value = (value << 4) | (c - '0');
+        }
+        else if (c >= 'a' && c <= 'f')
+        {
+            value = (value << 4) | (c - 'a' + 10);
+        }
+        else if (c >= 'A' && c <= 'F')
+        {
+            value = (value << 4) | (c - 'A' + 10);
+        }
+        else
+        {
+            break;
+        }
+    }
+    return pos != start;
+}
+} // namespace
+
+void JitSymbols::process(const perf_event_header* record)
+{
+    if (record->type == PERF_RECORD_MMAP || record->type == PERF_RECORD_MMAP2)
+    {
+        const auto offset =
+            mmap_size + (record->type == PERF_RECORD_MMAP2 ? mmap2_extra_size : 0);
+        if (sizeof(*record) + offset >= record->size)
+        {
+            return;
+        }
+
+        std::uint32_t pid;
+        std::memcpy(&pid, record + 1, sizeof(pid));
+        const auto* filename = reinterpret_cast<const char*>(record + 1) + offset;
+        std::filesystem::path path(
+            std::string(filename, strnlen(filename, record->size - sizeof(*record) - offset)));
+
+        if (is_jitdump(path))
+        {
+            auto& process = processes_[pid];
+            add_source(process, std::move(path), true);
+            read_source(process, process.sources.back());
+        }
+    }
+    else if (record->type == PERF_RECORD_EXIT)
+    {
+        struct
+        {
+            std::uint32_t pid;
+            std::uint32_t ppid;
+            std::uint32_t tid;
+            std::uint32_t ptid;
+            std::uint64_t time;
+        } exit;
+
+        if (sizeof(*record) + sizeof(exit) > record->size)
+        {
+            return;
+        }
+        std::memcpy(&exit, record + 1, sizeof(exit));
+
+        auto process = processes_.find(exit.pid);
+        if (exit.pid == exit.tid && process != processes_.end())
+        {
+            // pick up what was written right before the exit, the files
+            // are usually removed afterwards
+            for (auto& source : process->second.sources)
+            {
+                read_source(process->second, source);
+            }
+            process->second.exit_time = exit.time;
+        }
+    }
+}
+
+void JitSymbols::watch(std::uint32_t pid)
+{
+    add_source(processes_[pid], map_dir_ / ("perf-" + std::to_string(pid) + ".map"), false);
+}
+
+void JitSymbols::add_source(Process& process, std::filesystem::path path, bool jitdump)
+{
+    auto it = std::find_if(process.sources.begin(), process.sources.end(),
+                           [&path](const Source& source) { return source.path == path; });
+    if (it == process.sources.end())
+    {
+        process.sources.push_back(Source{ std::move(path), jitdump });
+    }
+    else if (it != std::prev(process.sources.end()))
+    {
+        // callers expect the source at the back
+        std::rotate(it, std::next(it), process.sources.end());
+    }
+}
+
+void JitSymbols::refresh(std::uint32_t pid)
+{
+    auto process = processes_.find(pid);
+    if (process == processes_.end())
+    {
+        return;
+    }
+
+    for (auto& source : process->second.sources)
+    {
+        read_source(process->second, source);
+    }
+}
+
+void JitSymbols::refresh()
+{
+    for (auto& process : processes_)
+    {
+        for (auto& source : process.second.sources)
+        {
+            read_source(process.second, source);
+        }
+    }
+}
+
+void JitSymbols::read_source(Process& process, Source& source)
+{
+    int fd = open(source.path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+    {
+        // not written (yet), or already removed
+        return;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) == -1)
+    {
+        close(fd);
+        return;
+    }
+
+    const std::uint64_t size = st.st_size;
+    if (st.st_ino != source.inode || size < source.offset)
+    {
+        // a new file under the same name, e.g. a recycled pid
+        source.inode = st.st_ino;
+        source.offset = 0;
+    }
+
+    if (size == source.offset)
+    {
+        close(fd);
+        return;
+    }
+
+    std::string data(size - source.offset, '\0');
+    const auto bytes = pread(fd, data.data(), data.size(), source.offset);
+    close(fd);
+    if (bytes <= 0)
+    {
+        return;
+    }
+    data.resize(bytes);
+
+    std::uint64_t consumed = 0;
+    if (source.jitdump)
+    {
+        parse_jitdump(process, data, consumed, source.offset == 0);
+    }
+    else
+    {
+        parse_perf_map(process, data, consumed);
+    }
+    source.offset += consumed;
+}
+
+void JitSymbols::parse_perf_map(Process& process, const std::string& data,
+                                std::uint64_t& consumed)
+{
+    const char* pos = data.data();
+    const char* const end = pos + data.size();
+    while (pos < end)
+    {
+        const char* eol = static_cast<const char*>(std::memchr(pos, '\n', end - pos));
+        if (eol == nullptr)
+        {
+            // still being written
+            break;
+        }
+
+        // "<start> <size> <name>", both numbers in hex
+        const char* cur = pos;
+        pos = eol + 1;
+
+        std::uint64_t start;
+        std::uint64_t size;
+        if (!parse_hex(cur, eol, start) || cur == eol || *cur++ != ' ' ||
+            !parse_hex(cur, eol, size) || cur == eol || *cur++ != ' ')
+        {
+            continue;
+        }
+
+        add_symbol(process, JitSymbol{ start, start + size, std::string(cur, eol) });
+    }
+    consumed = pos - data.data();
+}
+
+void JitSymbols::parse_jitdump(Process& process, const std::string& data,
+                               std::uint64_t& consumed, bool header)
+{
+    std::uint64_t pos = 0;
+    if (header)
+    {
+        JitHeader file_header;
+        if (data.size() < sizeof(file_header))
+        {
+            return;
+        }
+        std::memcpy(&file_header, data.data(), sizeof(file_header));
+        if (file_header.magic != jitdump_magic || file_header.total_size < sizeof(file_header))
+        {
+            // not a jitdump, or written on a machine with the other byte order
+            consumed = data.size();
+            return;
+        }
+        pos = file_header.total_size;
+    }
+
+    while (pos + sizeof(JitRecordHeader) <= data.size())
+    {
+        JitRecordHeader record;
+        std::memcpy(&record, data.data() + pos, sizeof(record));
+        if (record.total_size < sizeof(record))
+        {
+            // corrupt, there is no way to find the next record
+            pos = data.size();
+            break;
+        }
+        if (pos + record.total_size > data.size())
+        {
+            // still being written
+            break;
+        }
+
+        const char* payload = data.data() + pos + sizeof(record);
+        const std::size_t payload_size = record.total_size - sizeof(record);
+
+        if (record.id == JIT_CODE_LOAD && payload_size > sizeof(JitCodeLoad))
+        {
+            JitCodeLoad load;
+            std::memcpy(&load, payload, sizeof(load));
+            const char* name = payload + sizeof(load);
+            add_symbol(process, JitSymbol{ load.code_addr, load.code_addr + load.code_size,
+                                           std::string(name, strnlen(name, payload_size -
+                                                                               sizeof(load))),
+                                           record.timestamp });
+        }
+        else if (record.id == JIT_CODE_MOVE && payload_size >= sizeof(JitCodeMove))
+        {
+            JitCodeMove move;
+            std::memcpy(&move, payload, sizeof(move));
+            auto old = process.live.find(move.old_code_addr);
+            if (old != process.live.end())
+            {
+                // the old range no longer holds the code from now on
+                auto moved = std::move(old->second);
+                process.live.erase(old);
+                auto name = moved.name;
+                moved.to_time = record.timestamp;
+                if (moved.from_time < moved.to_time)
+                {
+                    process.history.push_back(std::move(moved));
+                }
+
+                add_symbol(process, JitSymbol{ move.new_code_addr,
+                                               move.new_code_addr + move.code_size,
+                                               std::move(name), record.timestamp });
+            }
+        }
+        pos += record.total_size;
+    }
+    consumed = pos;
+}
+
+void JitSymbols::add_symbol(Process& process, JitSymbol symbol)
+{
+    auto& live = process.live;
+
+    auto it = live.upper_bound(symbol.start);
+    if (it != live.begin() && std::prev(it)->second.end > symbol.start)
+    {
+        --it;
+    }
+
+    // the code cache reused the memory, whatever was there is gone
+    while (it != live.end() && it->first < symbol.end)
+    {
+        auto old = std::move(it->second);
+        it = live.erase(it);
+
+        old.to_time = symbol.from_time;
+        if (old.from_time < old.to_time)
+        {
+            process.history.push_back(std::move(old));
+        }
+    }
+
+    const auto start = symbol.start;
+    live.emplace(start, std::move(symbol));
+}
+
+const JitSymbol* JitSymbols::lookup(std::uint32_t pid, std::uint64_t address,
+                                    std::optional<std::uint64_t> time) const
+{
+    auto process = processes_.find(pid);
+    if (process == processes_.end())
+    {
+        return nullptr;
+    }
+
+    const auto& live = process->second.live;
+    auto it = live.upper_bound(address);
+    if (it != live.begin())
+    {
+        const auto& symbol = std::prev(it)->second;
+        if (symbol.contains(address) && (!time || symbol.valid_at(*time)))
+        {
+            return &symbol;
+        }
+    }
+
+    if (!time)
+    {
+        return nullptr;
+    }
+
+    const auto& history = process->second.history;
+    for (auto symbol = history.rbegin(); symbol != history.rend(); ++symbol)
+    {
+        if (symbol->contains(address) && symbol->valid_at(*time))
+        {
+            return &*symbol;
+        }
+    }
+    return nullptr;
+}
+
+const JitSymbol* JitSymbols::resolve(std::uint32_t pid, std::uint64_t address,
+                                     std::optional<std::uint64_t> time)
+{
+    if (const auto* symbol = lookup(pid, address, time))
+    {
+        return symbol;
+    }
+
+    watch(pid);
+    refresh(pid);
+    return lookup(pid, address, time);
+}
+
+void JitSymbols::expire(std::uint64_t time)
+{
+    for (auto it = processes_.begin(); it != processes_.end();)
+    {
+        auto& process = it->second;
+        process.history.erase(std::remove_if(process.history.begin(), process.history.end(),
+                                             [time](const JitSymbol& symbol)
+                                             { return symbol.to_time <= time; }),
+                              process.history.end());
+
+        if (process.exit_time && *process.exit_time <= time)
+        {
+            it = processes_.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+
+} // namespace perf_cpp
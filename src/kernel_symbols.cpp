@@ -0,0 +1,325 @@
+/*
+ * This file is part of the perf_cpp library.
+ * Linux Perf C++ bindings
+ *
+ * Copyright (c) 2024,
+ *    Technische Universitaet Dresden, Germany
+ *
+ * perf_cpp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * perf_cpp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with perf_cpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <perf-cpp/error.hpp>
+#include <perf-cpp/kernel_symbols.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+
+extern "C"
+{
+#include <fcntl.h>
+#include <unistd.h>
+}
+
+namespace perf_cpp
+{
+
+namespace
+{
+// the last symbol has no successor to end at
+constexpr std::uint64_t last_symbol_size = 4096;
+
+bool is_text(char type)
+{
+    return type == 't' || type == 'T' || type == 'w' || type == 'W';
+}
+
+bool is_data(char type)
+{
+    switch (type)
+    {
+    case 'd':
+    case 'D':
+    case 'b':
+    case 'B':
+    case 'r':
+    case 'R':
+    case 'v':
+    case 'V':
+        return true;
+    default:
+        return false;
+    }
+}
+
+// parses the hex address at the start of line, stops at the first non-hex char
+std::uint64_t parse_hex(const char*& pos, const char* end)
+{
+    std::uint64_t res = 0;
+    for (; pos < end; pos++)
+    {
+        const char c = *pos;
+        if (c >= '0' && c <= '9')
+        {
+            res = (res << 4) | (c - '0');
+        }
+        else if (c >= 'a' && c <= 'f')
+        {
+            res = (res << 4) | (c - 'a' + 10);
+        }
+        else
+        {
+            break;
+        }
+    }
+    return res;
+}
+
+std::string read_file(const std::filesystem::path& path)
+{
+    // procfs files have no size, read them as a whole instead of line by line
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+    {
+        throw_errno();
+    }
+
+    // seq_file hands out about a page per read(), so don't grow the result per read
+    std::string res;
+    std::vector<char> buffer(1 << 16);
+    ssize_t bytes;
+    while ((bytes = read(fd, buffer.data(), buffer.size())) > 0)
+    {
+        res.append(buffer.data(), bytes);
+    }
+    close(fd);
+    return res;
+}
+
+// Name and size of every module. The other columns of /proc/modules (use
+// counts, state) change all the time and don't matter for the symbols.
+std::string modules_state()
+{
+    std::string modules;
+    try
+    {
+        modules = read_file("/proc/modules");
+    }
+    catch (const std::system_error&)
+    {
+        // a kernel without module support
+        return {};
+    }
+
+    std::string state;
+    const char* pos = modules.data();
+    const char* const end = pos + modules.size();
+    while (pos < end)
+    {
+        const char* eol = static_cast<const char*>(std::memchr(pos, '\n', end - pos));
+        if (eol == nullptr)
+        {
+            eol = end;
+        }
+
+        const char* size_end = pos;
+        for (int column = 0; column < 2 && size_end != nullptr; column++)
+        {
+            size_end =
+                static_cast<const char*>(std::memchr(size_end + 1, ' ', eol - size_end - 1));
+        }
+        state.append(pos, size_end != nullptr ? size_end : eol);
+        state += '\n';
+        pos = eol + 1;
+    }
+    return state;
+}
+} // namespace
+
+KernelSymbols::KernelSymbols(const std::filesystem::path& kallsyms, bool data)
+: path_(kallsyms), data_(data)
+{
+    load();
+}
+
+void KernelSymbols::load()
+{
+    const auto content = read_file(path_);
+
+    names_.clear();
+    modules_.clear();
+    starts_.clear();
+    entries_.clear();
+
+    std::vector<std::uint64_t> starts;
+    std::vector<Entry> entries;
+
+    const char* pos = content.data();
+    const char* const end = pos + content.size();
+    while (pos < end)
+    {
+        const char* eol = static_cast<const char*>(std::memchr(pos, '\n', end - pos));
+        if (eol == nullptr)
+        {
+            eol = end;
+        }
+
+        // "<address> <type> <name>[\t[<module>]]"
+        const char* cur = pos;
+        pos = eol + 1;
+
+        const auto address = parse_hex(cur, eol);
+        if (address == 0 || eol - cur < 4)
+        {
+            continue;
+        }
+        // per-cpu variables are listed by their offset into the per-cpu area,
+        // they would otherwise span up to the kernel image
+        const bool data = data_ && is_data(cur[1]) && (address >> 63) != 0;
+        if (!is_text(cur[1]) && !data)
+        {
+            continue;
+        }
+
+        const char* name = cur + 3;
+        const char* tab = static_cast<const char*>(std::memchr(name, '\t', eol - name));
+        const char* name_end = tab != nullptr ? tab : eol;
+
+        std::uint16_t module = 0;
+        if (tab != nullptr && eol - tab > 3 && tab[1] == '[')
+        {
+            std::string_view module_name(tab + 2, eol - tab - 3);
+            // all symbols of a module are listed in one block
+            if (modules_.empty() || modules_.back() != module_name)
+            {
+                modules_.emplace_back(module_name);
+            }
+            module = modules_.size();
+        }
+
+        starts.push_back(address);
+        entries.push_back(Entry{ 0, static_cast<std::uint32_t>(names_.size()),
+                                 static_cast<std::uint16_t>(name_end - name), module });
+        names_.append(name, name_end);
+    }
+
+    std::vector<std::uint32_t> order(starts.size());
+    std::iota(order.begin(), order.end(), 0);
+    // stable: of several symbols at one address, kallsyms lists the preferred one first
+    std::stable_sort(order.begin(), order.end(),
+                     [&starts](std::uint32_t a, std::uint32_t b) { return starts[a] < starts[b]; });
+
+    starts_.reserve(order.size());
+    entries_.reserve(order.size());
+    for (auto i : order)
+    {
+        if (!starts_.empty() && starts_.back() == starts[i])
+        {
+            continue;
+        }
+        if (!entries_.empty())
+        {
+            entries_.back().end = starts[i];
+        }
+        starts_.push_back(starts[i]);
+        entries_.push_back(entries[i]);
+    }
+    if (!entries_.empty())
+    {
+        entries_.back().end = starts_.back() + last_symbol_size;
+    }
+
+    modules_state_ = modules_state();
+}
+
+bool KernelSymbols::refresh_modules()
+{
+    if (modules_state() == modules_state_)
+    {
+        return false;
+    }
+
+    load();
+    return true;
+}
+
+void KernelSymbols::process(const perf_event_header* record)
+{
+#ifdef PERF_RECORD_KSYMBOL_FLAGS_UNREGISTER
+    if (record->type != PERF_RECORD_KSYMBOL)
+    {
+        return;
+    }
+
+    struct
+    {
+        std::uint64_t addr;
+        std::uint32_t len;
+        std::uint16_t ksym_type;
+        std::uint16_t flags;
+    } ksymbol;
+
+    if (sizeof(*record) + sizeof(ksymbol) > record->size)
+    {
+        return;
+    }
+    std::memcpy(&ksymbol, record + 1, sizeof(ksymbol));
+
+    if (ksymbol.flags & PERF_RECORD_KSYMBOL_FLAGS_UNREGISTER)
+    {
+        dynamic_.erase(ksymbol.addr);
+        return;
+    }
+
+    const auto* name = reinterpret_cast<const char*>(record + 1) + sizeof(ksymbol);
+    const auto max_size = record->size - sizeof(*record) - sizeof(ksymbol);
+    dynamic_[ksymbol.addr] =
+        DynamicSymbol{ ksymbol.addr + ksymbol.len, std::string(name, strnlen(name, max_size)) };
+#else
+    (void)record;
+#endif
+}
+
+std::optional<KernelSymbol> KernelSymbols::lookup(std::uint64_t address) const
+{
+    auto dynamic = dynamic_.upper_bound(address);
+    if (dynamic != dynamic_.begin())
+    {
+        --dynamic;
+        if (address < dynamic->second.end)
+        {
+            return KernelSymbol{ dynamic->first, dynamic->second.end, dynamic->second.name, {} };
+        }
+    }
+
+    auto it = std::upper_bound(starts_.begin(), starts_.end(), address);
+    if (it == starts_.begin())
+    {
+        return std::nullopt;
+    }
+
+    const auto index = std::distance(starts_.begin(), it) - 1;
+    const auto& entry = entries_[index];
+    if (address >= entry.end)
+    {
+        return std::nullopt;
+    }
+
+    return KernelSymbol{ starts_[index], entry.end,
+                         std::string_view(names_).substr(entry.name_offset, entry.name_size),
+                         entry.module != 0 ? std::string_view(modules_[entry.module - 1])
+                                           : std::string_view() };
+}
+
+} // namespace perf_cpp
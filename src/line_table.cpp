@@ -0,0 +1,752 @@
+/*
+ * This file is part of the perf_cpp library.
+ * Linux Perf C++ bindings
+ *
+ * Copyright (c) 2024,
+ *    Technische Universitaet Dresden, Germany
+ *
+ * perf_cpp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * perf_cpp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with perf_cpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <perf-cpp/line_table.hpp>
+
+#include "dwarf_cursor.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <numeric>
+#include <unordered_map>
+
+extern "C"
+{
+#include <elf.h>
+}
+
+namespace perf_cpp
+{
+
+namespace
+{
+// see the DWARF 5 standard, section 6.2 and 7.22
+enum : std::uint8_t
+{
+    DW_LNS_copy = 1,
+    DW_LNS_advance_pc = 2,
+    DW_LNS_advance_line = 3,
+    DW_LNS_set_file = 4,
+    DW_LNS_set_column = 5,
+    DW_LNS_negate_stmt = 6,
+    DW_LNS_set_basic_block = 7,
+    DW_LNS_const_add_pc = 8,
+    DW_LNS_fixed_advance_pc = 9,
+};
+
+enum : std::uint8_t
+{
+    DW_LNE_end_sequence = 1,
+    DW_LNE_set_address = 2,
+    DW_LNE_define_file = 3,
+};
+
+enum : std::uint64_t
+{
+    DW_LNCT_path = 1,
+    DW_LNCT_directory_index = 2,
+};
+
+enum : std::uint64_t
+{
+    DW_FORM_block2 = 0x03,
+    DW_FORM_block4 = 0x04,
+    DW_FORM_data2 = 0x05,
+    DW_FORM_data4 = 0x06,
+    DW_FORM_data8 = 0x07,
+    DW_FORM_string = 0x08,
+    DW_FORM_block = 0x09,
+    DW_FORM_block1 = 0x0a,
+    DW_FORM_data1 = 0x0b,
+    DW_FORM_sdata = 0x0d,
+    DW_FORM_strp = 0x0e,
+    DW_FORM_udata = 0x0f,
+    DW_FORM_data16 = 0x1e,
+    DW_FORM_line_strp = 0x1f,
+};
+
+constexpr char file_magic[4] = { 'P', 'C', 'L', 'T' };
+constexpr std::uint32_t file_version = 1;
+
+// same as LineTable::no_file, for rows of unknown files and sequence ends
+constexpr std::uint32_t no_file_id = ~0u;
+
+// batches smaller than this are resolved with one binary search per address
+constexpr std::size_t min_sorted_batch = 64;
+
+std::string_view string_at(const std::optional<ElfSection>& section, std::uint64_t offset)
+{
+    if (!section || offset >= section->size)
+    {
+        return {};
+    }
+    const auto* str = reinterpret_cast<const char*>(section->data) + offset;
+    return std::string_view(str, strnlen(str, section->size - offset));
+}
+
+struct Row
+{
+    std::uint64_t address;
+    std::uint32_t file;
+    std::uint32_t line;
+};
+
+class LineProgramDecoder
+{
+public:
+    LineProgramDecoder(const ElfFile& file)
+    : line_str_(file.section(".debug_line_str")), str_(file.section(".debug_str"))
+    {
+    }
+
+    void decode_unit(DwarfCursor& section);
+
+    std::vector<std::string> files;
+    std::vector<Row> rows;
+
+private:
+    // reads one attribute of a v5 directory/file entry
+    std::string_view read_form(DwarfCursor& cursor, std::uint64_t form, bool dwarf64,
+                               std::uint64_t& number);
+
+    std::uint32_t intern(std::string_view directory, std::string_view name);
+
+    std::optional<ElfSection> line_str_;
+    std::optional<ElfSection> str_;
+    std::unordered_map<std::string, std::uint32_t> file_ids_;
+};
+
+std::string_view LineProgramDecoder::read_form(DwarfCursor& cursor, std::uint64_t form,
+                                               bool dwarf64, std::uint64_t& number)
+{
+    number = 0;
+    switch (form)
+    {
+    case DW_FORM_string:
+        return cursor.cstr();
+    case DW_FORM_line_strp:
+        return string_at(line_str_, cursor.offset(dwarf64));
+    case DW_FORM_strp:
+        return string_at(str_, cursor.offset(dwarf64));
+    case DW_FORM_data1:
+        number = cursor.read<std::uint8_t>();
+        return {};
+    case DW_FORM_data2:
+        number = cursor.read<std::uint16_t>();
+        return {};
+    case DW_FORM_data4:
+        number = cursor.read<std::uint32_t>();
+        return {};
+    case DW_FORM_data8:
+        number = cursor.read<std::uint64_t>();
+        return {};
+    case DW_FORM_udata:
+        number = cursor.uleb();
+        return {};
+    case DW_FORM_sdata:
+        number = cursor.sleb();
+        return {};
+    case DW_FORM_data16:
+        cursor.skip(16);
+        return {};
+    case DW_FORM_block:
+        cursor.skip(cursor.uleb());
+        return {};
+    case DW_FORM_block1:
+        cursor.skip(cursor.read<std::uint8_t>());
+        return {};
+    case DW_FORM_block2:
+        cursor.skip(cursor.read<std::uint16_t>());
+        return {};
+    case DW_FORM_block4:
+        cursor.skip(cursor.read<std::uint32_t>());
+        return {};
+    default:
+        // e.g. DW_FORM_strx, which needs .debug_str_offsets of the unit;
+        // the size is unknown, so the rest of the header can't be read
+        cursor.skip(~0ull);
+        return {};
+    }
+}
+
+std::uint32_t LineProgramDecoder::intern(std::string_view directory, std::string_view name)
+{
+    std::string path;
+    if (!name.empty() && name.front() != '/' && !directory.empty())
+    {
+        path.reserve(directory.size() + 1 + name.size());
+        path.append(directory);
+        path += '/';
+    }
+    path.append(name);
+
+    auto it = file_ids_.find(path);
+    if (it != file_ids_.end())
+    {
+        return it->second;
+    }
+
+    const std::uint32_t id = files.size();
+    files.push_back(path);
+    file_ids_.emplace(std::move(path), id);
+    return id;
+}
+
+void LineProgramDecoder::decode_unit(DwarfCursor& section)
+{
+    bool dwarf64 = false;
+    std::uint64_t unit_length = section.read<std::uint32_t>();
+    if (unit_length == 0xffffffff)
+    {
+        dwarf64 = true;
+        unit_length = section.read<std::uint64_t>();
+    }
+
+    const auto* unit_begin = section.pos();
+    section.skip(unit_length);
+    if (section.failed())
+    {
+        return;
+    }
+    DwarfCursor cursor(unit_begin, section.pos());
+
+    const auto version = cursor.read<std::uint16_t>();
+    if (version < 2 || version > 5)
+    {
+        return;
+    }
+
+    if (version >= 5)
+    {
+        // DW_LNE_set_address carries its own size, so these are not needed
+        cursor.read<std::uint8_t>(); // address_size
+        cursor.read<std::uint8_t>(); // segment_selector_size
+    }
+
+    const auto header_length = cursor.offset(dwarf64);
+    const auto* program_begin = cursor.pos() + header_length;
+
+    const auto min_instruction_length = cursor.read<std::uint8_t>();
+    if (version >= 4)
+    {
+        cursor.read<std::uint8_t>(); // maximum_operations_per_instruction, VLIW only
+    }
+    cursor.read<std::uint8_t>(); // default_is_stmt, every row is kept
+    const auto line_base = cursor.read<std::int8_t>();
+    const auto line_range = cursor.read<std::uint8_t>();
+    const auto opcode_base = cursor.read<std::uint8_t>();
+    if (line_range == 0 || opcode_base == 0)
+    {
+        return;
+    }
+
+    std::vector<std::uint8_t> standard_opcode_lengths(opcode_base);
+    for (std::size_t i = 1; i < opcode_base; i++)
+    {
+        standard_opcode_lengths[i] = cursor.read<std::uint8_t>();
+    }
+
+    // file numbers of this unit -> interned ids
+    std::vector<std::uint32_t> unit_files;
+    std::vector<std::string_view> directories;
+
+    if (version >= 5)
+    {
+        auto read_entries = [&](bool is_file)
+        {
+            std::vector<std::pair<std::uint64_t, std::uint64_t>> formats(
+                cursor.read<std::uint8_t>());
+            for (auto& format : formats)
+            {
+                format.first = cursor.uleb();
+                format.second = cursor.uleb();
+            }
+
+            const auto count = cursor.uleb();
+            for (std::uint64_t i = 0; i < count && !cursor.failed(); i++)
+            {
+                std::string_view path;
+                std::uint64_t directory = 0;
+                for (const auto& format : formats)
+                {
+                    std::uint64_t number;
+                    auto str = read_form(cursor, format.second, dwarf64, number);
+                    if (format.first == DW_LNCT_path)
+                    {
+                        path = str;
+                    }
+                    else if (format.first == DW_LNCT_directory_index)
+                    {
+                        directory = number;
+                    }
+                }
+
+                if (is_file)
+                {
+                    unit_files.push_back(intern(
+                        directory < directories.size() ? directories[directory] : "", path));
+                }
+                else
+                {
+                    directories.push_back(path);
+                }
+            }
+        };
+        read_entries(false);
+        read_entries(true);
+    }
+    else
+    {
+        // directory 0 is the compilation directory, which is not part of the
+        // line table header; file 0 does not exist
+        directories.emplace_back();
+        for (auto dir = cursor.cstr(); !dir.empty() && !cursor.failed(); dir = cursor.cstr())
+        {
+            directories.push_back(dir);
+        }
+
+        unit_files.push_back(no_file_id);
+        for (auto name = cursor.cstr(); !name.empty() && !cursor.failed(); name = cursor.cstr())
+        {
+            const auto directory = cursor.uleb();
+            cursor.uleb(); // mtime
+            cursor.uleb(); // length
+            unit_files.push_back(
+                intern(directory < directories.size() ? directories[directory] : "", name));
+        }
+    }
+
+    if (cursor.failed() || program_begin > section.pos())
+    {
+        return;
+    }
+    cursor = DwarfCursor(program_begin, section.pos());
+
+    std::uint64_t address = 0;
+    std::uint64_t file = 1;
+    std::int64_t line = 1;
+    std::vector<Row> sequence;
+
+    auto emit = [&]()
+    {
+        const auto id = file < unit_files.size() ? unit_files[file] : no_file_id;
+        sequence.push_back(Row{ address, id, static_cast<std::uint32_t>(line) });
+    };
+
+    while (!cursor.at_end() && !cursor.failed())
+    {
+        const auto opcode = cursor.read<std::uint8_t>();
+        if (opcode >= opcode_base)
+        {
+            const auto adjusted = opcode - opcode_base;
+            address += (adjusted / line_range) * min_instruction_length;
+            line += line_base + adjusted % line_range;
+            emit();
+            continue;
+        }
+
+        switch (opcode)
+        {
+        case 0:
+        {
+            const auto length = cursor.uleb();
+            if (length == 0)
+            {
+                break;
+            }
+            const auto* end = cursor.pos() + length;
+            const auto sub_opcode = cursor.read<std::uint8_t>();
+            if (sub_opcode == DW_LNE_end_sequence)
+            {
+                // sequences starting at 0 belong to code that the linker
+                // discarded, they would shadow real code at low addresses
+                if (!sequence.empty() && sequence.front().address != 0)
+                {
+                    rows.insert(rows.end(), sequence.begin(), sequence.end());
+                    rows.push_back(Row{ address, no_file_id, 0 });
+                }
+                sequence.clear();
+                address = 0;
+                file = 1;
+                line = 1;
+            }
+            else if (sub_opcode == DW_LNE_set_address)
+            {
+                address = cursor.address(length - 1);
+            }
+            else if (sub_opcode == DW_LNE_define_file)
+            {
+                const auto name = cursor.cstr();
+                const auto directory = cursor.uleb();
+                unit_files.push_back(
+                    intern(directory < directories.size() ? directories[directory] : "", name));
+            }
+
+            // skip whatever the sub opcode did not consume
+            if (cursor.pos() < end)
+            {
+                cursor.skip(end - cursor.pos());
+            }
+            break;
+        }
+        case DW_LNS_copy:
+            emit();
+            break;
+        case DW_LNS_advance_pc:
+            address += cursor.uleb() * min_instruction_length;
+            break;
+        case DW_LNS_advance_line:
+            line += cursor.sleb();
+            break;
+        case DW_LNS_set_file:
+            file = cursor.uleb();
+            break;
+        case DW_LNS_const_add_pc:
+            address += ((255 - opcode_base) / line_range) * min_instruction_length;
+            break;
+        case DW_LNS_fixed_advance_pc:
+            address += cursor.read<std::uint16_t>();
+            break;
+        default:
+            // DW_LNS_set_column, negate_stmt, set_basic_block and everything
+            // newer than the unit's opcode_base only take uleb operands
+            for (std::size_t i = 0; i < standard_opcode_lengths[opcode]; i++)
+            {
+                cursor.uleb();
+            }
+            break;
+        }
+    }
+}
+} // namespace
+
+LineTable LineTable::from_elf(const ElfFile& file)
+{
+    LineTable table;
+
+    auto section = file.section(".debug_line");
+    if (!section || (section->flags & SHF_COMPRESSED))
+    {
+        return table;
+    }
+
+    LineProgramDecoder decoder(file);
+    DwarfCursor cursor(section->data, section->data + section->size);
+    while (!cursor.at_end() && !cursor.failed())
+    {
+        decoder.decode_unit(cursor);
+    }
+
+    // stable: the end of one sequence and the start of the next often share
+    // an address, the start has to win
+    auto& rows = decoder.rows;
+    std::stable_sort(rows.begin(), rows.end(),
+                     [](const Row& a, const Row& b) { return a.address < b.address; });
+
+    table.files_ = std::move(decoder.files);
+    table.addresses_.reserve(rows.size());
+    table.file_indices_.reserve(rows.size());
+    table.lines_.reserve(rows.size());
+    for (const auto& row : rows)
+    {
+        if (!table.addresses_.empty() && table.addresses_.back() == row.address)
+        {
+            // the last row for an address describes it
+            if (row.file != no_file || table.file_indices_.back() == no_file)
+            {
+                table.file_indices_.back() = row.file;
+                table.lines_.back() = row.line;
+            }
+            continue;
+        }
+        table.addresses_.push_back(row.address);
+        table.file_indices_.push_back(row.file);
+        table.lines_.push_back(row.line);
+    }
+    return table;
+}
+
+std::optional<SourceLocation> LineTable::at(std::size_t row) const
+{
+    const auto file = file_indices_[row];
+    if (file == no_file || file >= files_.size())
+    {
+        return std::nullopt;
+    }
+    return SourceLocation{ files_[file], lines_[row] };
+}
+
+std::optional<SourceLocation> LineTable::lookup(std::uint64_t address) const
+{
+    auto it = std::upper_bound(addresses_.begin(), addresses_.end(), address);
+    if (it == addresses_.begin())
+    {
+        return std::nullopt;
+    }
+    return at(std::distance(addresses_.begin(), it) - 1);
+}
+
+void LineTable::lookup(const std::uint64_t* addresses, std::size_t count,
+                       std::optional<SourceLocation>* result) const
+{
+    if (count < min_sorted_batch)
+    {
+        for (std::size_t i = 0; i < count; i++)
+        {
+            result[i] = lookup(addresses[i]);
+        }
+        return;
+    }
+
+    std::vector<std::uint32_t> order(count);
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(),
+              [addresses](std::uint32_t a, std::uint32_t b)
+              { return addresses[a] < addresses[b]; });
+
+    std::size_t row = 0;
+    for (auto i : order)
+    {
+        while (row < addresses_.size() && addresses_[row] <= addresses[i])
+        {
+            row++;
+        }
+        result[i] = row > 0 ? at(row - 1) : std::nullopt;
+    }
+}
+
+void LineTable::save(const std::filesystem::path& path) const
+{
+    // write to a temporary file first, concurrent readers never see half a table
+    auto tmp = path;
+    tmp += ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        auto write = [&out](const void* data, std::size_t size)
+        { out.write(static_cast<const char*>(data), size); };
+
+        write(file_magic, sizeof(file_magic));
+        write(&file_version, sizeof(file_version));
+
+        const std::uint64_t files = files_.size();
+        write(&files, sizeof(files));
+        for (const auto& file : files_)
+        {
+            const std::uint32_t size = file.size();
+            write(&size, sizeof(size));
+            write(file.data(), size);
+        }
+
+        const std::uint64_t rows = addresses_.size();
+        write(&rows, sizeof(rows));
+        write(addresses_.data(), rows * sizeof(std::uint64_t));
+        write(file_indices_.data(), rows * sizeof(std::uint32_t));
+        write(lines_.data(), rows * sizeof(std::uint32_t));
+
+        if (!out)
+        {
+            throw std::runtime_error("failed to write " + tmp.string());
+        }
+    }
+    std::filesystem::rename(tmp, path);
+}
+
+std::optional<LineTable> LineTable::load(const std::filesystem::path& path)
+{
+    std::error_code error;
+    const auto file_size = std::filesystem::file_size(path, error);
+    std::ifstream in(path, std::ios::binary);
+    if (error || !in)
+    {
+        return std::nullopt;
+    }
+
+    auto read = [&in](void* data, std::size_t size)
+    { return static_cast<bool>(in.read(static_cast<char*>(data), size)); };
+    // counts come from the file, a corrupt one must not make us allocate
+    // more than it could possibly hold
+    auto fits = [&in, file_size](std::uint64_t count, std::size_t size)
+    {
+        const auto pos = static_cast<std::uint64_t>(in.tellg());
+        return pos <= file_size && count <= (file_size - pos) / size;
+    };
+
+    char magic[sizeof(file_magic)];
+    std::uint32_t version;
+    std::uint64_t files;
+    if (!read(magic, sizeof(magic)) || std::memcmp(magic, file_magic, sizeof(magic)) != 0 ||
+        !read(&version, sizeof(version)) || version != file_version ||
+        !read(&files, sizeof(files)) || files >= no_file || !fits(files, sizeof(std::uint32_t)))
+    {
+        return std::nullopt;
+    }
+
+    LineTable table;
+    table.files_.resize(files);
+    for (auto& file : table.files_)
+    {
+        std::uint32_t size;
+        if (!read(&size, sizeof(size)) || !fits(size, 1))
+        {
+            return std::nullopt;
+        }
+        file.resize(size);
+        if (!read(file.data(), size))
+        {
+            return std::nullopt;
+        }
+    }
+
+    std::uint64_t rows;
+    if (!read(&rows, sizeof(rows)) || rows > (1ull << 32) ||
+        !fits(rows, sizeof(std::uint64_t) + 2 * sizeof(std::uint32_t)))
+    {
+        return std::nullopt;
+    }
+    table.addresses_.resize(rows);
+    table.file_indices_.resize(rows);
+    table.lines_.resize(rows);
+    if (!read(table.addresses_.data(), rows * sizeof(std::uint64_t)) ||
+        !read(table.file_indices_.data(), rows * sizeof(std::uint32_t)) ||
+        !read(table.lines_.data(), rows * sizeof(std::uint32_t)))
+    {
+        return std::nullopt;
+    }
+    return table;
+}
+
+LineTableCache& LineTableCache::instance()
+{
+    static LineTableCache cache(
+        []() -> std::filesystem::path
+        {
+            if (const char* xdg = std::getenv("XDG_CACHE_HOME"); xdg != nullptr && *xdg != '\0')
+            {
+                return std::filesystem::path(xdg) / "perf-cpp" / "lines";
+            }
+            if (const char* home = std::getenv("HOME"); home != nullptr && *home != '\0')
+            {
+                return std::filesystem::path(home) / ".cache" / "perf-cpp" / "lines";
+            }
+            return {};
+        }());
+    return cache;
+}
+
+std::shared_ptr<const LineTable> LineTableCache::get(const std::filesystem::path& path)
+{
+    const auto id = FileId::of(path);
+    if (!id)
+    {
+        return nullptr;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = by_path_.find(path);
+        if (it != by_path_.end() && it->second.first == *id)
+        {
+            return it->second.second;
+        }
+    }
+
+    std::unique_ptr<ElfFile> file;
+    try
+    {
+        file = std::make_unique<ElfFile>(path);
+    }
+    catch (const std::exception&)
+    {
+        return nullptr;
+    }
+
+    const auto build_id = file->build_id();
+    std::shared_ptr<const LineTable> table;
+    if (build_id)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = by_build_id_.find(*build_id);
+        if (it != by_build_id_.end())
+        {
+            table = it->second;
+        }
+    }
+
+    if (!table)
+    {
+        table = decode(*file, build_id);
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (build_id)
+    {
+        table = by_build_id_.emplace(*build_id, table).first->second;
+    }
+    by_path_[path] = { *id, table };
+    return table;
+}
+
+std::shared_ptr<const LineTable>
+LineTableCache::decode(const ElfFile& file, const std::optional<std::string>& build_id)
+{
+    std::filesystem::path cached;
+    if (build_id && !cache_dir_.empty())
+    {
+        cached = cache_dir_ / (*build_id + ".lines");
+        if (auto table = LineTable::load(cached))
+        {
+            return std::make_shared<const LineTable>(std::move(*table));
+        }
+    }
+
+    auto table = LineTable::from_elf(file);
+    if (table.empty() && build_id && build_id->size() > 2)
+    {
+        // distributions ship the debug info in separate files
+        const auto debug_file = std::filesystem::path("/usr/lib/debug/.build-id") /
+                                build_id->substr(0, 2) / (build_id->substr(2) + ".debug");
+        try
+        {
+            table = LineTable::from_elf(ElfFile(debug_file));
+        }
+        catch (const std::exception&)
+        {
+        }
+    }
+
+    if (!cached.empty())
+    {
+        try
+        {
+            std::filesystem::create_directories(cache_dir_);
+            table.save(cached);
+        }
+        catch (const std::exception&)
+        {
+            // a read-only cache only costs time on the next run
+        }
+    }
+    return std::make_shared<const LineTable>(std::move(table));
+}
+
+} // namespace perf_cpp
@@ -0,0 +1,161 @@
+/*
+ * This file is part of the perf_cpp library.
+ * Linux Perf C++ bindings
+ *
+ * Copyright (c) 2024,
+ *    Technische Universitaet Dresden, Germany
+ *
+ * perf_cpp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * perf_cpp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with perf_cpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <perf-cpp/error.hpp>
+#include <perf-cpp/reader_pool.hpp>
+#include <perf-cpp/topology.hpp>
+
+#include <algorithm>
+#include <map>
+#include <stdexcept>
+
+extern "C"
+{
+#include <pthread.h>
+#include <sched.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+}
+
+namespace perf_cpp
+{
+
+ReaderPool::ReaderPool(std::size_t threads_per_partition, std::chrono::milliseconds poll_timeout)
+: threads_per_partition_(std::max<std::size_t>(threads_per_partition, 1)),
+  poll_timeout_(poll_timeout)
+{
+    stop_fd_ = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (stop_fd_ == -1)
+    {
+        throw_errno();
+    }
+}
+
+ReaderPool::~ReaderPool()
+{
+    stop();
+    close(stop_fd_);
+}
+
+void ReaderPool::add(Cpu cpu, RingBuffer& buffer)
+{
+    if (!threads_.empty())
+    {
+        throw std::runtime_error("can not add buffers to a running ReaderPool!");
+    }
+    buffers_.emplace_back(cpu, &buffer);
+}
+
+void ReaderPool::prepare()
+{
+    // the threads of a running pool refer to readers_
+    if (!threads_.empty())
+    {
+        throw std::runtime_error("ReaderPool is already running!");
+    }
+
+    // consume the wakeup of a previous stop()
+    std::uint64_t value;
+    if (read(stop_fd_, &value, sizeof(value)) == -1)
+    {
+        // EAGAIN, the pool was never stopped
+    }
+    stopped_.store(false);
+
+    partition();
+}
+
+void ReaderPool::partition()
+{
+    const auto& topology = Topology::instance();
+
+    // (node, package) pairs: usually the same thing, but sub-NUMA clustering
+    // splits packages, and some machines put several packages on one node
+    std::map<std::pair<int, int>, std::vector<std::pair<Cpu, RingBuffer*>>> partitions;
+    for (const auto& buffer : buffers_)
+    {
+        const auto node = topology.numa_node_of(buffer.first);
+        const auto package = topology.package_of(buffer.first);
+        partitions[{ node.as_int(), package.as_int() }].push_back(buffer);
+    }
+
+    readers_.clear();
+    for (auto& partition : partitions)
+    {
+        std::sort(partition.second.begin(), partition.second.end(),
+                  [](const auto& lhs, const auto& rhs) { return lhs.first < rhs.first; });
+        const auto first = readers_.size();
+        const auto threads = std::min(threads_per_partition_, partition.second.size());
+        for (std::size_t i = 0; i < threads; i++)
+        {
+            readers_.push_back(Reader{ NumaNode(partition.first.first),
+                                       Package(partition.first.second),
+                                       {} });
+        }
+
+        // round-robin by cpu, so siblings end up spread out
+        for (std::size_t i = 0; i < partition.second.size(); i++)
+        {
+            readers_[first + i % threads].buffers.push_back(partition.second[i]);
+        }
+    }
+}
+
+void ReaderPool::pin(const Reader& reader)
+{
+    const auto& topology = Topology::instance();
+
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    for (const auto& cpu : topology.cpus_of(reader.node))
+    {
+        if (topology.package_of(cpu) == reader.package)
+        {
+            CPU_SET(cpu.as_int(), &cpus);
+        }
+    }
+
+    // Not being able to pin (e.g. restricted by a cpuset) only costs
+    // performance, so don't kill the reader for that.
+    pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+}
+
+void ReaderPool::stop()
+{
+    if (stopped_.exchange(true))
+    {
+        return;
+    }
+
+    std::uint64_t value = 1;
+    if (write(stop_fd_, &value, sizeof(value)) == -1)
+    {
+        // the readers still notice stopped_ after their poll timeout
+    }
+
+    for (auto& thread : threads_)
+    {
+        thread.join();
+    }
+    threads_.clear();
+}
+
+} // namespace perf_cpp
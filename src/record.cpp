@@ -0,0 +1,324 @@
+/*
+ * This file is part of the perf_cpp library.
+ * Linux Perf C++ bindings
+ *
+ * Copyright (c) 2024,
+ *    Technische Universitaet Dresden, Germany
+ *
+ * perf_cpp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * perf_cpp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with perf_cpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <perf-cpp/build_config.hpp>
+#include <perf-cpp/record.hpp>
+
+#include <algorithm>
+#include <cstring>
+
+namespace perf_cpp
+{
+
+namespace
+{
+// Bounds-checked cursor over the payload of a record
+class Cursor
+{
+public:
+    Cursor(const perf_event_header* header)
+    : pos_(reinterpret_cast<const std::byte*>(header + 1)),
+      end_(reinterpret_cast<const std::byte*>(header) + header->size)
+    {
+    }
+
+    template <typename T>
+    bool read(T& value)
+    {
+        if (pos_ + sizeof(T) > end_)
+        {
+            return false;
+        }
+        std::memcpy(&value, pos_, sizeof(T));
+        pos_ += sizeof(T);
+        return true;
+    }
+
+    bool skip(std::size_t bytes)
+    {
+        if (pos_ + bytes > end_)
+        {
+            return false;
+        }
+        pos_ += bytes;
+        return true;
+    }
+
+    const std::byte* pos() const
+    {
+        return pos_;
+    }
+
+private:
+    const std::byte* pos_;
+    const std::byte* end_;
+};
+
+std::size_t read_format_size(std::uint64_t read_format, Cursor& cursor)
+{
+    std::size_t per_value = 1;
+    if (read_format & PERF_FORMAT_ID)
+    {
+        per_value++;
+    }
+#ifdef HAVE_PERF_FORMAT_LOST
+    if (read_format & PERF_FORMAT_LOST)
+    {
+        per_value++;
+    }
+#endif
+
+    std::size_t times = 0;
+    if (read_format & PERF_FORMAT_TOTAL_TIME_ENABLED)
+    {
+        times++;
+    }
+    if (read_format & PERF_FORMAT_TOTAL_TIME_RUNNING)
+    {
+        times++;
+    }
+
+    if (read_format & PERF_FORMAT_GROUP)
+    {
+        std::uint64_t nr = 0;
+        if (!cursor.read(nr))
+        {
+            return 0;
+        }
+        // nr has already been consumed
+        return (times + nr * per_value) * sizeof(std::uint64_t);
+    }
+    return (times + per_value) * sizeof(std::uint64_t);
+}
+} // namespace
+
+bool decode_sample(const perf_event_header* header, const RecordLayout& layout,
+                   SampleView& sample)
+{
+    if (header->type != PERF_RECORD_SAMPLE)
+    {
+        return false;
+    }
+
+    const auto type = layout.sample_type;
+    Cursor cursor(header);
+
+    if ((type & PERF_SAMPLE_IDENTIFIER) && !cursor.read(sample.identifier))
+    {
+        return false;
+    }
+    if ((type & PERF_SAMPLE_IP) && !cursor.read(sample.ip))
+    {
+        return false;
+    }
+    if ((type & PERF_SAMPLE_TID) && !(cursor.read(sample.pid) && cursor.read(sample.tid)))
+    {
+        return false;
+    }
+    if ((type & PERF_SAMPLE_TIME) && !cursor.read(sample.time))
+    {
+        return false;
+    }
+    if ((type & PERF_SAMPLE_ADDR) && !cursor.read(sample.addr))
+    {
+        return false;
+    }
+    if ((type & PERF_SAMPLE_ID) && !cursor.read(sample.id))
+    {
+        return false;
+    }
+    if ((type & PERF_SAMPLE_STREAM_ID) && !cursor.read(sample.stream_id))
+    {
+        return false;
+    }
+    if (type & PERF_SAMPLE_CPU)
+    {
+        std::uint32_t res;
+        if (!(cursor.read(sample.cpu) && cursor.read(res)))
+        {
+            return false;
+        }
+    }
+    if ((type & PERF_SAMPLE_PERIOD) && !cursor.read(sample.period))
+    {
+        return false;
+    }
+    if ((type & PERF_SAMPLE_READ) && !cursor.skip(read_format_size(layout.read_format, cursor)))
+    {
+        return false;
+    }
+    if (type & PERF_SAMPLE_CALLCHAIN)
+    {
+        if (!cursor.read(sample.callchain_size))
+        {
+            return false;
+        }
+        sample.callchain = reinterpret_cast<const std::uint64_t*>(cursor.pos());
+        if (!cursor.skip(sample.callchain_size * sizeof(std::uint64_t)))
+        {
+            return false;
+        }
+    }
+    if (type & PERF_SAMPLE_RAW)
+    {
+        if (!cursor.read(sample.raw_size))
+        {
+            return false;
+        }
+        sample.raw = cursor.pos();
+        // the u32 size and the data are padded to 8 bytes together
+        const std::size_t padded = ((sample.raw_size + sizeof(std::uint32_t) + 7) & ~7ull) -
+                                   sizeof(std::uint32_t);
+        if (!cursor.skip(padded))
+        {
+            return false;
+        }
+    }
+    if (type & PERF_SAMPLE_BRANCH_STACK)
+    {
+        std::uint64_t nr;
+        if (!cursor.read(nr))
+        {
+            return false;
+        }
+#ifdef HAVE_PERF_SAMPLE_BRANCH_HW_INDEX
+        if ((layout.branch_sample_type & PERF_SAMPLE_BRANCH_HW_INDEX) &&
+            !cursor.skip(sizeof(std::uint64_t)))
+        {
+            return false;
+        }
+#endif
+        if (!cursor.skip(nr * sizeof(perf_branch_entry)))
+        {
+            return false;
+        }
+    }
+    if (type & PERF_SAMPLE_REGS_USER)
+    {
+        if (!cursor.read(sample.regs_user_abi))
+        {
+            return false;
+        }
+        if (sample.regs_user_abi != PERF_SAMPLE_REGS_ABI_NONE)
+        {
+            sample.regs_user_mask = layout.sample_regs_user;
+            sample.regs_user = reinterpret_cast<const std::uint64_t*>(cursor.pos());
+            const auto count = __builtin_popcountll(layout.sample_regs_user);
+            if (!cursor.skip(count * sizeof(std::uint64_t)))
+            {
+                return false;
+            }
+        }
+    }
+    if (type & PERF_SAMPLE_STACK_USER)
+    {
+        std::uint64_t size;
+        if (!cursor.read(size))
+        {
+            return false;
+        }
+        if (size != 0)
+        {
+            sample.stack_user = cursor.pos();
+            // dyn_size follows the data, it is how much of it the kernel filled
+            std::uint64_t dyn_size;
+            if (!cursor.skip(size) || !cursor.read(dyn_size))
+            {
+                return false;
+            }
+            sample.stack_user_size = std::min(size, dyn_size);
+        }
+    }
+    return true;
+}
+
+std::optional<std::uint64_t> user_register(const SampleView& sample, unsigned reg)
+{
+    if (sample.regs_user == nullptr || reg >= 64 || !(sample.regs_user_mask & (1ull << reg)))
+    {
+        return std::nullopt;
+    }
+    // registers are stored in the order of their bits
+    const auto index = __builtin_popcountll(sample.regs_user_mask & ((1ull << reg) - 1));
+    return sample.regs_user[index];
+}
+
+SampleView copy_sample(const SampleView& sample, Arena& arena)
+{
+    SampleView res = sample;
+    res.callchain = arena.copy(sample.callchain, sample.callchain_size);
+    res.raw = arena.copy(sample.raw, sample.raw_size);
+    if (sample.regs_user != nullptr)
+    {
+        res.regs_user = arena.copy(sample.regs_user, __builtin_popcountll(sample.regs_user_mask));
+    }
+    res.stack_user = arena.copy(sample.stack_user, sample.stack_user_size);
+    return res;
+}
+
+std::optional<std::uint64_t> record_time(const perf_event_header* header,
+                                         const RecordLayout& layout)
+{
+    const auto type = layout.sample_type;
+    if (!(type & PERF_SAMPLE_TIME))
+    {
+        return std::nullopt;
+    }
+
+    const auto* base = reinterpret_cast<const std::byte*>(header);
+    std::uint64_t time;
+
+    if (header->type == PERF_RECORD_SAMPLE)
+    {
+        // only IDENTIFIER, IP and TID may precede TIME
+        std::size_t offset = sizeof(*header);
+        offset += (type & PERF_SAMPLE_IDENTIFIER) ? sizeof(std::uint64_t) : 0;
+        offset += (type & PERF_SAMPLE_IP) ? sizeof(std::uint64_t) : 0;
+        offset += (type & PERF_SAMPLE_TID) ? sizeof(std::uint64_t) : 0;
+        if (offset + sizeof(time) > header->size)
+        {
+            return std::nullopt;
+        }
+        std::memcpy(&time, base + offset, sizeof(time));
+        return time;
+    }
+
+    if (!layout.sample_id_all)
+    {
+        return std::nullopt;
+    }
+
+    // struct sample_id is appended to the record, TIME is followed by
+    // ID, STREAM_ID, CPU and IDENTIFIER, so count back from the end.
+    std::size_t from_end = sizeof(std::uint64_t);
+    from_end += (type & PERF_SAMPLE_ID) ? sizeof(std::uint64_t) : 0;
+    from_end += (type & PERF_SAMPLE_STREAM_ID) ? sizeof(std::uint64_t) : 0;
+    from_end += (type & PERF_SAMPLE_CPU) ? sizeof(std::uint64_t) : 0;
+    from_end += (type & PERF_SAMPLE_IDENTIFIER) ? sizeof(std::uint64_t) : 0;
+    if (from_end + sizeof(*header) > header->size)
+    {
+        return std::nullopt;
+    }
+    std::memcpy(&time, base + header->size - from_end, sizeof(time));
+    return time;
+}
+
+} // namespace perf_cpp
@@ -0,0 +1,126 @@
+/*
+ * This file is part of the perf_cpp library.
+ * Linux Perf C++ bindings
+ *
+ * Copyright (c) 2024,
+ *    Technische Universitaet Dresden, Germany
+ *
+ * perf_cpp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * perf_cpp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with perf_cpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <perf-cpp/record_pipeline.hpp>
+
+#include <chrono>
+
+namespace perf_cpp
+{
+
+namespace
+{
+// Upper bound for a missed wakeup. The handshake with sleeping_ should not
+// miss any, but a consumer that sleeps too long is the cheapest failure mode.
+constexpr auto consumer_sleep = std::chrono::milliseconds(10);
+} // namespace
+
+RecordPipeline::RecordPipeline(std::size_t capacity, std::size_t batch_bytes, Overflow overflow)
+: batch_bytes_(batch_bytes), overflow_(overflow), queue_(capacity), free_(capacity)
+{
+}
+
+RecordPipeline::~RecordPipeline()
+{
+    stop();
+}
+
+void RecordPipeline::submit(RecordBatch& batch)
+{
+    if (batch.empty())
+    {
+        return;
+    }
+
+    while (!queue_.try_push(std::move(batch)))
+    {
+        if (overflow_ == Overflow::DROP || stopped_.load(std::memory_order_relaxed))
+        {
+            // batch keeps its capacity for the next round
+            dropped_records_.fetch_add(batch.records, std::memory_order_relaxed);
+            batch.clear();
+            return;
+        }
+        std::this_thread::yield();
+    }
+
+    // take a recycled batch only once this one is queued, so overload does
+    // not throw away free ones
+    batch = RecordBatch();
+    if (!free_.try_pop(batch))
+    {
+        // the largest record is 64k, leave room so that a full batch does not reallocate
+        batch.data.reserve(batch_bytes_ + (1 << 16));
+    }
+
+    if (sleeping_.load() > 0)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        not_empty_.notify_one();
+    }
+}
+
+bool RecordPipeline::next(RecordBatch& batch)
+{
+    while (true)
+    {
+        if (queue_.try_pop(batch))
+        {
+            return true;
+        }
+
+        if (stopped_.load())
+        {
+            return queue_.try_pop(batch);
+        }
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        sleeping_++;
+        not_empty_.wait_for(lock, consumer_sleep,
+                            [this]() { return !queue_.empty() || stopped_.load(); });
+        sleeping_--;
+    }
+}
+
+void RecordPipeline::recycle(RecordBatch& batch)
+{
+    batch.clear();
+    // if the free list is full, the batch is simply freed
+    free_.try_push(std::move(batch));
+    batch = RecordBatch();
+}
+
+void RecordPipeline::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopped_ = true;
+    }
+    not_empty_.notify_all();
+
+    for (auto& thread : threads_)
+    {
+        thread.join();
+    }
+    threads_.clear();
+}
+
+} // namespace perf_cpp
@@ -0,0 +1,162 @@
+/*
+ * This file is part of the perf_cpp library.
+ * Linux Perf C++ bindings
+ *
+ * Copyright (c) 2024,
+ *    Technische Universitaet Dresden, Germany
+ *
+ * perf_cpp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * perf_cpp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with perf_cpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <perf-cpp/error.hpp>
+#include <perf-cpp/ring_buffer.hpp>
+
+#include <stdexcept>
+#include <utility>
+
+extern "C"
+{
+#include <sys/mman.h>
+#include <unistd.h>
+}
+
+namespace perf_cpp
+{
+
+RingBuffer::RingBuffer(const EventGuard& ev, std::size_t data_pages, Mode mode)
+: fd_(ev.get_fd()), mode_(mode), read_format_(ev.read_format()),
+  telemetry_(std::make_unique<RingTelemetry>())
+{
+#ifdef HAVE_PERF_FORMAT_LOST
+    format_lost_ = (read_format_ & PERF_FORMAT_LOST) != 0;
+#endif
+    map(data_pages);
+}
+
+void RingBuffer::update_format_lost()
+{
+    if (auto lost = read_format_lost(fd_, read_format_))
+    {
+        telemetry_->set_format_lost(*lost);
+    }
+}
+
+void RingBuffer::map(std::size_t data_pages)
+{
+    if (data_pages == 0 || (data_pages & (data_pages - 1)) != 0)
+    {
+        throw std::runtime_error("ring buffer size must be a power of two pages!");
+    }
+
+    const std::size_t page_size = sysconf(_SC_PAGESIZE);
+    const std::size_t mapping_size = (data_pages + 1) * page_size;
+
+    // the kernel derives the overwrite mode from the missing PROT_WRITE
+    int prot = PROT_READ;
+    if (mode_ == Mode::CONSUME)
+    {
+        prot |= PROT_WRITE;
+    }
+
+    void* mapping = mmap(nullptr, mapping_size, prot, MAP_SHARED, fd_, 0);
+    if (mapping == MAP_FAILED)
+    {
+        throw_errno();
+    }
+
+    header_ = static_cast<perf_event_mmap_page*>(mapping);
+    mapping_size_ = mapping_size;
+    data_pages_ = data_pages;
+
+    // data_offset and data_size are only filled in since Linux 4.1
+    const std::size_t data_offset = header_->data_offset ? header_->data_offset : page_size;
+    size_ = header_->data_size ? header_->data_size : data_pages * page_size;
+    data_ = static_cast<std::byte*>(mapping) + data_offset;
+}
+
+void RingBuffer::remap(std::size_t data_pages)
+{
+    if (data_pages == data_pages_)
+    {
+        return;
+    }
+
+    // The kernel only accepts a different size once the old buffer is
+    // detached, which happens when its last mapping is gone.
+    const auto old_pages = data_pages_;
+    unmap();
+    try
+    {
+        map(data_pages);
+    }
+    catch (const std::exception&)
+    {
+        // e.g. not a power of two, or beyond the mlock budget
+        try
+        {
+            // nothing to restore if the buffer was unmapped already
+            if (old_pages != 0)
+            {
+                map(old_pages);
+            }
+        }
+        catch (const std::system_error&)
+        {
+            // unmapped, see mapped()
+            size_ = 0;
+            data_pages_ = 0;
+            mapping_size_ = 0;
+        }
+        throw;
+    }
+    telemetry_->reset_high_water();
+}
+
+RingBuffer::RingBuffer(RingBuffer&& other)
+{
+    *this = std::move(other);
+}
+
+RingBuffer& RingBuffer::operator=(RingBuffer&& other)
+{
+    std::swap(fd_, other.fd_);
+    std::swap(mode_, other.mode_);
+    std::swap(header_, other.header_);
+    std::swap(data_, other.data_);
+    std::swap(size_, other.size_);
+    std::swap(data_pages_, other.data_pages_);
+    std::swap(mapping_size_, other.mapping_size_);
+    std::swap(read_format_, other.read_format_);
+    std::swap(format_lost_, other.format_lost_);
+    std::swap(scratch_, other.scratch_);
+    std::swap(telemetry_, other.telemetry_);
+    return *this;
+}
+
+void RingBuffer::unmap()
+{
+    if (header_ != nullptr)
+    {
+        munmap(header_, mapping_size_);
+        header_ = nullptr;
+        data_ = nullptr;
+    }
+}
+
+RingBuffer::~RingBuffer()
+{
+    unmap();
+}
+
+} // namespace perf_cpp
@@ -0,0 +1,152 @@
+/*
+ * This file is part of the perf_cpp library.
+ * Linux Perf C++ bindings
+ *
+ * Copyright (c) 2024,
+ *    Technische Universitaet Dresden, Germany
+ *
+ * perf_cpp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * perf_cpp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with perf_cpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <perf-cpp/capabilities.hpp>
+#include <perf-cpp/ring_sizing.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace perf_cpp
+{
+
+namespace
+{
+// keep twice the data of one drain interval, bursts are common
+constexpr double headroom = 2.0;
+// consecutive idle reviews before a buffer is shrunk
+constexpr unsigned shrink_after = 3;
+
+std::size_t round_up_pow2(std::size_t value)
+{
+    std::size_t res = 1;
+    while (res < value)
+    {
+        res *= 2;
+    }
+    return res;
+}
+} // namespace
+
+RingSizingPolicy::RingSizingPolicy(double events_per_second, std::size_t record_size,
+                                   std::chrono::milliseconds drain_interval, std::size_t buffers)
+{
+    const auto& caps = Capabilities::instance();
+
+    budget_ = caps.mmap_page_budget();
+    auto even_share = caps.max_data_pages(buffers);
+    if (even_share == 0)
+    {
+        throw std::runtime_error("perf_event_mlock_kb and RLIMIT_MEMLOCK do not allow a single "
+                                 "page per ring buffer!");
+    }
+
+    const double bytes = events_per_second * record_size * drain_interval.count() / 1000.0;
+    const auto pages = static_cast<std::size_t>(std::ceil(bytes * headroom / caps.page_size()));
+    initial_pages_ = std::min(round_up_pow2(std::max<std::size_t>(pages, 1)), even_share);
+
+    // a single buffer may grow beyond its even share as long as the others
+    // leave enough room, which pages_in_use_ keeps track of
+    max_pages_ = std::max(caps.max_data_pages(1), initial_pages_);
+    pages_in_use_ = buffers * (initial_pages_ + 1);
+}
+
+std::uint32_t RingSizingPolicy::watermark() const
+{
+    return static_cast<std::uint32_t>(initial_pages_ * Capabilities::instance().page_size() / 2);
+}
+
+std::optional<std::size_t> RingSizingPolicy::review(RingBuffer& buffer)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    auto& state = states_[&buffer];
+    const auto telemetry = buffer.telemetry().snapshot();
+    buffer.telemetry().reset_high_water();
+
+    const auto lost = telemetry.lost_records + telemetry.lost_samples;
+    const bool lost_since_review = lost > state.lost;
+    state.lost = lost;
+
+    if (!buffer.mapped())
+    {
+        // a resize failed twice, map it again once the budget allows, its
+        // header page is still accounted for
+        state.idle_reviews = 0;
+        if (pages_in_use_ + initial_pages_ > budget_)
+        {
+            return std::nullopt;
+        }
+        pages_in_use_ += initial_pages_;
+        return initial_pages_;
+    }
+
+    const auto current = buffer.data_pages();
+    const double fill = static_cast<double>(telemetry.high_water) / buffer.size();
+
+    if (lost_since_review || fill > 0.75)
+    {
+        state.idle_reviews = 0;
+        const auto grown = current * 2;
+        if (grown > max_pages_ || pages_in_use_ + (grown - current) > budget_)
+        {
+            return std::nullopt;
+        }
+        pages_in_use_ += grown - current;
+        return grown;
+    }
+
+    if (fill < 0.125)
+    {
+        const auto shrunk = current / 2;
+        const auto min_pages = std::max<std::size_t>(initial_pages_ / 4, 1);
+        if (++state.idle_reviews < shrink_after || shrunk < min_pages)
+        {
+            return std::nullopt;
+        }
+        state.idle_reviews = 0;
+        pages_in_use_ -= current - shrunk;
+        return shrunk;
+    }
+
+    state.idle_reviews = 0;
+    return std::nullopt;
+}
+
+void RingSizingPolicy::release(const RingBuffer& buffer, std::size_t failed_pages)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    // the buffer kept its old size, or is unmapped with data_pages() == 0 if
+    // that could not be restored either
+    const auto current = buffer.data_pages();
+    if (failed_pages > current)
+    {
+        pages_in_use_ -= failed_pages - current;
+    }
+    else
+    {
+        pages_in_use_ += current - failed_pages;
+    }
+}
+
+} // namespace perf_cpp
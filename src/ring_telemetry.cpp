@@ -0,0 +1,107 @@
+/*
+ * This file is part of the perf_cpp library.
+ * Linux Perf C++ bindings
+ *
+ * Copyright (c) 2024,
+ *    Technische Universitaet Dresden, Germany
+ *
+ * perf_cpp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * perf_cpp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with perf_cpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <perf-cpp/ring_telemetry.hpp>
+
+extern "C"
+{
+#include <unistd.h>
+}
+
+namespace perf_cpp
+{
+
+namespace
+{
+// the hardware counters of a group, with room to spare for software events
+constexpr std::size_t max_group_members = 64;
+} // namespace
+
+RingTelemetrySnapshot RingTelemetry::snapshot() const
+{
+    RingTelemetrySnapshot snap;
+    snap.records = records_.load(std::memory_order_relaxed);
+    snap.bytes = bytes_.load(std::memory_order_relaxed);
+    snap.lost_events = lost_events_.load(std::memory_order_relaxed);
+    snap.lost_records = lost_records_.load(std::memory_order_relaxed);
+    snap.lost_samples = lost_samples_.load(std::memory_order_relaxed);
+    snap.throttles = throttles_.load(std::memory_order_relaxed);
+    snap.unthrottles = unthrottles_.load(std::memory_order_relaxed);
+    snap.format_lost = format_lost_.load(std::memory_order_relaxed);
+    snap.drains = drains_.load(std::memory_order_relaxed);
+    snap.high_water = high_water_.load(std::memory_order_relaxed);
+    snap.last_drain_latency =
+        std::chrono::nanoseconds(last_drain_latency_.load(std::memory_order_relaxed));
+    snap.max_drain_latency =
+        std::chrono::nanoseconds(max_drain_latency_.load(std::memory_order_relaxed));
+    return snap;
+}
+
+std::optional<std::uint64_t> read_format_lost(int fd, std::uint64_t read_format)
+{
+#ifdef HAVE_PERF_FORMAT_LOST
+    if (!(read_format & PERF_FORMAT_LOST))
+    {
+        return std::nullopt;
+    }
+
+    if (!(read_format & PERF_FORMAT_GROUP))
+    {
+        // value, [time_enabled], [time_running], [id], lost
+        std::uint64_t values[5];
+        auto res = ::read(fd, values, sizeof(values));
+        if (res < static_cast<ssize_t>(sizeof(std::uint64_t) * 2))
+        {
+            return std::nullopt;
+        }
+        return values[res / sizeof(std::uint64_t) - 1];
+    }
+
+    // nr, [time_enabled], [time_running], then { value, [id], lost } per member
+    std::uint64_t values[3 + 3 * max_group_members];
+    auto res = ::read(fd, values, sizeof(values));
+    if (res < static_cast<ssize_t>(sizeof(std::uint64_t)))
+    {
+        return std::nullopt;
+    }
+    const std::size_t header = 1 + ((read_format & PERF_FORMAT_TOTAL_TIME_ENABLED) ? 1 : 0) +
+                               ((read_format & PERF_FORMAT_TOTAL_TIME_RUNNING) ? 1 : 0);
+    const std::size_t member = 2 + ((read_format & PERF_FORMAT_ID) ? 1 : 0);
+    const std::size_t words = res / sizeof(std::uint64_t);
+    if (header + values[0] * member > words)
+    {
+        return std::nullopt;
+    }
+
+    std::uint64_t lost = 0;
+    for (std::size_t i = 0; i < values[0]; i++)
+    {
+        lost += values[header + i * member + member - 1];
+    }
+    return lost;
+#else
+    (void)fd;
+    (void)read_format;
+    return std::nullopt;
+#endif
+}
+
+} // namespace perf_cpp
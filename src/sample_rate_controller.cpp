@@ -0,0 +1,141 @@
+/*
+ * This file is part of the perf_cpp library.
+ * Linux Perf C++ bindings
+ *
+ * Copyright (c) 2024,
+ *    Technische Universitaet Dresden, Germany
+ *
+ * perf_cpp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * perf_cpp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with perf_cpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <perf-cpp/error.hpp>
+#include <perf-cpp/sample_rate_controller.hpp>
+
+#include <algorithm>
+
+extern "C"
+{
+#include <time.h>
+}
+
+namespace perf_cpp
+{
+
+namespace
+{
+// aim below the budget, so that noise does not push us over it all the time
+constexpr double target_share = 0.8;
+// limits for a single adjustment step, periods change geometrically
+constexpr double max_step = 4.0;
+constexpr double min_step = 0.5;
+} // namespace
+
+SampleRateController::SampleRateController(std::uint64_t initial_period, SampleRateBudget budget)
+: budget_(budget), initial_period_(initial_period), last_update_(std::chrono::steady_clock::now())
+{
+}
+
+std::size_t SampleRateController::add(EventGuard& guard, const RingBuffer& buffer)
+{
+    auto state = std::make_unique<CpuState>();
+    state->guard = &guard;
+    state->buffer = &buffer;
+    state->period = initial_period_;
+    const auto telemetry = buffer.telemetry().snapshot();
+    state->lost = lost_records(telemetry);
+    state->throttles = telemetry.throttles;
+    cpus_.emplace_back(std::move(state));
+    return cpus_.size() - 1;
+}
+
+std::uint64_t SampleRateController::clamp(double period) const
+{
+    return std::clamp(static_cast<std::uint64_t>(period), budget_.min_period, budget_.max_period);
+}
+
+void SampleRateController::update()
+{
+    const auto now = std::chrono::steady_clock::now();
+    const auto wall = std::chrono::duration_cast<std::chrono::nanoseconds>(now - last_update_);
+    if (wall.count() <= 0 || cpus_.empty())
+    {
+        return;
+    }
+    last_update_ = now;
+
+    const double consumer = consumer_ns_.exchange(0, std::memory_order_relaxed);
+    last_overhead_ = consumer / (static_cast<double>(wall.count()) * cpus_.size());
+
+    // Scale all periods by how far we are off the budget. Within
+    // [0.5, 1] of the budget everything stays as it is to avoid oscillation.
+    const double ratio = last_overhead_ / budget_.max_overhead;
+    double factor = 1.0;
+    if (ratio > 1.0)
+    {
+        factor = std::min(ratio / target_share, max_step);
+    }
+    else if (ratio < 0.5)
+    {
+        factor = std::max(ratio / target_share, min_step);
+    }
+
+    for (auto& cpu : cpus_)
+    {
+        double cpu_factor = factor;
+
+        const auto telemetry = cpu->buffer->telemetry().snapshot();
+        const auto lost_since = lost_records(telemetry) - cpu->lost;
+        const auto throttles = telemetry.throttles - cpu->throttles;
+        cpu->lost = lost_records(telemetry);
+        cpu->throttles = telemetry.throttles;
+        // an unmapped buffer (after a failed resize) has no fill
+        const double fill = cpu->buffer->mapped() ? static_cast<double>(cpu->buffer->fill()) /
+                                                        cpu->buffer->size()
+                                                  : 0.0;
+
+        if (lost_since > 0 || throttles > 0)
+        {
+            // the kernel or the reader can't keep up, back off hard
+            cpu_factor = std::max(cpu_factor, 2.0);
+        }
+        else if (fill > budget_.max_fill)
+        {
+            cpu_factor = std::max(cpu_factor, 1.5);
+        }
+        else if (cpu_factor < 1.0 && fill > budget_.max_fill / 2)
+        {
+            // there is cpu budget left, but this buffer would overflow first
+            cpu_factor = 1.0;
+        }
+
+        const auto period = clamp(cpu->period * cpu_factor);
+        if (period != cpu->period)
+        {
+            cpu->guard->set_period(period);
+            cpu->period = period;
+        }
+    }
+}
+
+std::chrono::nanoseconds SampleRateController::thread_cpu_time()
+{
+    struct timespec ts;
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) == -1)
+    {
+        throw_errno();
+    }
+    return std::chrono::seconds(ts.tv_sec) + std::chrono::nanoseconds(ts.tv_nsec);
+}
+
+} // namespace perf_cpp
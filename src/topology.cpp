@@ -32,6 +32,29 @@ void Topology::read_proc()
         cpu_to_package_.emplace(Cpu(cpu_id), Package(package_id));
     }
 
+    // Without CONFIG_NUMA there is no node directory, treat the machine as a single node
+    const std::filesystem::path node_path = "/sys/devices/system/node";
+    for (auto node_id : parse_list_from_file(node_path / "online"))
+    {
+        auto node_cpus =
+            parse_list_from_file(node_path / ("node"s + std::to_string(node_id)) / "cpulist");
+        for (auto cpu_id : node_cpus)
+        {
+            if (cpus_.count(Cpu(cpu_id)))
+            {
+                cpu_to_numa_node_.emplace(Cpu(cpu_id), NumaNode(node_id));
+                numa_nodes_.emplace(node_id);
+            }
+        }
+    }
+    for (const auto& cpu : cpus_)
+    {
+        if (cpu_to_numa_node_.emplace(cpu, NumaNode(0)).second)
+        {
+            numa_nodes_.emplace(0);
+        }
+    }
+
     std::string line;
     std::ifstream cpuinfo("/proc/cpuinfo");
 
@@ -0,0 +1,90 @@
+/*
+ * This file is part of the perf_cpp library.
+ * Linux Perf C++ bindings
+ *
+ * Copyright (c) 2024,
+ *    Technische Universitaet Dresden, Germany
+ *
+ * perf_cpp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * perf_cpp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with perf_cpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <perf-cpp/topology.hpp>
+#include <perf-cpp/tracepoint/event_attr.hpp>
+#include <perf-cpp/tracepoint/tracefs.hpp>
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+
+namespace perf_cpp
+{
+
+namespace tracepoint
+{
+
+TracepointEventAttr::ParseError::ParseError(const std::string& what, int error_code)
+: std::runtime_error(fmt::format("{}: {}", what, std::strerror(error_code)))
+{
+}
+
+TracepointEventAttr::TracepointEventAttr(const std::string& name)
+: EventAttr(name, PERF_TYPE_TRACEPOINT, 0), id_(-1)
+{
+    parse_format();
+    attr_.config = id_;
+
+    // tracepoints are not tied to a PMU, they fire on every cpu
+    cpus_ = Topology::instance().cpus();
+
+    event_is_openable();
+}
+
+void TracepointEventAttr::parse_format()
+{
+    auto event = name_;
+    std::replace(event.begin(), event.end(), ':', '/');
+    const auto path = Tracefs::instance().events() / event / "format";
+
+    std::ifstream format(path);
+    if (!format)
+    {
+        throw ParseError(fmt::format("failed to open {}", path.string()), errno);
+    }
+    parse_format(format);
+}
+
+void TracepointEventAttr::parse_format(std::istream& format)
+{
+    try
+    {
+        auto parsed = TracepointFormat::parse(format);
+        id_ = parsed.id;
+        fields_ = std::move(parsed.fields);
+    }
+    catch (const std::invalid_argument& e)
+    {
+        throw ParseError(fmt::format("tracepoint {}: {}", name_, e.what()));
+    }
+}
+
+TracepointFormat::TracepointFormat(const TracepointEventAttr& event)
+: TracepointFormat(event.id(), event.fields())
+{
+}
+
+} // namespace tracepoint
+} // namespace perf_cpp
@@ -0,0 +1,229 @@
+/*
+ * This file is part of the perf_cpp library.
+ * Linux Perf C++ bindings
+ *
+ * Copyright (c) 2024,
+ *    Technische Universitaet Dresden, Germany
+ *
+ * perf_cpp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * perf_cpp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with perf_cpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <perf-cpp/tracepoint/extraction_plan.hpp>
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace perf_cpp
+{
+
+namespace tracepoint
+{
+
+namespace
+{
+// common_type is the first field of every tracepoint record
+constexpr std::size_t common_type_offset = 0;
+
+std::size_t find_column(const std::vector<std::string>& names, std::string_view name,
+                        const char* kind)
+{
+    auto it = std::find(names.begin(), names.end(), name);
+    if (it == names.end())
+    {
+        throw std::out_of_range(fmt::format("{} is not an {} column of the plan", name, kind));
+    }
+    return std::distance(names.begin(), it);
+}
+} // namespace
+
+ExtractionPlan::ExtractionPlan(const TracepointEventAttr& event,
+                               const std::vector<std::string>& names)
+: common_type_(static_cast<std::uint16_t>(event.id()))
+{
+    compile(event.fields(), names);
+    min_size_ = std::max(min_size_, common_type_offset + sizeof(std::uint16_t));
+}
+
+ExtractionPlan::ExtractionPlan(const std::vector<EventField>& format,
+                               const std::vector<std::string>& names)
+{
+    compile(format, names);
+}
+
+void ExtractionPlan::compile(const std::vector<EventField>& format,
+                             const std::vector<std::string>& names)
+{
+    for (const auto& name : names)
+    {
+        auto field = std::find_if(format.begin(), format.end(),
+                                  [&name](const EventField& f) { return f.name() == name; });
+        if (field == format.end())
+        {
+            throw std::out_of_range(fmt::format("tracepoint has no field {}", name));
+        }
+
+        if (field->is_integer())
+        {
+            const auto width = static_cast<std::uint8_t>(field->size());
+            integer_ops_.push_back(IntegerOp{ static_cast<std::uint32_t>(field->offset()), width,
+                                              static_cast<std::uint8_t>(64 - 8 * width),
+                                              field->is_signed() });
+            integer_names_.push_back(name);
+        }
+        else
+        {
+            view_ops_.push_back(ViewOp{ static_cast<std::uint32_t>(field->offset()),
+                                        static_cast<std::uint32_t>(field->size()),
+                                        field->is_dynamic(),
+                                        field->is_relative(),
+                                        field->is_string() });
+            view_names_.push_back(name);
+        }
+        min_size_ = std::max(min_size_, static_cast<std::size_t>(field->offset()) + field->size());
+    }
+}
+
+std::size_t ExtractionPlan::integer_column(std::string_view name) const
+{
+    return find_column(integer_names_, name, "integer");
+}
+
+std::size_t ExtractionPlan::view_column(std::string_view name) const
+{
+    return find_column(view_names_, name, "string or array");
+}
+
+ColumnBatch ExtractionPlan::make_batch() const
+{
+    ColumnBatch batch;
+    batch.integers.resize(integer_ops_.size());
+    batch.views.resize(view_ops_.size());
+    return batch;
+}
+
+bool ExtractionPlan::extract(const std::byte* raw, std::size_t raw_size,
+                             ColumnBatch& batch) const
+{
+    if (raw_size < min_size_)
+    {
+        return false;
+    }
+    if (common_type_)
+    {
+        std::uint16_t type;
+        std::memcpy(&type, raw + common_type_offset, sizeof(type));
+        if (type != *common_type_)
+        {
+            return false;
+        }
+    }
+    // e.g. a default constructed batch instead of one of make_batch()
+    if (batch.integers.size() != integer_ops_.size() || batch.views.size() != view_ops_.size())
+    {
+        batch.integers.resize(integer_ops_.size());
+        batch.views.resize(view_ops_.size());
+    }
+
+    for (std::size_t i = 0; i < view_ops_.size(); i++)
+    {
+        const auto& op = view_ops_[i];
+        const auto* data = reinterpret_cast<const char*>(raw) + op.offset;
+        std::size_t size = op.size;
+        if (op.dynamic)
+        {
+            // u32: offset in the low, length in the high 16 bits
+            std::uint32_t loc;
+            std::memcpy(&loc, data, sizeof(loc));
+            std::size_t begin = loc & 0xffff;
+            size = loc >> 16;
+            if (op.relative)
+            {
+                begin += op.offset + op.size;
+            }
+            if (begin + size > raw_size)
+            {
+                // a corrupt __data_loc must not leave half a row behind
+                for (std::size_t j = 0; j < i; j++)
+                {
+                    batch.views[j].pop_back();
+                }
+                return false;
+            }
+            data = reinterpret_cast<const char*>(raw) + begin;
+        }
+        if (op.string)
+        {
+            size = strnlen(data, size);
+        }
+        batch.views[i].emplace_back(data, size);
+    }
+
+    for (std::size_t i = 0; i < integer_ops_.size(); i++)
+    {
+        const auto& op = integer_ops_[i];
+        // read 8 bytes where possible and cut them down with shifts, instead
+        // of switching on the width (little-endian only, like perf itself here)
+        std::uint64_t value = 0;
+        if (op.offset + sizeof(value) <= raw_size)
+        {
+            // constant size, so this compiles to a single load
+            std::memcpy(&value, raw + op.offset, sizeof(value));
+        }
+        else
+        {
+            std::memcpy(&value, raw + op.offset, op.width);
+        }
+        value <<= op.shift;
+        if (op.is_signed)
+        {
+            value = static_cast<std::uint64_t>(static_cast<std::int64_t>(value) >> op.shift);
+        }
+        else
+        {
+            value >>= op.shift;
+        }
+        batch.integers[i].push_back(value);
+    }
+    return true;
+}
+
+std::size_t ExtractionPlan::extract(const RecordBatch& records, const RecordLayout& layout,
+                                    ColumnBatch& batch) const
+{
+    std::size_t rows = 0;
+    records.for_each(
+        [&](Cpu cpu, const perf_event_header* record)
+        {
+            SampleView sample;
+            if (!decode_sample(record, layout, sample) || sample.raw == nullptr ||
+                !extract(sample.raw, sample.raw_size, batch))
+            {
+                return;
+            }
+            batch.time.push_back(sample.time);
+            // without PERF_SAMPLE_CPU, the cpu of the ring buffer is just as good
+            batch.cpu.push_back((layout.sample_type & PERF_SAMPLE_CPU) ? sample.cpu
+                                                                       : cpu.as_int());
+            batch.pid.push_back(sample.pid);
+            batch.tid.push_back(sample.tid);
+            rows++;
+        });
+    return rows;
+}
+
+} // namespace tracepoint
+} // namespace perf_cpp
@@ -0,0 +1,529 @@
+/*
+ * This file is part of the perf_cpp library.
+ * Linux Perf C++ bindings
+ *
+ * Copyright (c) 2024,
+ *    Technische Universitaet Dresden, Germany
+ *
+ * perf_cpp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * perf_cpp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with perf_cpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <perf-cpp/tracepoint/filter.hpp>
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <system_error>
+
+namespace perf_cpp
+{
+
+namespace tracepoint
+{
+
+struct Filter::Node
+{
+    enum class Type
+    {
+        AND,
+        OR,
+        NOT,
+        INTEGER,
+        STRING,
+    };
+
+    Type type;
+    std::shared_ptr<const Node> lhs;
+    std::shared_ptr<const Node> rhs;
+
+    std::string field;
+    Op op = Op::EQ;
+    Constant value{};
+    std::string text;
+};
+
+namespace
+{
+// the kernel's strings in filters are limited to MAX_FILTER_STR_VAL
+constexpr std::size_t max_string_length = 255;
+
+const char* op_name(Filter::Op op)
+{
+    switch (op)
+    {
+    case Filter::Op::EQ:
+        return "==";
+    case Filter::Op::NE:
+        return "!=";
+    case Filter::Op::LT:
+        return "<";
+    case Filter::Op::LE:
+        return "<=";
+    case Filter::Op::GT:
+        return ">";
+    case Filter::Op::GE:
+        return ">=";
+    case Filter::Op::MASK:
+        return "&";
+    case Filter::Op::GLOB:
+        return "~";
+    }
+    return "?";
+}
+
+std::string to_string(Filter::Constant value)
+{
+    if (value.negative)
+    {
+        return fmt::format("{}", static_cast<std::int64_t>(value.bits));
+    }
+    return fmt::format("{}", value.bits);
+}
+
+// The kernel truncates the constant to the width of the field before
+// comparing, so constants that do not fit would match differently in the
+// kernel and in userspace.
+bool fits(const EventField& field, Filter::Constant value)
+{
+    const auto bits = 8 * field.size();
+    if (field.is_signed())
+    {
+        const auto signed_value = static_cast<std::int64_t>(value.bits);
+        if (!value.negative && signed_value < 0)
+        {
+            return false;
+        }
+        if (bits >= 64)
+        {
+            return true;
+        }
+        const auto limit = std::int64_t(1) << (bits - 1);
+        return signed_value >= -limit && signed_value < limit;
+    }
+
+    if (value.negative)
+    {
+        return false;
+    }
+    return bits >= 64 || value.bits < (std::uint64_t(1) << bits);
+}
+
+// lib/glob.c: *, ?, [...] with ranges and ! for negation, \ escapes
+bool glob_match(std::string_view pattern, std::string_view text)
+{
+    auto at = [](std::string_view str, std::size_t i) -> unsigned char {
+        return i < str.size() ? static_cast<unsigned char>(str[i]) : '\0';
+    };
+
+    std::size_t p = 0;
+    std::size_t s = 0;
+    std::optional<std::size_t> back_pattern;
+    std::size_t back_text = 0;
+
+    for (;;)
+    {
+        const unsigned char c = at(text, s++);
+        unsigned char d = at(pattern, p++);
+        bool literal = true;
+
+        if (d == '?')
+        {
+            if (c == '\0')
+            {
+                return false;
+            }
+            continue;
+        }
+        if (d == '*')
+        {
+            if (at(pattern, p) == '\0')
+            {
+                return true;
+            }
+            back_pattern = p;
+            back_text = --s;
+            continue;
+        }
+        if (d == '[')
+        {
+            const bool inverted = at(pattern, p) == '!';
+            auto cls = p + inverted;
+            unsigned char a = at(pattern, cls++);
+            bool match = false;
+            bool closed = true;
+            do
+            {
+                unsigned char b = a;
+                if (a == '\0')
+                {
+                    closed = false;
+                    break;
+                }
+                if (at(pattern, cls) == '-' && at(pattern, cls + 1) != ']')
+                {
+                    b = at(pattern, cls + 1);
+                    if (b == '\0')
+                    {
+                        closed = false;
+                        break;
+                    }
+                    cls += 2;
+                }
+                match |= a <= c && c <= b;
+            } while ((a = at(pattern, cls++)) != ']');
+
+            if (closed)
+            {
+                if (match != inverted)
+                {
+                    p = cls;
+                    continue;
+                }
+                literal = false;
+            }
+        }
+        else if (d == '\\')
+        {
+            d = at(pattern, p++);
+        }
+
+        if (literal && c == d)
+        {
+            if (d == '\0')
+            {
+                return true;
+            }
+            continue;
+        }
+
+        if (c == '\0' || !back_pattern)
+        {
+            return false;
+        }
+        p = *back_pattern;
+        s = ++back_text;
+    }
+}
+
+template <typename T>
+bool compare(Filter::Op op, T lhs, T rhs)
+{
+    switch (op)
+    {
+    case Filter::Op::EQ:
+        return lhs == rhs;
+    case Filter::Op::NE:
+        return lhs != rhs;
+    case Filter::Op::LT:
+        return lhs < rhs;
+    case Filter::Op::LE:
+        return lhs <= rhs;
+    case Filter::Op::GT:
+        return lhs > rhs;
+    case Filter::Op::GE:
+        return lhs >= rhs;
+    default:
+        return false;
+    }
+}
+
+class Compiler
+{
+public:
+    Compiler(const std::vector<EventField>& format) : format_(format)
+    {
+    }
+
+    // appends node and its children to program, returns the expression
+    template <typename Instruction>
+    std::string compile(const Filter::Node& node, std::vector<Instruction>& program)
+    {
+        using Type = Filter::Node::Type;
+
+        Instruction instruction;
+        std::string expression;
+
+        switch (node.type)
+        {
+        case Type::AND:
+        case Type::OR:
+        {
+            const auto lhs = compile(*node.lhs, program);
+            instruction.lhs = program.size() - 1;
+            const auto rhs = compile(*node.rhs, program);
+            instruction.rhs = program.size() - 1;
+            instruction.type =
+                node.type == Type::AND ? Instruction::Type::AND : Instruction::Type::OR;
+            expression = fmt::format("({} {} {})", lhs, node.type == Type::AND ? "&&" : "||", rhs);
+            break;
+        }
+        case Type::NOT:
+        {
+            const auto operand = compile(*node.lhs, program);
+            instruction.lhs = program.size() - 1;
+            instruction.type = Instruction::Type::NOT;
+            expression = fmt::format("!({})", operand);
+            break;
+        }
+        case Type::INTEGER:
+        {
+            const auto& field = lookup(node.field);
+            if (!field.is_integer())
+            {
+                throw Filter::InvalidFilter(
+                    fmt::format("{} is not an integer field ({})", field.name(), field.type()));
+            }
+            if (!fits(field, node.value))
+            {
+                throw Filter::InvalidFilter(
+                    fmt::format("{} is out of range for {} {}", to_string(node.value),
+                                field.type(), field.name()));
+            }
+            instruction.type = Instruction::Type::INTEGER;
+            instruction.field = field;
+            instruction.op = node.op;
+            instruction.value = node.value;
+            expression = fmt::format("{} {} {}", field.name(), op_name(node.op),
+                                     to_string(node.value));
+            break;
+        }
+        case Type::STRING:
+        {
+            const auto& field = lookup(node.field);
+            if (!field.is_string())
+            {
+                throw Filter::InvalidFilter(
+                    fmt::format("{} is not a string field ({})", field.name(), field.type()));
+            }
+            if (node.text.find('"') != std::string::npos)
+            {
+                throw Filter::InvalidFilter(
+                    fmt::format("strings can not contain '\"': {}", node.text));
+            }
+            if (node.text.size() > max_string_length)
+            {
+                throw Filter::InvalidFilter(
+                    fmt::format("strings are limited to {} characters", max_string_length));
+            }
+            instruction.type = Instruction::Type::STRING;
+            instruction.field = field;
+            instruction.op = node.op;
+            instruction.text = node.text;
+            expression =
+                fmt::format("{} {} \"{}\"", field.name(), op_name(node.op), node.text);
+            break;
+        }
+        }
+
+        program.push_back(std::move(instruction));
+        return expression;
+    }
+
+private:
+    const EventField& lookup(const std::string& name) const
+    {
+        auto it = std::find_if(format_.begin(), format_.end(),
+                               [&](const auto& field) { return field.name() == name; });
+        if (it == format_.end())
+        {
+            throw Filter::InvalidFilter(fmt::format("no field {} in the tracepoint", name));
+        }
+        return *it;
+    }
+
+    const std::vector<EventField>& format_;
+};
+} // namespace
+
+Filter operator&&(const Filter& lhs, const Filter& rhs)
+{
+    Filter::Node node;
+    node.type = Filter::Node::Type::AND;
+    node.lhs = lhs.node_;
+    node.rhs = rhs.node_;
+    return Filter(std::make_shared<const Filter::Node>(std::move(node)));
+}
+
+Filter operator||(const Filter& lhs, const Filter& rhs)
+{
+    Filter::Node node;
+    node.type = Filter::Node::Type::OR;
+    node.lhs = lhs.node_;
+    node.rhs = rhs.node_;
+    return Filter(std::make_shared<const Filter::Node>(std::move(node)));
+}
+
+Filter operator!(const Filter& filter)
+{
+    Filter::Node node;
+    node.type = Filter::Node::Type::NOT;
+    node.lhs = filter.node_;
+    return Filter(std::make_shared<const Filter::Node>(std::move(node)));
+}
+
+BoundFilter Filter::bind(const std::vector<EventField>& format) const
+{
+    BoundFilter bound;
+    bound.expression_ = Compiler(format).compile(*node_, bound.program_);
+    return bound;
+}
+
+BoundFilter Filter::bind(const TracepointEventAttr& event) const
+{
+    return bind(event.fields());
+}
+
+Filter FieldRef::compare(Filter::Op op, Filter::Constant value) const
+{
+    Filter::Node node;
+    node.type = Filter::Node::Type::INTEGER;
+    node.field = name_;
+    node.op = op;
+    node.value = value;
+    return Filter(std::make_shared<const Filter::Node>(std::move(node)));
+}
+
+Filter FieldRef::compare(Filter::Op op, std::string_view value) const
+{
+    Filter::Node node;
+    node.type = Filter::Node::Type::STRING;
+    node.field = name_;
+    node.op = op;
+    node.text = value;
+    return Filter(std::make_shared<const Filter::Node>(std::move(node)));
+}
+
+Filter FieldRef::operator==(std::string_view value) const
+{
+    return compare(Filter::Op::EQ, value);
+}
+
+Filter FieldRef::operator!=(std::string_view value) const
+{
+    return compare(Filter::Op::NE, value);
+}
+
+Filter FieldRef::glob(std::string_view pattern) const
+{
+    return compare(Filter::Op::GLOB, pattern);
+}
+
+Filter FieldRef::in(const std::vector<Filter::Constant>& values) const
+{
+    if (values.empty())
+    {
+        throw Filter::InvalidFilter(fmt::format("empty set of values for {}", name_));
+    }
+
+    // the kernel has no set operator, so this becomes (f == a || f == b || ...)
+    auto filter = compare(Filter::Op::EQ, values.front());
+    for (auto it = values.begin() + 1; it != values.end(); ++it)
+    {
+        filter = filter || compare(Filter::Op::EQ, *it);
+    }
+    return filter;
+}
+
+bool BoundFilter::apply(EventGuard& guard)
+{
+    try
+    {
+        guard.set_filter(expression_);
+        applied_ = true;
+        return true;
+    }
+    catch (const std::system_error& e)
+    {
+        // the kernel did not understand the expression, anything else is a
+        // real error
+        if (e.code() != std::errc::invalid_argument)
+        {
+            throw;
+        }
+        // the records of that guard have to be filtered here, whatever the
+        // other guards do
+        rejected_ = true;
+        return false;
+    }
+}
+
+bool BoundFilter::matches(const std::byte* raw, std::size_t raw_size) const
+{
+    // default constructed, not bound by Filter::bind()
+    if (program_.empty())
+    {
+        return true;
+    }
+    return evaluate(program_.size() - 1, raw, raw_size);
+}
+
+bool BoundFilter::evaluate(std::size_t index, const std::byte* raw, std::size_t raw_size) const
+{
+    const auto& instruction = program_[index];
+    switch (instruction.type)
+    {
+    case Instruction::Type::AND:
+        return evaluate(instruction.lhs, raw, raw_size) &&
+               evaluate(instruction.rhs, raw, raw_size);
+    case Instruction::Type::OR:
+        return evaluate(instruction.lhs, raw, raw_size) ||
+               evaluate(instruction.rhs, raw, raw_size);
+    case Instruction::Type::NOT:
+        return !evaluate(instruction.lhs, raw, raw_size);
+    case Instruction::Type::INTEGER:
+    {
+        const auto value = instruction.field.integer(raw, raw_size);
+        if (!value)
+        {
+            return false;
+        }
+        if (instruction.op == Filter::Op::MASK)
+        {
+            return (*value & instruction.value.bits) != 0;
+        }
+        if (instruction.field.is_signed())
+        {
+            return compare(instruction.op, static_cast<std::int64_t>(*value),
+                           static_cast<std::int64_t>(instruction.value.bits));
+        }
+        return compare(instruction.op, *value, instruction.value.bits);
+    }
+    case Instruction::Type::STRING:
+    {
+        const auto text = instruction.field.string(raw, raw_size);
+        if (!text)
+        {
+            return false;
+        }
+        switch (instruction.op)
+        {
+        case Filter::Op::EQ:
+            return *text == instruction.text;
+        case Filter::Op::NE:
+            return *text != instruction.text;
+        case Filter::Op::GLOB:
+            return glob_match(instruction.text, *text);
+        default:
+            return false;
+        }
+    }
+    }
+    return false;
+}
+
+} // namespace tracepoint
+} // namespace perf_cpp
@@ -0,0 +1,303 @@
+/*
+ * This file is part of the perf_cpp library.
+ * Linux Perf C++ bindings
+ *
+ * Copyright (c) 2024,
+ *    Technische Universitaet Dresden, Germany
+ *
+ * perf_cpp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * perf_cpp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with perf_cpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <perf-cpp/tracepoint/format.hpp>
+
+#include <fmt/core.h>
+
+#include <cctype>
+#include <charconv>
+#include <limits>
+
+namespace perf_cpp
+{
+
+namespace tracepoint
+{
+
+namespace
+{
+std::string_view trim(std::string_view str)
+{
+    while (!str.empty() && std::isspace(static_cast<unsigned char>(str.front())))
+    {
+        str.remove_prefix(1);
+    }
+    while (!str.empty() && std::isspace(static_cast<unsigned char>(str.back())))
+    {
+        str.remove_suffix(1);
+    }
+    return str;
+}
+
+bool starts_with(std::string_view str, std::string_view prefix)
+{
+    return str.substr(0, prefix.size()) == prefix;
+}
+
+bool ends_with(std::string_view str, std::string_view suffix)
+{
+    return str.size() >= suffix.size() && str.substr(str.size() - suffix.size()) == suffix;
+}
+
+std::optional<std::size_t> to_number(std::string_view str)
+{
+    std::size_t value;
+    auto [end, ec] = std::from_chars(str.data(), str.data() + str.size(), value);
+    if (ec != std::errc() || end != str.data() + str.size())
+    {
+        return std::nullopt;
+    }
+    return value;
+}
+
+// the type without qualifiers, e.g. "unsigned int" for "const unsigned int"
+std::string_view base_type(std::string_view type)
+{
+    for (auto qualifier : { "const ", "volatile " })
+    {
+        while (starts_with(type, qualifier))
+        {
+            type = trim(type.substr(std::string_view(qualifier).size()));
+        }
+    }
+    return type;
+}
+
+bool is_char(std::string_view type)
+{
+    return type == "char" || type == "signed char" || type == "unsigned char";
+}
+
+// sizes of the element types of dynamic arrays, which the format does not state
+std::size_t type_size(std::string_view type)
+{
+    if (starts_with(type, "unsigned "))
+    {
+        type.remove_prefix(9);
+    }
+    else if (starts_with(type, "signed "))
+    {
+        type.remove_prefix(7);
+    }
+
+    if (is_char(type) || type == "u8" || type == "s8" || type == "__u8" || type == "__s8" ||
+        type == "bool")
+    {
+        return 1;
+    }
+    if (type == "short" || type == "u16" || type == "s16" || type == "__u16" || type == "__s16")
+    {
+        return 2;
+    }
+    if (type == "int" || type == "u32" || type == "s32" || type == "__u32" || type == "__s32" ||
+        type == "pid_t")
+    {
+        return 4;
+    }
+    if (type == "long" || type == "long long" || type == "u64" || type == "s64" ||
+        type == "__u64" || type == "__s64" || type == "size_t" || ends_with(type, "*"))
+    {
+        return sizeof(long);
+    }
+    return 1;
+}
+
+// for kernels that predate the signed: attribute
+bool guess_signed(std::string_view type)
+{
+    return !(starts_with(type, "unsigned") || starts_with(type, "u") ||
+             starts_with(type, "__u") || type == "bool" || type == "size_t" ||
+             type.find('*') != std::string_view::npos);
+}
+} // namespace
+
+EventField EventField::parse(const std::string& line)
+{
+    std::optional<std::string_view> declaration;
+    std::optional<std::size_t> offset;
+    std::optional<std::size_t> size;
+    std::optional<bool> is_signed;
+
+    std::string_view rest(line);
+    while (!rest.empty())
+    {
+        const auto end = rest.find(';');
+        const auto part = trim(rest.substr(0, end));
+        rest = end == std::string_view::npos ? std::string_view() : rest.substr(end + 1);
+
+        const auto colon = part.find(':');
+        if (colon == std::string_view::npos)
+        {
+            continue;
+        }
+        const auto key = part.substr(0, colon);
+        const auto value = trim(part.substr(colon + 1));
+
+        if (key == "field")
+        {
+            declaration = value;
+        }
+        else if (key == "offset")
+        {
+            offset = to_number(value);
+        }
+        else if (key == "size")
+        {
+            size = to_number(value);
+        }
+        else if (key == "signed")
+        {
+            is_signed = value == "1";
+        }
+    }
+
+    if (!declaration || !offset || !size)
+    {
+        throw std::invalid_argument(fmt::format("invalid tracepoint field: {}", line));
+    }
+
+    auto decl = *declaration;
+    EventField field;
+    field.offset_ = *offset;
+    field.size_ = *size;
+
+    // fixed arrays: "char comm[16]", the length may also be an unexpanded macro
+    bool array = false;
+    std::optional<std::size_t> length;
+    if (ends_with(decl, "]"))
+    {
+        const auto open = decl.rfind('[');
+        if (open == std::string_view::npos)
+        {
+            throw std::invalid_argument(fmt::format("invalid tracepoint field: {}", line));
+        }
+        array = true;
+        length = to_number(trim(decl.substr(open + 1, decl.size() - open - 2)));
+        decl = trim(decl.substr(0, open));
+    }
+
+    auto name_begin = decl.size();
+    while (name_begin > 0 && (std::isalnum(static_cast<unsigned char>(decl[name_begin - 1])) ||
+                              decl[name_begin - 1] == '_'))
+    {
+        name_begin--;
+    }
+    if (name_begin == decl.size())
+    {
+        throw std::invalid_argument(fmt::format("invalid tracepoint field: {}", line));
+    }
+    field.name_ = decl.substr(name_begin);
+    auto type = trim(decl.substr(0, name_begin));
+
+    // "__data_loc char[] name": a u32 locating the data behind the fixed fields
+    bool dynamic = false;
+    if (starts_with(type, "__data_loc ") || starts_with(type, "__rel_loc "))
+    {
+        dynamic = true;
+        field.relative_ = starts_with(type, "__rel_loc ");
+        type = trim(type.substr(type.find(' ')));
+        if (ends_with(type, "[]"))
+        {
+            type = trim(type.substr(0, type.size() - 2));
+        }
+    }
+    field.type_ = type;
+
+    const auto base = base_type(type);
+    const bool pointer = base.find('*') != std::string_view::npos;
+    field.signed_ = is_signed.value_or(guess_signed(base));
+
+    if (dynamic)
+    {
+        field.kind_ = is_char(base) ? Kind::DYNAMIC_STRING : Kind::DYNAMIC_ARRAY;
+        field.element_size_ = type_size(base);
+    }
+    else if (array)
+    {
+        field.kind_ = is_char(base) ? Kind::STRING : Kind::ARRAY;
+        if (length && *length > 0)
+        {
+            field.array_length_ = *length;
+            field.element_size_ = field.size_ / *length;
+        }
+        else
+        {
+            field.element_size_ = type_size(base);
+            field.array_length_ = field.size_ / field.element_size_;
+        }
+    }
+    else
+    {
+        field.element_size_ = field.size_;
+        if (pointer)
+        {
+            field.kind_ = Kind::POINTER;
+            field.signed_ = false;
+        }
+        else if (!starts_with(base, "struct ") &&
+                 (field.size_ == 1 || field.size_ == 2 || field.size_ == 4 || field.size_ == 8))
+        {
+            field.kind_ = Kind::INTEGER;
+        }
+        else
+        {
+            field.kind_ = Kind::OTHER;
+        }
+    }
+    return field;
+}
+
+TracepointFormat TracepointFormat::parse(std::istream& input)
+{
+    TracepointFormat format;
+    for (std::string line; std::getline(input, line);)
+    {
+        const auto begin = line.find_first_not_of(" \t");
+        if (begin == std::string::npos)
+        {
+            continue;
+        }
+
+        if (line.compare(begin, 3, "ID:") == 0)
+        {
+            const auto id = to_number(trim(std::string_view(line).substr(begin + 3)));
+            if (!id || *id > static_cast<std::size_t>(std::numeric_limits<int>::max()))
+            {
+                throw std::invalid_argument(fmt::format("invalid tracepoint id: {}", line));
+            }
+            format.id = static_cast<int>(*id);
+        }
+        else if (line.compare(begin, 6, "field:") == 0)
+        {
+            format.fields.emplace_back(EventField::parse(line));
+        }
+    }
+
+    if (format.id < 0)
+    {
+        throw std::invalid_argument("no id in the tracepoint format");
+    }
+    return format;
+}
+
+} // namespace tracepoint
+} // namespace perf_cpp
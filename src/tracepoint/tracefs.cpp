@@ -0,0 +1,340 @@
+/*
+ * This file is part of the perf_cpp library.
+ * Linux Perf C++ bindings
+ *
+ * Copyright (c) 2024,
+ *    Technische Universitaet Dresden, Germany
+ *
+ * perf_cpp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * perf_cpp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with perf_cpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <perf-cpp/tracepoint/tracefs.hpp>
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <system_error>
+
+extern "C"
+{
+#include <fnmatch.h>
+}
+
+namespace perf_cpp
+{
+
+namespace tracepoint
+{
+
+namespace
+{
+// /proc/mounts escapes spaces, tabs, newlines and backslashes as \ooo
+std::string unescape(const std::string& field)
+{
+    std::string result;
+    auto is_octal = [](char c) { return c >= '0' && c <= '7'; };
+
+    for (std::size_t i = 0; i < field.size(); i++)
+    {
+        if (field[i] == '\\' && i + 3 < field.size() && is_octal(field[i + 1]) &&
+            is_octal(field[i + 2]) && is_octal(field[i + 3]))
+        {
+            result.push_back(static_cast<char>((field[i + 1] - '0') * 64 +
+                                               (field[i + 2] - '0') * 8 + (field[i + 3] - '0')));
+            i += 3;
+        }
+        else
+        {
+            result.push_back(field[i]);
+        }
+    }
+    return result;
+}
+
+// splits "<subsystem>:<event>" or "<subsystem>/<event>"
+std::optional<std::pair<std::string_view, std::string_view>> split_name(std::string_view name)
+{
+    const auto separator = name.find_first_of(":/");
+    if (separator == std::string_view::npos)
+    {
+        return std::nullopt;
+    }
+    return std::make_pair(name.substr(0, separator), name.substr(separator + 1));
+}
+
+bool is_pattern(std::string_view str)
+{
+    return str.find_first_of("*?[") != std::string_view::npos;
+}
+
+bool glob(const std::string& pattern, const std::string& str)
+{
+    return fnmatch(pattern.c_str(), str.c_str(), 0) == 0;
+}
+} // namespace
+
+std::optional<std::filesystem::path> Tracefs::discover(std::istream& mounts)
+{
+    std::optional<std::filesystem::path> tracefs;
+    std::optional<std::filesystem::path> debugfs;
+
+    for (std::string line; std::getline(mounts, line);)
+    {
+        std::istringstream entry(line);
+        std::string device, mount_point, type;
+        if (!(entry >> device >> mount_point >> type))
+        {
+            continue;
+        }
+
+        if (type == "tracefs")
+        {
+            std::filesystem::path path = unescape(mount_point);
+            if (path == "/sys/kernel/tracing")
+            {
+                return path;
+            }
+            if (!tracefs)
+            {
+                tracefs = path;
+            }
+        }
+        else if (type == "debugfs" && !debugfs)
+        {
+            debugfs = std::filesystem::path(unescape(mount_point)) / "tracing";
+        }
+    }
+    return tracefs ? tracefs : debugfs;
+}
+
+std::optional<std::filesystem::path> Tracefs::discover()
+{
+    std::ifstream mounts("/proc/self/mounts");
+    if (mounts)
+    {
+        return discover(mounts);
+    }
+
+    for (const char* candidate : { "/sys/kernel/tracing", "/sys/kernel/debug/tracing" })
+    {
+        std::error_code ec;
+        if (std::filesystem::is_directory(std::filesystem::path(candidate) / "events", ec))
+        {
+            return candidate;
+        }
+    }
+    return std::nullopt;
+}
+
+TracepointCatalog::TracepointCatalog(std::filesystem::path events) : events_(std::move(events))
+{
+}
+
+void TracepointCatalog::list_subsystems()
+{
+    if (listed_)
+    {
+        return;
+    }
+    listed_ = true;
+
+    std::error_code ec;
+    for (std::filesystem::directory_iterator it(events_, ec), end; !ec && it != end;
+         it.increment(ec))
+    {
+        // events/ also contains the files enable, filter and header_*
+        if (it->is_directory(ec))
+        {
+            subsystems_.emplace(it->path().filename().string(), Subsystem());
+        }
+    }
+}
+
+TracepointCatalog::Subsystem* TracepointCatalog::find_subsystem(std::string_view name)
+{
+    list_subsystems();
+    auto it = subsystems_.find(name);
+    return it == subsystems_.end() ? nullptr : &it->second;
+}
+
+const std::vector<std::string>& TracepointCatalog::list_events(const std::string& name,
+                                                               Subsystem& subsystem)
+{
+    if (subsystem.events)
+    {
+        return *subsystem.events;
+    }
+
+    std::vector<std::string> events;
+    std::error_code ec;
+    for (std::filesystem::directory_iterator it(events_ / name, ec), end; !ec && it != end;
+         it.increment(ec))
+    {
+        if (it->is_directory(ec))
+        {
+            events.emplace_back(it->path().filename().string());
+        }
+    }
+    std::sort(events.begin(), events.end());
+    return *(subsystem.events = std::move(events));
+}
+
+bool TracepointCatalog::contains(std::string_view name)
+{
+    const auto parts = split_name(name);
+    if (!parts)
+    {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto* subsystem = find_subsystem(parts->first);
+    if (subsystem == nullptr)
+    {
+        return false;
+    }
+    const auto& events = list_events(std::string(parts->first), *subsystem);
+    return std::binary_search(events.begin(), events.end(), parts->second);
+}
+
+std::vector<std::string> TracepointCatalog::subsystems()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    list_subsystems();
+
+    std::vector<std::string> names;
+    names.reserve(subsystems_.size());
+    for (const auto& subsystem : subsystems_)
+    {
+        names.push_back(subsystem.first);
+    }
+    return names;
+}
+
+std::vector<std::string> TracepointCatalog::events(std::string_view name)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto* subsystem = find_subsystem(name);
+    if (subsystem == nullptr)
+    {
+        return {};
+    }
+    return list_events(std::string(name), *subsystem);
+}
+
+std::vector<std::string> TracepointCatalog::match(std::string_view pattern)
+{
+    std::string subsystem_pattern = "*";
+    std::string event_pattern(pattern);
+    if (const auto parts = split_name(pattern))
+    {
+        subsystem_pattern = parts->first;
+        event_pattern = parts->second;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    list_subsystems();
+
+    // the subsystems are sorted, so a literal one is a single lookup
+    auto begin = subsystems_.begin();
+    auto end = subsystems_.end();
+    if (!is_pattern(subsystem_pattern))
+    {
+        begin = subsystems_.find(subsystem_pattern);
+        end = begin == subsystems_.end() ? begin : std::next(begin);
+    }
+
+    std::vector<std::string> names;
+    for (auto subsystem = begin; subsystem != end; ++subsystem)
+    {
+        if (!glob(subsystem_pattern, subsystem->first))
+        {
+            continue;
+        }
+
+        const auto& events = list_events(subsystem->first, subsystem->second);
+        if (!is_pattern(event_pattern))
+        {
+            if (std::binary_search(events.begin(), events.end(), event_pattern))
+            {
+                names.push_back(fmt::format("{}:{}", subsystem->first, event_pattern));
+            }
+            continue;
+        }
+        for (const auto& event : events)
+        {
+            if (glob(event_pattern, event))
+            {
+                names.push_back(fmt::format("{}:{}", subsystem->first, event));
+            }
+        }
+    }
+    return names;
+}
+
+std::shared_ptr<const TracepointFormat> TracepointCatalog::format(std::string_view name)
+{
+    const auto parts = split_name(name);
+    if (!parts)
+    {
+        throw std::out_of_range(fmt::format("invalid tracepoint name: {}", name));
+    }
+    const std::string subsystem_name(parts->first);
+    const std::string event_name(parts->second);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto* subsystem = find_subsystem(subsystem_name);
+    if (subsystem == nullptr)
+    {
+        throw std::out_of_range(fmt::format("no tracepoint {}", name));
+    }
+
+    auto cached = subsystem->formats.find(event_name);
+    if (cached != subsystem->formats.end())
+    {
+        return cached->second;
+    }
+
+    const auto& events = list_events(subsystem_name, *subsystem);
+    if (!std::binary_search(events.begin(), events.end(), event_name))
+    {
+        throw std::out_of_range(fmt::format("no tracepoint {}", name));
+    }
+
+    const auto path = events_ / subsystem_name / event_name / "format";
+    std::ifstream input(path);
+    if (!input)
+    {
+        throw std::system_error(errno, std::generic_category(),
+                                fmt::format("failed to open {}", path.string()));
+    }
+
+    try
+    {
+        auto format = std::make_shared<const TracepointFormat>(TracepointFormat::parse(input));
+        subsystem->formats.emplace(event_name, format);
+        return format;
+    }
+    catch (const std::invalid_argument& e)
+    {
+        throw std::runtime_error(fmt::format("{}: {}", path.string(), e.what()));
+    }
+}
+
+} // namespace tracepoint
+} // namespace perf_cpp
@@ -0,0 +1,888 @@
+/*
+ * This file is part of the perf_cpp library.
+ * Linux Perf C++ bindings
+ *
+ * Copyright (c) 2024,
+ *    Technische Universitaet Dresden, Germany
+ *
+ * perf_cpp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * perf_cpp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with perf_cpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <perf-cpp/unwinder.hpp>
+
+#include "dwarf_cursor.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <unordered_map>
+
+extern "C"
+{
+#include <asm/perf_regs.h>
+#include <elf.h>
+}
+
+namespace perf_cpp
+{
+
+namespace
+{
+// see the DWARF 5 standard, section 6.4.2 and 7.24
+enum : std::uint8_t
+{
+    DW_CFA_advance_loc = 0x40,
+    DW_CFA_offset = 0x80,
+    DW_CFA_restore = 0xc0,
+
+    DW_CFA_nop = 0x00,
+    DW_CFA_set_loc = 0x01,
+    DW_CFA_advance_loc1 = 0x02,
+    DW_CFA_advance_loc2 = 0x03,
+    DW_CFA_advance_loc4 = 0x04,
+    DW_CFA_offset_extended = 0x05,
+    DW_CFA_restore_extended = 0x06,
+    DW_CFA_undefined = 0x07,
+    DW_CFA_same_value = 0x08,
+    DW_CFA_register = 0x09,
+    DW_CFA_remember_state = 0x0a,
+    DW_CFA_restore_state = 0x0b,
+    DW_CFA_def_cfa = 0x0c,
+    DW_CFA_def_cfa_register = 0x0d,
+    DW_CFA_def_cfa_offset = 0x0e,
+    DW_CFA_def_cfa_expression = 0x0f,
+    DW_CFA_expression = 0x10,
+    DW_CFA_offset_extended_sf = 0x11,
+    DW_CFA_def_cfa_sf = 0x12,
+    DW_CFA_def_cfa_offset_sf = 0x13,
+    DW_CFA_val_offset = 0x14,
+    DW_CFA_val_offset_sf = 0x15,
+    DW_CFA_val_expression = 0x16,
+    DW_CFA_GNU_window_save = 0x2d,
+    DW_CFA_GNU_args_size = 0x2e,
+    DW_CFA_GNU_negative_offset_extended = 0x2f,
+};
+
+// pointer encodings of .eh_frame, see the LSB, section 10.5
+enum : std::uint8_t
+{
+    DW_EH_PE_absptr = 0x00,
+    DW_EH_PE_uleb128 = 0x01,
+    DW_EH_PE_udata2 = 0x02,
+    DW_EH_PE_udata4 = 0x03,
+    DW_EH_PE_udata8 = 0x04,
+    DW_EH_PE_sleb128 = 0x09,
+    DW_EH_PE_sdata2 = 0x0a,
+    DW_EH_PE_sdata4 = 0x0b,
+    DW_EH_PE_sdata8 = 0x0c,
+    DW_EH_PE_pcrel = 0x10,
+    DW_EH_PE_omit = 0xff,
+};
+
+// DWARF register numbers of the registers an UnwindRow tracks
+struct DwarfRegisters
+{
+    std::uint64_t stack_pointer;
+    std::uint64_t frame_pointer;
+};
+
+std::optional<DwarfRegisters> dwarf_registers(std::uint16_t machine)
+{
+    switch (machine)
+    {
+    case EM_X86_64:
+        return DwarfRegisters{ 7, 6 };
+    case EM_AARCH64:
+        return DwarfRegisters{ 31, 29 };
+    default:
+        return std::nullopt;
+    }
+}
+
+// the CFI state of the three tracked registers at one address
+struct CfiState
+{
+    UnwindRow::Cfa cfa = UnwindRow::Cfa::UNKNOWN;
+    std::int64_t cfa_offset = 0;
+    UnwindRow::Rule ra = UnwindRow::Rule::SAME_VALUE;
+    std::int64_t ra_offset = 0;
+    UnwindRow::Rule fp = UnwindRow::Rule::SAME_VALUE;
+    std::int64_t fp_offset = 0;
+};
+
+struct Cie
+{
+    std::uint64_t code_alignment;
+    std::int64_t data_alignment;
+    std::uint64_t return_address_register;
+    std::uint8_t fde_encoding = DW_EH_PE_absptr;
+    bool has_augmentation_data = false;
+    // the state after the initial instructions, DW_CFA_restore returns to it
+    CfiState initial;
+};
+
+class EhFrameParser
+{
+public:
+    EhFrameParser(const ElfSection& section, DwarfRegisters registers)
+    : section_(section), registers_(registers)
+    {
+    }
+
+    void parse();
+
+    std::vector<UnwindRow> rows;
+
+private:
+    const Cie* cie_at(std::uint64_t offset);
+    std::optional<std::uint64_t> read_pointer(DwarfCursor& cursor, std::uint8_t encoding);
+
+    // runs instructions, emitting a row whenever the location advances
+    void execute(DwarfCursor cursor, const Cie& cie, CfiState& state, std::uint64_t& location,
+                 bool emit_rows);
+    void emit(const CfiState& state, std::uint64_t location);
+
+    const ElfSection& section_;
+    DwarfRegisters registers_;
+    std::unordered_map<std::uint64_t, std::optional<Cie>> cies_;
+    // first row of the FDE that is currently executed
+    std::size_t fde_rows_ = 0;
+};
+
+std::optional<std::uint64_t> EhFrameParser::read_pointer(DwarfCursor& cursor,
+                                                         std::uint8_t encoding)
+{
+    if (encoding == DW_EH_PE_omit)
+    {
+        return 0;
+    }
+
+    const auto field_address = section_.address + (cursor.pos() - section_.data);
+    std::uint64_t value;
+    switch (encoding & 0x0f)
+    {
+    case DW_EH_PE_absptr:
+    case DW_EH_PE_udata8:
+    case DW_EH_PE_sdata8:
+        value = cursor.read<std::uint64_t>();
+        break;
+    case DW_EH_PE_uleb128:
+        value = cursor.uleb();
+        break;
+    case DW_EH_PE_udata2:
+        value = cursor.read<std::uint16_t>();
+        break;
+    case DW_EH_PE_udata4:
+        value = cursor.read<std::uint32_t>();
+        break;
+    case DW_EH_PE_sleb128:
+        value = cursor.sleb();
+        break;
+    case DW_EH_PE_sdata2:
+        value = static_cast<std::int64_t>(cursor.read<std::int16_t>());
+        break;
+    case DW_EH_PE_sdata4:
+        value = static_cast<std::int64_t>(cursor.read<std::int32_t>());
+        break;
+    default:
+        return std::nullopt;
+    }
+
+    switch (encoding & 0x70)
+    {
+    case 0:
+        return value;
+    case DW_EH_PE_pcrel:
+        return value + field_address;
+    default:
+        // textrel, datarel and funcrel are not used for code addresses on
+        // the supported architectures
+        return std::nullopt;
+    }
+}
+
+const Cie* EhFrameParser::cie_at(std::uint64_t offset)
+{
+    auto [it, inserted] = cies_.try_emplace(offset);
+    if (!inserted)
+    {
+        return it->second ? &*it->second : nullptr;
+    }
+    if (offset >= section_.size)
+    {
+        return nullptr;
+    }
+
+    DwarfCursor entry(section_.data + offset, section_.data + section_.size);
+    bool dwarf64 = false;
+    std::uint64_t length = entry.read<std::uint32_t>();
+    if (length == 0xffffffff)
+    {
+        dwarf64 = true;
+        length = entry.read<std::uint64_t>();
+    }
+    const auto* body = entry.pos();
+    entry.skip(length);
+    if (entry.failed())
+    {
+        return nullptr;
+    }
+    DwarfCursor cursor(body, entry.pos());
+
+    if (cursor.offset(dwarf64) != 0)
+    {
+        return nullptr;
+    }
+
+    const auto version = cursor.read<std::uint8_t>();
+    const auto augmentation = cursor.cstr();
+    if (augmentation.find("eh") != std::string_view::npos)
+    {
+        cursor.skip(sizeof(std::uint64_t));
+    }
+    if (version >= 4)
+    {
+        cursor.read<std::uint8_t>(); // address_size
+        cursor.read<std::uint8_t>(); // segment_selector_size
+    }
+
+    Cie cie;
+    cie.code_alignment = cursor.uleb();
+    cie.data_alignment = cursor.sleb();
+    cie.return_address_register = version == 1 ? cursor.read<std::uint8_t>() : cursor.uleb();
+
+    if (!augmentation.empty() && augmentation.front() == 'z')
+    {
+        cie.has_augmentation_data = true;
+        const auto size = cursor.uleb();
+        const auto* end = cursor.pos() + size;
+        for (auto c : augmentation.substr(1))
+        {
+            if (c == 'R')
+            {
+                cie.fde_encoding = cursor.read<std::uint8_t>();
+            }
+            else if (c == 'P')
+            {
+                read_pointer(cursor, cursor.read<std::uint8_t>()); // personality routine
+            }
+            else if (c == 'L')
+            {
+                cursor.read<std::uint8_t>(); // LSDA encoding
+            }
+            else if (c != 'S' && c != 'B')
+            {
+                // the augmentation size lets us skip the rest
+                break;
+            }
+        }
+        if (cursor.pos() > end)
+        {
+            return nullptr;
+        }
+        cursor.skip(end - cursor.pos());
+    }
+    else if (!augmentation.empty() && augmentation != "eh")
+    {
+        // unknown augmentation without a size, the instructions can't be found
+        return nullptr;
+    }
+
+    if (cursor.failed())
+    {
+        return nullptr;
+    }
+
+    std::uint64_t location = 0;
+    execute(cursor, cie, cie.initial, location, false);
+    it->second = cie;
+    return &*it->second;
+}
+
+void EhFrameParser::parse()
+{
+    DwarfCursor cursor(section_.data, section_.data + section_.size);
+    while (!cursor.at_end() && !cursor.failed())
+    {
+        const auto* entry = cursor.pos();
+        bool dwarf64 = false;
+        std::uint64_t length = cursor.read<std::uint32_t>();
+        if (length == 0)
+        {
+            // terminator
+            break;
+        }
+        if (length == 0xffffffff)
+        {
+            dwarf64 = true;
+            length = cursor.read<std::uint64_t>();
+        }
+        const auto* body = cursor.pos();
+        cursor.skip(length);
+        if (cursor.failed())
+        {
+            break;
+        }
+
+        DwarfCursor fde(body, cursor.pos());
+        const auto cie_pointer = fde.offset(dwarf64);
+        if (cie_pointer == 0)
+        {
+            cie_at(entry - section_.data);
+            continue;
+        }
+
+        // in .eh_frame, the CIE pointer is relative to its own position
+        const auto cie_offset = static_cast<std::uint64_t>(body - section_.data) - cie_pointer;
+        const auto* cie = cie_at(cie_offset);
+        if (cie == nullptr)
+        {
+            continue;
+        }
+
+        const auto begin = read_pointer(fde, cie->fde_encoding);
+        const auto range = read_pointer(fde, cie->fde_encoding & 0x0f);
+        if (cie->has_augmentation_data)
+        {
+            fde.skip(fde.uleb());
+        }
+        if (!begin || !range || *begin == 0 || fde.failed())
+        {
+            continue;
+        }
+
+        CfiState state = cie->initial;
+        std::uint64_t location = *begin;
+        fde_rows_ = rows.size();
+        execute(fde, *cie, state, location, true);
+        emit(state, location);
+
+        // the end of the FDE, the next one may start right there
+        CfiState end;
+        emit(end, *begin + *range);
+    }
+}
+
+void EhFrameParser::emit(const CfiState& state, std::uint64_t location)
+{
+    auto fits = [](std::int64_t offset)
+    {
+        return offset >= std::numeric_limits<std::int32_t>::min() &&
+               offset <= std::numeric_limits<std::int32_t>::max();
+    };
+
+    UnwindRow row{ location,
+                   static_cast<std::int32_t>(state.cfa_offset),
+                   static_cast<std::int32_t>(state.ra_offset),
+                   static_cast<std::int32_t>(state.fp_offset),
+                   state.cfa,
+                   state.ra,
+                   state.fp };
+    if (!fits(state.cfa_offset))
+    {
+        row.cfa = UnwindRow::Cfa::UNKNOWN;
+    }
+    if (!fits(state.ra_offset))
+    {
+        row.ra = UnwindRow::Rule::UNKNOWN;
+    }
+    if (!fits(state.fp_offset))
+    {
+        row.fp = UnwindRow::Rule::UNKNOWN;
+    }
+
+    // several instructions at the same location: the last state counts
+    if (rows.size() > fde_rows_ && rows.back().address == location)
+    {
+        rows.back() = row;
+        return;
+    }
+    rows.push_back(row);
+}
+
+void EhFrameParser::execute(DwarfCursor cursor, const Cie& cie, CfiState& state,
+                            std::uint64_t& location, bool emit_rows)
+{
+    std::vector<CfiState> remembered;
+
+    auto rule = [&](std::uint64_t reg, UnwindRow::Rule r, std::int64_t offset = 0)
+    {
+        if (reg == cie.return_address_register)
+        {
+            state.ra = r;
+            state.ra_offset = offset;
+        }
+        else if (reg == registers_.frame_pointer)
+        {
+            state.fp = r;
+            state.fp_offset = offset;
+        }
+    };
+
+    auto restore = [&](std::uint64_t reg)
+    {
+        if (reg == cie.return_address_register)
+        {
+            state.ra = cie.initial.ra;
+            state.ra_offset = cie.initial.ra_offset;
+        }
+        else if (reg == registers_.frame_pointer)
+        {
+            state.fp = cie.initial.fp;
+            state.fp_offset = cie.initial.fp_offset;
+        }
+    };
+
+    auto def_cfa_register = [&](std::uint64_t reg)
+    {
+        if (reg == registers_.stack_pointer)
+        {
+            state.cfa = UnwindRow::Cfa::STACK_POINTER;
+        }
+        else if (reg == registers_.frame_pointer)
+        {
+            state.cfa = UnwindRow::Cfa::FRAME_POINTER;
+        }
+        else
+        {
+            state.cfa = UnwindRow::Cfa::UNKNOWN;
+        }
+    };
+
+    auto advance = [&](std::uint64_t delta)
+    {
+        if (emit_rows)
+        {
+            emit(state, location);
+        }
+        location += delta * cie.code_alignment;
+    };
+
+    while (!cursor.at_end() && !cursor.failed())
+    {
+        const auto opcode = cursor.read<std::uint8_t>();
+        const std::uint8_t operand = opcode & 0x3f;
+
+        switch (opcode & 0xc0)
+        {
+        case DW_CFA_advance_loc:
+            advance(operand);
+            continue;
+        case DW_CFA_offset:
+            rule(operand, UnwindRow::Rule::OFFSET, cursor.uleb() * cie.data_alignment);
+            continue;
+        case DW_CFA_restore:
+            restore(operand);
+            continue;
+        default:
+            break;
+        }
+
+        switch (opcode)
+        {
+        case DW_CFA_nop:
+        case DW_CFA_GNU_window_save:
+            break;
+        case DW_CFA_set_loc:
+            if (auto address = read_pointer(cursor, cie.fde_encoding))
+            {
+                if (emit_rows)
+                {
+                    emit(state, location);
+                }
+                location = *address;
+            }
+            break;
+        case DW_CFA_advance_loc1:
+            advance(cursor.read<std::uint8_t>());
+            break;
+        case DW_CFA_advance_loc2:
+            advance(cursor.read<std::uint16_t>());
+            break;
+        case DW_CFA_advance_loc4:
+            advance(cursor.read<std::uint32_t>());
+            break;
+        case DW_CFA_offset_extended:
+        {
+            const auto reg = cursor.uleb();
+            rule(reg, UnwindRow::Rule::OFFSET, cursor.uleb() * cie.data_alignment);
+            break;
+        }
+        case DW_CFA_offset_extended_sf:
+        {
+            const auto reg = cursor.uleb();
+            rule(reg, UnwindRow::Rule::OFFSET, cursor.sleb() * cie.data_alignment);
+            break;
+        }
+        case DW_CFA_GNU_negative_offset_extended:
+        {
+            const auto reg = cursor.uleb();
+            rule(reg, UnwindRow::Rule::OFFSET,
+                 -static_cast<std::int64_t>(cursor.uleb()) * cie.data_alignment);
+            break;
+        }
+        case DW_CFA_restore_extended:
+            restore(cursor.uleb());
+            break;
+        case DW_CFA_undefined:
+            rule(cursor.uleb(), UnwindRow::Rule::UNDEFINED);
+            break;
+        case DW_CFA_same_value:
+            rule(cursor.uleb(), UnwindRow::Rule::SAME_VALUE);
+            break;
+        case DW_CFA_register:
+        {
+            const auto reg = cursor.uleb();
+            cursor.uleb();
+            rule(reg, UnwindRow::Rule::UNKNOWN);
+            break;
+        }
+        case DW_CFA_val_offset:
+        case DW_CFA_val_offset_sf:
+        {
+            const auto reg = cursor.uleb();
+            if (opcode == DW_CFA_val_offset)
+            {
+                cursor.uleb();
+            }
+            else
+            {
+                cursor.sleb();
+            }
+            rule(reg, UnwindRow::Rule::UNKNOWN);
+            break;
+        }
+        case DW_CFA_expression:
+        case DW_CFA_val_expression:
+        {
+            const auto reg = cursor.uleb();
+            cursor.skip(cursor.uleb());
+            rule(reg, UnwindRow::Rule::UNKNOWN);
+            break;
+        }
+        case DW_CFA_remember_state:
+            remembered.push_back(state);
+            break;
+        case DW_CFA_restore_state:
+            if (!remembered.empty())
+            {
+                // the location is not part of the remembered state
+                state = remembered.back();
+                remembered.pop_back();
+            }
+            break;
+        case DW_CFA_def_cfa:
+            def_cfa_register(cursor.uleb());
+            state.cfa_offset = cursor.uleb();
+            break;
+        case DW_CFA_def_cfa_sf:
+            def_cfa_register(cursor.uleb());
+            state.cfa_offset = cursor.sleb() * cie.data_alignment;
+            break;
+        case DW_CFA_def_cfa_register:
+            def_cfa_register(cursor.uleb());
+            break;
+        case DW_CFA_def_cfa_offset:
+            state.cfa_offset = cursor.uleb();
+            break;
+        case DW_CFA_def_cfa_offset_sf:
+            state.cfa_offset = cursor.sleb() * cie.data_alignment;
+            break;
+        case DW_CFA_def_cfa_expression:
+            cursor.skip(cursor.uleb());
+            state.cfa = UnwindRow::Cfa::UNKNOWN;
+            break;
+        case DW_CFA_GNU_args_size:
+            cursor.uleb();
+            break;
+        default:
+            // unknown opcode, its operands can't be skipped
+            state.cfa = UnwindRow::Cfa::UNKNOWN;
+            return;
+        }
+    }
+}
+
+#if defined(__x86_64__)
+constexpr unsigned perf_reg_ip = PERF_REG_X86_IP;
+constexpr unsigned perf_reg_sp = PERF_REG_X86_SP;
+constexpr unsigned perf_reg_fp = PERF_REG_X86_BP;
+#elif defined(__aarch64__)
+constexpr unsigned perf_reg_ip = PERF_REG_ARM64_PC;
+constexpr unsigned perf_reg_sp = PERF_REG_ARM64_SP;
+constexpr unsigned perf_reg_fp = PERF_REG_ARM64_X29;
+constexpr unsigned perf_reg_lr = PERF_REG_ARM64_LR;
+#endif
+} // namespace
+
+UnwindTable::UnwindTable(const ElfFile& file)
+{
+    const auto registers = dwarf_registers(file.machine());
+    const auto section = file.section(".eh_frame");
+    if (!registers || !section)
+    {
+        return;
+    }
+
+    EhFrameParser parser(*section, *registers);
+    parser.parse();
+
+    auto& rows = parser.rows;
+    std::stable_sort(rows.begin(), rows.end(), [](const UnwindRow& a, const UnwindRow& b)
+                     { return a.address < b.address; });
+
+    addresses_.reserve(rows.size());
+    rows_.reserve(rows.size());
+    for (const auto& row : rows)
+    {
+        if (!addresses_.empty() && addresses_.back() == row.address)
+        {
+            // the start of a function wins over the end of the previous one
+            if (row.cfa != UnwindRow::Cfa::UNKNOWN || rows_.back().cfa == UnwindRow::Cfa::UNKNOWN)
+            {
+                rows_.back() = row;
+            }
+            continue;
+        }
+        addresses_.push_back(row.address);
+        rows_.push_back(row);
+    }
+}
+
+const UnwindRow* UnwindTable::lookup(std::uint64_t address) const
+{
+    auto it = std::upper_bound(addresses_.begin(), addresses_.end(), address);
+    if (it == addresses_.begin())
+    {
+        return nullptr;
+    }
+    const auto& row = rows_[std::distance(addresses_.begin(), it) - 1];
+    if (row.cfa == UnwindRow::Cfa::UNKNOWN || row.ra == UnwindRow::Rule::UNKNOWN)
+    {
+        return nullptr;
+    }
+    return &row;
+}
+
+std::shared_ptr<const UnwindTable> UnwindTableCache::get(const std::filesystem::path& path)
+{
+    const auto id = FileId::of(path);
+    if (!id)
+    {
+        return nullptr;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = by_path_.find(path);
+        if (it != by_path_.end() && it->second.first == *id)
+        {
+            return it->second.second;
+        }
+    }
+
+    // parse without holding the lock, other files can be resolved meanwhile
+    std::unique_ptr<ElfFile> file;
+    try
+    {
+        file = std::make_unique<ElfFile>(path);
+    }
+    catch (const std::exception&)
+    {
+        return nullptr;
+    }
+
+    const auto build_id = file->build_id();
+    std::shared_ptr<const UnwindTable> table;
+    if (build_id)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = by_build_id_.find(*build_id);
+        if (it != by_build_id_.end())
+        {
+            table = it->second;
+        }
+    }
+
+    if (!table)
+    {
+        table = std::make_shared<const UnwindTable>(*file);
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (build_id)
+    {
+        // another thread may have won the race, use its table
+        table = by_build_id_.emplace(*build_id, table).first->second;
+    }
+    by_path_[path] = { *id, table };
+    return table;
+}
+
+std::uint64_t Unwinder::required_registers()
+{
+#if defined(__x86_64__)
+    return (1ull << perf_reg_ip) | (1ull << perf_reg_sp) | (1ull << perf_reg_fp);
+#elif defined(__aarch64__)
+    return (1ull << perf_reg_ip) | (1ull << perf_reg_sp) | (1ull << perf_reg_fp) |
+           (1ull << perf_reg_lr);
+#else
+    return 0;
+#endif
+}
+
+const UnwindRow* Unwinder::find_row(std::uint32_t pid, std::uint64_t address,
+                                    std::uint64_t time)
+{
+    const auto* mapping =
+        tracker_.find(pid, address, time != 0 ? std::optional(time) : std::nullopt);
+    // anonymous memory and pseudo files like [vdso] can't be opened
+    if (mapping == nullptr || mapping->filename == nullptr || mapping->filename->empty() ||
+        mapping->filename->front() != '/')
+    {
+        return nullptr;
+    }
+
+    auto [it, inserted] = binaries_.try_emplace(mapping->filename);
+    auto& binary = it->second;
+    if (inserted)
+    {
+        binary.symbols = SymbolCache::instance().get(*mapping->filename);
+        binary.table = UnwindTableCache::instance().get(*mapping->filename);
+    }
+    if (!binary.symbols || !binary.table)
+    {
+        return nullptr;
+    }
+
+    const auto file_address = binary.symbols->file_address(address, mapping->start, mapping->pgoff);
+    if (!file_address)
+    {
+        return nullptr;
+    }
+    return binary.table->lookup(*file_address);
+}
+
+std::size_t Unwinder::unwind(const SampleView& sample, std::uint64_t* frames,
+                             std::size_t max_frames)
+{
+    if (max_frames == 0)
+    {
+        return 0;
+    }
+
+#if defined(__x86_64__) || defined(__aarch64__)
+    const auto ip_reg = user_register(sample, perf_reg_ip);
+    const auto sp_reg = user_register(sample, perf_reg_sp);
+    const auto fp_reg = user_register(sample, perf_reg_fp);
+    if (!ip_reg || !sp_reg || !fp_reg)
+    {
+        frames[0] = sample.ip;
+        return 1;
+    }
+
+#if defined(__aarch64__)
+    // the return address of a leaf function is still in the link register
+    auto lr = user_register(sample, perf_reg_lr);
+#else
+    std::optional<std::uint64_t> lr;
+#endif
+
+    const auto stack_start = *sp_reg;
+    auto read = [&](std::uint64_t address, std::uint64_t& value)
+    {
+        if (address < stack_start || address - stack_start > sample.stack_user_size ||
+            sample.stack_user_size - (address - stack_start) < sizeof(value))
+        {
+            return false;
+        }
+        std::memcpy(&value, sample.stack_user + (address - stack_start), sizeof(value));
+        return true;
+    };
+
+    std::uint64_t ip = *ip_reg;
+    std::uint64_t sp = *sp_reg;
+    std::uint64_t fp = *fp_reg;
+
+    std::size_t count = 0;
+    frames[count++] = ip;
+    while (count < max_frames)
+    {
+        // return addresses point behind the call, which may already be the
+        // next function (e.g. after a call to a noreturn function)
+        const auto* row = find_row(sample.pid, count == 1 ? ip : ip - 1, sample.time);
+
+        std::uint64_t cfa;
+        std::uint64_t ra;
+        std::uint64_t caller_fp = fp;
+        bool ra_from_register = false;
+        if (row != nullptr)
+        {
+            cfa = (row->cfa == UnwindRow::Cfa::STACK_POINTER ? sp : fp) + row->cfa_offset;
+
+            if (row->ra == UnwindRow::Rule::OFFSET)
+            {
+                if (!read(cfa + row->ra_offset, ra))
+                {
+                    break;
+                }
+            }
+            else if (row->ra == UnwindRow::Rule::SAME_VALUE && lr)
+            {
+                ra = *lr;
+                ra_from_register = true;
+            }
+            else
+            {
+                // undefined return address: the outermost frame
+                break;
+            }
+
+            if (row->fp == UnwindRow::Rule::OFFSET && !read(cfa + row->fp_offset, caller_fp))
+            {
+                break;
+            }
+        }
+        else
+        {
+            // frame record: the caller's frame pointer followed by the return address
+            if (!read(fp, caller_fp) || !read(fp + sizeof(std::uint64_t), ra))
+            {
+                break;
+            }
+            cfa = fp + 2 * sizeof(std::uint64_t);
+        }
+
+        // the link register is only valid in the first frame
+        lr.reset();
+
+        // the stack grows down, every caller's frame is above its callee's
+        if (ra == 0 || cfa < sp || (cfa == sp && !ra_from_register))
+        {
+            break;
+        }
+
+        ip = ra;
+        sp = cfa;
+        fp = caller_fp;
+        frames[count++] = ip;
+    }
+    return count;
+#else
+    frames[0] = sample.ip;
+    return 1;
+#endif
+}
+
+} // namespace perf_cpp
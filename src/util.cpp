@@ -76,6 +76,16 @@ int perf_event_paranoid()
     return get_sysctl<int>("kernel", "perf_event_paranoid");
 }
 
+std::uint64_t perf_event_mlock_kb()
+{
+    return get_sysctl<std::uint64_t>("kernel", "perf_event_mlock_kb");
+}
+
+std::uint64_t perf_event_max_sample_rate()
+{
+    return get_sysctl<std::uint64_t>("kernel", "perf_event_max_sample_rate");
+}
+
 int perf_event_open(struct perf_event_attr* perf_attr, std::variant<Cpu, Thread> location,
                     int group_fd, unsigned long flags, int cgroup_fd)
 {